@@ -0,0 +1,141 @@
+/*
+ * Correctness and throughput check for the String intrinsic kernels in
+ * dalvik/MemUtf16.cpp.  Not part of the app build; to run it on a device:
+ *
+ *   $NDK/toolchains/llvm/prebuilt/<host>/bin/armv7a-linux-androideabi21-clang++ \
+ *       -O2 -std=c++11 -mfpu=neon -I../dalvik \
+ *       MemUtf16Bench.cpp ../dalvik/MemUtf16.cpp -o memutf16-bench
+ *   adb push memutf16-bench /data/local/tmp && adb shell /data/local/tmp/memutf16-bench
+ *
+ * or build the same two files with the host compiler for the x86 kernels.
+ * Every kernel is checked against "scalar" first; a mismatch exits non-zero.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MemUtf16.h"
+
+static const char* kKernels[] = { "scalar", "sse2", "avx2", "neon" };
+static const size_t kLengths[] = { 8, 32, 256, 4096 };
+
+static u8 nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fillRandom(u2* chars, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        /* mix in high chars so unsigned differences are exercised */
+        chars[i] = (rand() & 1) ? (u2) ('a' + rand() % 26) : (u2) (rand() % 0xfff0);
+    }
+}
+
+/*
+ * Run every operation on every (length, offset, mismatch position) up to
+ * "maxLen" and compare against the scalar kernel.
+ */
+static bool checkKernel(const char* name, u2* a, u2* b, size_t maxLen)
+{
+    int failures = 0;
+    for (size_t len = 0; len <= maxLen; len++) {
+        for (size_t off = 0; off < 4; off++) {
+            u2* lhs = a + off;
+            u2* rhs = b + (3 - off);
+            memcpy(rhs, lhs, len * sizeof(u2));
+            for (size_t pos = 0; pos <= len; pos++) {
+                u2 saved = 0;
+                if (pos < len) {
+                    saved = rhs[pos];
+                    rhs[pos] = lhs[pos] ^ (u2) (0x8001 + pos);
+                }
+                u2 needle = pos < len ? lhs[pos] : 0xfffe;
+
+                dvmMemUtf16SelectKernel("scalar");
+                int expCmp = dvmMemcmp16(lhs, rhs, len);
+                bool expEq = dvmMemeq16(lhs, rhs, len);
+                int expChr = dvmMemchr16(lhs, needle, len);
+
+                dvmMemUtf16SelectKernel(name);
+                if (dvmMemcmp16(lhs, rhs, len) != expCmp
+                    || dvmMemeq16(lhs, rhs, len) != expEq
+                    || dvmMemchr16(lhs, needle, len) != expChr)
+                {
+                    if (failures++ < 10) {
+                        printf("  %s: mismatch len=%zu off=%zu pos=%zu\n",
+                            name, len, off, pos);
+                    }
+                }
+                if (pos < len) {
+                    rhs[pos] = saved;
+                }
+            }
+        }
+    }
+    return failures == 0;
+}
+
+int main()
+{
+    const size_t kMaxCheckLen = 80;
+    const size_t kBufLen = 8192;
+    u2* a = (u2*) malloc((kBufLen + 8) * sizeof(u2));
+    u2* b = (u2*) malloc((kBufLen + 8) * sizeof(u2));
+    srand(1);
+    fillRandom(a, kBufLen + 8);
+    memcpy(b, a, (kBufLen + 8) * sizeof(u2));
+
+    bool ok = true;
+    printf("%-8s %6s %12s %12s %12s\n", "kernel", "chars",
+        "cmp MB/s", "eq MB/s", "chr MB/s");
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++) {
+        const char* name = kKernels[k];
+        if (!dvmMemUtf16SelectKernel(name)) {
+            continue;
+        }
+        if (!checkKernel(name, a, b, kMaxCheckLen)) {
+            printf("%s: FAILED\n", name);
+            ok = false;
+            continue;
+        }
+        memcpy(b, a, (kBufLen + 8) * sizeof(u2));
+        dvmMemUtf16SelectKernel(name);
+
+        for (size_t l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++) {
+            size_t len = kLengths[l];
+            size_t iters = (64 << 20) / (len * sizeof(u2));
+            volatile int sink = 0;
+            double mb = (double) iters * len * sizeof(u2) / (1 << 20);
+
+            /* equal inputs and an absent char: the full-length worst case */
+            u8 start = nowNs();
+            for (size_t i = 0; i < iters; i++) {
+                sink += dvmMemcmp16(a, b, len);
+            }
+            double cmpRate = mb / ((nowNs() - start) / 1e9);
+
+            start = nowNs();
+            for (size_t i = 0; i < iters; i++) {
+                sink += dvmMemeq16(a, b, len);
+            }
+            double eqRate = mb / ((nowNs() - start) / 1e9);
+
+            start = nowNs();
+            for (size_t i = 0; i < iters; i++) {
+                sink += dvmMemchr16(a, 0xffff, len);
+            }
+            double chrRate = mb / ((nowNs() - start) / 1e9);
+
+            printf("%-8s %6zu %12.0f %12.0f %12.0f\n", name, len,
+                cmpRate, eqRate, chrRate);
+            (void) sink;
+        }
+    }
+
+    free(a);
+    free(b);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,634 @@
+/*
+ * Thread scaling of protected calls: 1..N threads make calls of one
+ * workload for a fixed time, and each step reports throughput, p50/p99
+ * call time and the runtime's own counters.  Not part of the app build;
+ * to run it on a device:
+ *
+ *   $NDK/toolchains/llvm/prebuilt/<host>/bin/armv7a-linux-androideabi21-clang++ \
+ *       -O2 -std=c++11 -I../dalvik ScalingBench.cpp \
+ *       ../dalvik/{AdvmpThread,Latency,PerfCounters,VmStats,Sampler,MethodTrace,OpcodeStats,AllocSites,LockContention}.cpp \
+ *       ../dalvik/{TypeCheck,Intrinsics,Class,Thread,Interp,Sync,Stack,CardTable,DexOpcodes}.cpp \
+ *       ../dalvik/{YcFile,YcCodec,YcVerify,YcHash,Sha256,WorkerPool,PerfMap,Startup}.cpp \
+ *       -llog -lz -o scaling-bench
+ *   adb push scaling-bench /data/local/tmp
+ *   adb shell /data/local/tmp/scaling-bench [-g] [-c] [-t threads] \
+ *       [-m stepMillis] [arith|iface|instanceof|aput|intrinsic ...]
+ *
+ * The interpreter needs libdvm, so no bytecode runs.  Everything else a
+ * protected call does is the runtime's own code: each call goes through
+ * the bridge as separatorTest and BWdvmInterpretPortable do it
+ * (dvmLatencyEnter/Exit and dvmPerfEnter/Exit around dvmAdvmpThreadSelf
+ * and the bridge-entry count), and each workload drives the shared
+ * tables its handlers use.  Only the libdvm hooks they fall back to are
+ * stubbed, over hand-built ClassObjects and Methods:
+ *
+ *   arith       register arithmetic only; the bridge alone
+ *   iface       invoke-interface through ATOMIC_CACHE_LOOKUP on one
+ *               shared AtomicCache, as dvmFindInterfaceMethodInCache does
+ *               with pInterfaceCache; more keys than entries, so fills race
+ *   instanceof  dvmInstanceof over a small hierarchy with interfaces
+ *               (the ClassDisplay table)
+ *   aput        dvmCanPutArrayElementCached at sites in each thread's own
+ *               code (the store-check site table)
+ *   intrinsic   invokes of bound and unbound methods through
+ *               dvmFindIntrinsic, running the intrinsics it finds
+ *
+ * With -g the bridge stores the caller's JNIEnv in gEnv and the null
+ * checks read it back, as the handlers' checkForNull(gEnv, ...) does; the
+ * result is wrong with more than one thread, which is the point, but the
+ * cost is what one process-wide global adds.  With -c the calls are also
+ * counted in one shared counter, the way VmStats avoids.
+ *
+ * Counters come from dvmVmStatsSnapshot and call times from the wall-clock
+ * latency histograms, so percentiles are bucket bounds.  Each step starts
+ * with an empty interface cache and fixed per-thread seeds; the other
+ * tables fill once and stay warm, as they do in the app.  Perfect scaling
+ * keeps callsPerThread flat.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "AdvmpThread.h"
+#include "AtomicCache.h"
+#include "Class.h"
+#include "Globals.h"
+#include "Interp.h"
+#include "Intrinsics.h"
+#include "Latency.h"
+#include "PerfCounters.h"
+#include "TypeCheck.h"
+#include "VmStats.h"
+
+/* avmp.cpp's and InlineNative.cpp's, which need the VM */
+AdvmpGlobals gAdvmp;
+JNIEnv* gEnv;
+
+/* the method index the bridge records under, as in avmp.cpp */
+#define kSeparatorTestMethod    0
+
+#define kInterfaceCacheSize     128     /* DEX_INTERFACE_CACHE_SIZE */
+#define kClassCount             48
+#define kInterfaceMethods       4       /* keys: 192, for 128 entries */
+#define kIfaceCount             8
+#define kHierarchyClasses       32
+#define kStoreSites             64
+#define kAppMethods             16
+#define kWarmupMillis           200
+
+struct BenchThread;
+
+struct Workload {
+    const char* name;
+    void        (*run)(BenchThread* thread);
+};
+
+struct BenchThread {
+    pthread_t       handle;
+    const Workload* workload;
+    Thread*         self;           /* what dvmThreadSelfHook returns */
+    char            env;            /* its address stands in for a JNIEnv */
+    u4              seed;
+    u4              sink;
+    u8              calls;
+    u2              code[kStoreSites * 2];  /* aput-object sites */
+} __attribute__((aligned(64)));
+
+static pthread_key_t gThreadKey;
+static bool gSharedEnv;
+static bool gSharedCounter;
+static volatile int32_t gBridgeEntries;
+static volatile int32_t gReady;
+static volatile int32_t gGo;
+static volatile int32_t gStop;
+
+/* iface: the shared cache and the classes' interface tables */
+static AtomicCache gInterfaceCache;
+static u4 gIftables[kClassCount][kInterfaceMethods];
+
+/* instanceof, aput: Object, interfaces, and classes below Object */
+static ClassObject gObjectClass;
+static ClassObject gIfaces[kIfaceCount];
+static ClassObject gClasses[kHierarchyClasses];
+static ClassObject gObjectArrayClass;
+
+/* intrinsic: some of java.lang.Math, and an app class */
+static ClassObject gMathClass;
+static Method gMathMethods[4];
+static ClassObject gAppClass;
+static Method gAppMethods[kAppMethods];
+static const Method* gInvokeTargets[4 + kAppMethods];
+
+/*
+ * libdvm hook stubs.
+ */
+static Thread* benchThreadSelf()
+{
+    BenchThread* thread = (BenchThread*) pthread_getspecific(gThreadKey);
+    return thread != NULL ? thread->self : NULL;
+}
+
+static int benchInstanceofNonTrivial(const ClassObject* instance,
+    const ClassObject* clazz)
+{
+    for (const ClassObject* c = instance; c != NULL; c = c->super) {
+        if (c == clazz) {
+            return 1;
+        }
+    }
+    for (int i = 0; i < instance->iftableCount; i++) {
+        if (instance->iftable[i].clazz == clazz) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static bool benchCanPutArrayElement(const ClassObject* objectClass,
+    const ClassObject* arrayClass)
+{
+    return arrayClass->elementClass == &gObjectClass
+        || benchInstanceofNonTrivial(objectClass, arrayClass->elementClass);
+}
+
+static ClassObject* benchFindSystemClassNoInit(const char* descriptor)
+{
+    return strcmp(descriptor, "Ljava/lang/Math;") == 0 ? &gMathClass : NULL;
+}
+
+static void benchAbort()
+{
+    abort();
+}
+
+static u8 nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u4 nextRandom(BenchThread* thread)
+{
+    thread->seed = thread->seed * 1103515245u + 12345u;
+    return thread->seed >> 8;
+}
+
+static JNIEnv* currentEnv(BenchThread* thread)
+{
+    return gSharedEnv ? gEnv : (JNIEnv*) &thread->env;
+}
+
+static void runArith(BenchThread* thread)
+{
+    u4 fp[16];
+    for (int i = 0; i < 16; i++) {
+        fp[i] = thread->seed + i;
+    }
+    for (int i = 0; i < 256; i++) {
+        fp[i & 15] = fp[(i + 3) & 15] * 31 + (fp[(i + 7) & 15] ^ (u4) i);
+        fp[(i + 1) & 15] += fp[i & 15] >> 3;
+    }
+    thread->sink += fp[0] ^ fp[15];
+}
+
+/* the slow path: walk the class's iftable, as dvmInterpFindInterfaceMethod does */
+static u4 findInterfaceMethod(u4 classIdx, u4 methodIdx)
+{
+    for (u4 i = 0; i < kInterfaceMethods; i++) {
+        if (gIftables[classIdx][i] == methodIdx) {
+            return classIdx * kInterfaceMethods + i + 1;
+        }
+    }
+    return 0;
+}
+
+static u4 findInterfaceMethodInCache(u4 classIdx, u4 methodIdx, u8* stats)
+{
+#define ATOMIC_CACHE_CALC findInterfaceMethod(classIdx, methodIdx)
+#define ATOMIC_CACHE_NULL_ALLOWED false
+#define ATOMIC_CACHE_STAT(_event) (stats[kVmStatInterfaceCache##_event]++)
+    /* key1 stands in for the ClassObject pointer, hence the alignment */
+    return ATOMIC_CACHE_LOOKUP(&gInterfaceCache, kInterfaceCacheSize,
+        (classIdx + 1) << 3, methodIdx);
+#undef ATOMIC_CACHE_STAT
+#undef ATOMIC_CACHE_NULL_ALLOWED
+#undef ATOMIC_CACHE_CALC
+}
+
+static void runIface(BenchThread* thread)
+{
+    AdvmpThread* advmpSelf = dvmAdvmpThreadCurrent();
+    u4 sum = 0;
+    for (int i = 0; i < 16; i++) {
+        u4 r = nextRandom(thread);
+        u4 classIdx = r % kClassCount;
+        u4 methodIdx = (r >> 16) % kInterfaceMethods;
+        sum += findInterfaceMethodInCache(classIdx, methodIdx,
+            advmpSelf->stats);
+    }
+    thread->sink += sum;
+}
+
+static void runInstanceof(BenchThread* thread)
+{
+    u4 sum = 0;
+    for (int i = 0; i < 16; i++) {
+        u4 r = nextRandom(thread);
+        const ClassObject* instance = &gClasses[r % kHierarchyClasses];
+        const ClassObject* clazz = ((r >> 12) & 1) != 0
+            ? &gIfaces[(r >> 16) % kIfaceCount]
+            : &gClasses[(r >> 16) % kHierarchyClasses];
+        if (currentEnv(thread) == NULL) {
+            return;                         /* checkForNull would throw */
+        }
+        sum += dvmInstanceof(instance, clazz);
+    }
+    thread->sink += sum;
+}
+
+static void runAput(BenchThread* thread)
+{
+    u4 sum = 0;
+    for (int i = 0; i < 16; i++) {
+        u4 r = nextRandom(thread);
+        /* each site sees one or two value classes, like real code */
+        u4 site = r % kStoreSites;
+        const ClassObject* valueClass =
+            &gClasses[(site + ((r >> 16) & 1)) % kHierarchyClasses];
+        if (currentEnv(thread) == NULL) {
+            return;
+        }
+        sum += dvmCanPutArrayElementCached(&thread->code[site * 2],
+            valueClass, &gObjectArrayClass);
+    }
+    thread->sink += sum;
+}
+
+static void runIntrinsic(BenchThread* thread)
+{
+    AdvmpThread* advmpSelf = dvmAdvmpThreadCurrent();
+    u4 outs[4];
+    JValue retval;
+    u4 sum = 0;
+    for (int i = 0; i < 16; i++) {
+        u4 r = nextRandom(thread);
+        const Method* methodToCall =
+            gInvokeTargets[r % array_size(gInvokeTargets)];
+        outs[0] = r;
+        outs[1] = 0;
+        outs[2] = r >> 4;
+        outs[3] = 0;
+        advmpSelf->stats[kVmStatInvokes]++;
+        IntrinsicFunc intrinsic = dvmFindIntrinsic(methodToCall);
+        if (intrinsic != NULL
+            && (*intrinsic)(outs, &retval) == kIntrinsicDone)
+        {
+            advmpSelf->stats[kVmStatIntrinsicCalls]++;
+            sum += (u4) retval.j;
+        } else {
+            sum += methodToCall->name[0];   /* would push a frame */
+        }
+    }
+    thread->sink += sum;
+}
+
+static const Workload kWorkloads[] = {
+    { "arith", runArith },
+    { "iface", runIface },
+    { "instanceof", runInstanceof },
+    { "aput", runAput },
+    { "intrinsic", runIntrinsic },
+};
+
+/*
+ * One protected call, through the bridge.
+ */
+static void protectedCall(BenchThread* thread)
+{
+    /* separatorTest */
+    LatencyScope latency;
+    PerfScope perf;
+    dvmLatencyEnter(&latency);
+    dvmPerfEnter(&perf);
+
+    /* BWdvmInterpretPortable, up to the first instruction */
+    Thread* self = dvmThreadSelfHook();
+    dvmIntrinsicsStartup();
+    AdvmpThread* advmpSelf = dvmAdvmpThreadSelf(self);
+    s4 safepointCountdown = advmpSelf->safepointInterval;
+    advmpSelf->stats[kVmStatBridgeEntries]++;
+    if (gSharedEnv) {
+        gEnv = (JNIEnv*) &thread->env;
+    }
+    if (gSharedCounter) {
+        __sync_fetch_and_add(&gBridgeEntries, 1);
+    }
+    thread->workload->run(thread);
+    thread->sink += safepointCountdown;
+
+    dvmPerfExit(&perf, kSeparatorTestMethod);
+    dvmLatencyExit(&latency, kSeparatorTestMethod);
+    thread->calls++;
+}
+
+static void* workerMain(void* arg)
+{
+    BenchThread* thread = (BenchThread*) arg;
+    pthread_setspecific(gThreadKey, thread);
+    __sync_fetch_and_add(&gReady, 1);
+    while (gGo == 0) {
+        sched_yield();
+    }
+
+    /* check for the end every 64 calls, to keep it off the profile */
+    do {
+        for (int i = 0; i < 64; i++) {
+            protectedCall(thread);
+        }
+    } while (gStop == 0);
+    return NULL;
+}
+
+struct StepResult {
+    u8              calls;
+    double          seconds;
+    LatencySummary  latency;
+    u8              stats[kVmStatCount];
+};
+
+static bool runStep(const Workload* workload, int threads, int millis,
+    StepResult* result)
+{
+    BenchThread* workers = NULL;
+    if (posix_memalign((void**) &workers, 64, threads * sizeof(BenchThread))
+        != 0)
+    {
+        return false;
+    }
+    memset(workers, 0, threads * sizeof(BenchThread));
+    memset(gInterfaceCache.entries, 0,
+        kInterfaceCacheSize * sizeof(AtomicCacheEntry));
+    gEnv = NULL;
+    gReady = gGo = gStop = 0;
+    dvmLatencyReset();
+    u8 before[kVmStatCount];
+    dvmVmStatsSnapshot(before);
+
+    bool ok = true;
+    int started = 0;
+    for (; started < threads; started++) {
+        BenchThread* thread = &workers[started];
+        thread->workload = workload;
+        thread->seed = 0x9e3779b9u * (started + 1);
+        thread->self = (Thread*) calloc(1, sizeof(Thread));
+        if (thread->self == NULL
+            || pthread_create(&thread->handle, NULL, workerMain, thread) != 0)
+        {
+            free(thread->self);
+            ok = false;
+            break;
+        }
+    }
+    while (gReady < started) {
+        sched_yield();
+    }
+
+    u8 start = nowNs();
+    gGo = 1;
+    usleep(millis * 1000);
+    gStop = 1;
+    result->calls = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].handle, NULL);
+        result->calls += workers[i].calls;
+        free(workers[i].self);
+    }
+    result->seconds = (nowNs() - start) / 1e9;
+
+    /* the threads have exited, so their counters are in the totals */
+    dvmVmStatsSnapshot(result->stats);
+    for (int s = 0; s < kVmStatCount; s++) {
+        result->stats[s] -= before[s];
+    }
+    if (!dvmLatencySummary(kSeparatorTestMethod, kLatencyClockWall,
+            &result->latency))
+    {
+        ok = false;
+    }
+    free(workers);
+    return ok;
+}
+
+static bool runWorkload(const Workload* workload, int maxThreads, int millis)
+{
+    StepResult result;
+    if (!runStep(workload, 1, kWarmupMillis, &result)) {
+        return false;
+    }
+
+    double singleRate = 0;
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        if (!runStep(workload, threads, millis, &result)) {
+            fprintf(stderr, "%s: step with %d threads failed\n",
+                workload->name, threads);
+            return false;
+        }
+        double perThread = result.calls / result.seconds / threads;
+        if (threads == 1) {
+            singleRate = perThread;
+        }
+        printf("%s,%d,%llu,%.0f,%.0f,%.3f,%llu,%llu,%llu,%llu,%llu,%llu,"
+            "%llu,%llu,%llu\n",
+            workload->name, threads, (unsigned long long) result.calls,
+            result.calls / result.seconds, perThread, perThread / singleRate,
+            (unsigned long long) result.latency.p50,
+            (unsigned long long) result.latency.p99,
+            (unsigned long long) result.stats[kVmStatBridgeEntries],
+            (unsigned long long) result.stats[kVmStatInvokes],
+            (unsigned long long) result.stats[kVmStatIntrinsicCalls],
+            (unsigned long long) result.stats[kVmStatInterfaceCacheHits],
+            (unsigned long long) result.stats[kVmStatInterfaceCacheMisses],
+            (unsigned long long) result.stats[kVmStatInterfaceCacheFills],
+            (unsigned long long) result.stats[kVmStatInterfaceCacheFails]);
+        fflush(stdout);
+    }
+    return true;
+}
+
+static const Workload* findWorkload(const char* name)
+{
+    for (size_t i = 0; i < array_size(kWorkloads); i++) {
+        if (strcmp(kWorkloads[i].name, name) == 0) {
+            return &kWorkloads[i];
+        }
+    }
+    return NULL;
+}
+
+static void initClass(ClassObject* clazz, const char* descriptor,
+    ClassObject* super, u4 accessFlags)
+{
+    clazz->descriptor = descriptor;
+    clazz->super = super;
+    clazz->accessFlags = accessFlags;
+    clazz->status = CLASS_INITIALIZED;
+}
+
+static void initMethod(Method* method, ClassObject* clazz, const char* name,
+    const char* shorty)
+{
+    method->clazz = clazz;
+    method->name = name;
+    method->shorty = shorty;
+}
+
+/*
+ * Build the classes the workloads use: interfaces, a hierarchy eight deep
+ * whose classes each add an interface (iftables flattened, as libdvm keeps
+ * them), Object[], and the two classes whose methods get invoked.
+ */
+static bool initClasses()
+{
+    initClass(&gObjectClass, "Ljava/lang/Object;", NULL, ACC_PUBLIC);
+    for (int i = 0; i < kIfaceCount; i++) {
+        initClass(&gIfaces[i], "LBenchIface;", NULL,
+            ACC_PUBLIC | ACC_INTERFACE | ACC_ABSTRACT);
+    }
+    for (int i = 0; i < kHierarchyClasses; i++) {
+        ClassObject* super = (i < 4) ? &gObjectClass : &gClasses[i - 4];
+        initClass(&gClasses[i], "LBenchClass;", super, ACC_PUBLIC);
+        int count = super->iftableCount + 1;
+        InterfaceEntry* iftable =
+            (InterfaceEntry*) calloc(count, sizeof(InterfaceEntry));
+        if (iftable == NULL) {
+            return false;
+        }
+        memcpy(iftable, super->iftable,
+            super->iftableCount * sizeof(InterfaceEntry));
+        iftable[count - 1].clazz = &gIfaces[i % kIfaceCount];
+        gClasses[i].iftable = iftable;
+        gClasses[i].iftableCount = count;
+    }
+    initClass(&gObjectArrayClass, "[Ljava/lang/Object;", &gObjectClass,
+        ACC_PUBLIC | ACC_FINAL | ACC_ABSTRACT);
+    gObjectArrayClass.arrayDim = 1;
+    gObjectArrayClass.elementClass = &gObjectClass;
+
+    initClass(&gMathClass, "Ljava/lang/Math;", &gObjectClass,
+        ACC_PUBLIC | ACC_FINAL);
+    initMethod(&gMathMethods[0], &gMathClass, "min", "JJJ");
+    initMethod(&gMathMethods[1], &gMathClass, "max", "JJJ");
+    initMethod(&gMathMethods[2], &gMathClass, "abs", "JJ");
+    initMethod(&gMathMethods[3], &gMathClass, "signum", "DD");
+    gMathClass.directMethods = gMathMethods;
+    gMathClass.directMethodCount = array_size(gMathMethods);
+
+    initClass(&gAppClass, "Lcom/appvmp/Bench;", &gObjectClass, ACC_PUBLIC);
+    for (int i = 0; i < kAppMethods; i++) {
+        initMethod(&gAppMethods[i], &gAppClass, "run", "JJJ");
+    }
+    gAppClass.virtualMethods = gAppMethods;
+    gAppClass.virtualMethodCount = kAppMethods;
+
+    size_t n = 0;
+    for (size_t i = 0; i < array_size(gMathMethods); i++) {
+        gInvokeTargets[n++] = &gMathMethods[i];
+    }
+    for (int i = 0; i < kAppMethods; i++) {
+        gInvokeTargets[n++] = &gAppMethods[i];
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int maxThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int millis = 2000;
+    int opt;
+    while ((opt = getopt(argc, argv, "gct:m:")) != -1) {
+        switch (opt) {
+        case 'g':
+            gSharedEnv = true;
+            break;
+        case 'c':
+            gSharedCounter = true;
+            break;
+        case 't':
+            maxThreads = atoi(optarg);
+            break;
+        case 'm':
+            millis = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-g] [-c] [-t threads] [-m stepMillis]"
+                " [arith|iface|instanceof|aput|intrinsic ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (maxThreads < 1) {
+        maxThreads = 1;
+    }
+    if (millis < 1) {
+        millis = 1;
+    }
+
+    const Workload* selected[array_size(kWorkloads)];
+    size_t count = 0;
+    for (int i = optind; i < argc; i++) {
+        const Workload* workload = findWorkload(argv[i]);
+        if (workload == NULL || count == array_size(selected)) {
+            fprintf(stderr, "unknown workload %s\n", argv[i]);
+            return 2;
+        }
+        selected[count++] = workload;
+    }
+    if (count == 0) {
+        for (size_t i = 0; i < array_size(kWorkloads); i++) {
+            selected[count++] = &kWorkloads[i];
+        }
+    }
+
+    pthread_key_create(&gThreadKey, NULL);
+    dvmThreadSelfHook = benchThreadSelf;
+    dvmInstanceofNonTrivialHook = benchInstanceofNonTrivial;
+    dvmCanPutArrayElementHook = benchCanPutArrayElement;
+    dvmFindSystemClassNoInitHook = benchFindSystemClassNoInit;
+    dvmAbortHook = benchAbort;
+    if (!initClasses()) {
+        return 2;
+    }
+    for (u4 c = 0; c < kClassCount; c++) {
+        for (u4 m = 0; m < kInterfaceMethods; m++) {
+            gIftables[c][m] = (m + c) % kInterfaceMethods;
+        }
+    }
+    gInterfaceCache.numEntries = kInterfaceCacheSize;
+    gInterfaceCache.entryAlloc = calloc(1,
+        kInterfaceCacheSize * sizeof(AtomicCacheEntry) + CPU_CACHE_WIDTH);
+    if (gInterfaceCache.entryAlloc == NULL) {
+        return 2;
+    }
+    /* aligned like dvmAllocAtomicCache does it */
+    gInterfaceCache.entries = (AtomicCacheEntry*)
+        (((uintptr_t) gInterfaceCache.entryAlloc + CPU_CACHE_WIDTH_1)
+            & ~(uintptr_t) CPU_CACHE_WIDTH_1);
+    dvmLatencyStart(kLatencyRecordWall);
+
+    printf("workload,threads,calls,callsPerSec,callsPerThread,efficiency,"
+        "p50Ns,p99Ns,bridgeEntries,invokes,intrinsicCalls,"
+        "cacheHits,cacheMisses,cacheFills,cacheFails\n");
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = runWorkload(selected[i], maxThreads, millis);
+    }
+    if (gSharedCounter) {
+        fprintf(stderr, "shared counter: %d calls\n", gBridgeEntries);
+    }
+
+    free(gInterfaceCache.entryAlloc);
+    return ok ? 0 : 1;
+}
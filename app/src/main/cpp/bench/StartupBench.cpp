@@ -0,0 +1,175 @@
+/*
+ * Cold and warm replay of the protection layer's share of startup: the
+ * same steps JNI_OnLoad and the first protected call take, minus libdvm.
+ * Not part of the app build; to run it on a device:
+ *
+ *   $NDK/toolchains/llvm/prebuilt/<host>/bin/armv7a-linux-androideabi21-clang++ \
+ *       -O2 -std=c++11 -I../dalvik StartupBench.cpp \
+ *       ../dalvik/{Utils,ZipArchive,YcFile,YcCodec,YcHash,YcVerify,Sha256,WorkerPool,PerfMap,Startup}.cpp \
+ *       -llog -lz -o startup-bench
+ *   adb push startup-bench /data/local/tmp
+ *   adb shell /data/local/tmp/startup-bench /data/app/com.appvmp-1/base.apk 20
+ *
+ * Cold runs evict the APK from the page cache first: through
+ * /proc/sys/vm/drop_caches when run as root, otherwise with
+ * POSIX_FADV_DONTNEED, which only drops pages nobody else has mapped.
+ * The code_cache image (YcCache) is not used, so this is the first-launch
+ * path.  Compare against AdvmpProfiler.startupTimeline() in the app for
+ * what registration, hook binding and the interpreter add.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Globals.h"
+#include "SysUtil.h"
+#include "Utils.h"
+#include "YcFile.h"
+
+/* avmp.cpp's, which needs libdvm; PerfMap refers to it */
+AdvmpGlobals gAdvmp;
+
+enum BenchPhase {
+    kPhaseMap = 0,          /* locate classes.yc in the APK and map it */
+    kPhaseParse,            /* method index, chunk directory, digests */
+    kPhaseMaterialize,      /* inflate and verify the first method */
+    kPhaseCount
+};
+
+static const char* kPhaseNames[kPhaseCount] = { "map", "parse", "materialize" };
+
+static u8 nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void evictFile(const char* path)
+{
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0) {
+        bool dropped = (write(fd, "1", 1) == 1);
+        close(fd);
+        if (dropped) {
+            return;
+        }
+    }
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/*
+ * One replay; fills "times" with the duration of each phase.  Returns
+ * false if a step fails.
+ */
+static bool replay(const char* apkPath, u8* times)
+{
+    MemMapping map;
+    u4 crc;
+    bool ok = false;
+
+    u8 start = nowNs();
+    if (!MapYcFile(apkPath, &map, &crc)) {
+        fprintf(stderr, "can't map classes.yc from %s\n", apkPath);
+        return false;
+    }
+    u8 mapped = nowNs();
+
+    YcFile* ycFile = new YcFile;
+    if (ycFile->parse((const u1*) map.addr, map.length)) {
+        u8 parsed = nowNs();
+        const SeparatorData* sd = ycFile->getSeparatorData(0);
+        if (sd != NULL && ycFile->getInsns(sd) != NULL) {
+            times[kPhaseMap] = mapped - start;
+            times[kPhaseParse] = parsed - mapped;
+            times[kPhaseMaterialize] = nowNs() - parsed;
+            ok = true;
+        } else {
+            fprintf(stderr, "can't materialize the first method\n");
+        }
+    } else {
+        fprintf(stderr, "can't parse classes.yc\n");
+    }
+    delete ycFile;
+    UnmapYcFile(&map);
+    return ok;
+}
+
+static int compareU8(const void* a, const void* b)
+{
+    u8 x = *(const u8*) a;
+    u8 y = *(const u8*) b;
+    return x < y ? -1 : (x > y);
+}
+
+static bool runSeries(const char* label, const char* apkPath, int runs,
+    bool cold)
+{
+    u8* samples = (u8*) calloc((size_t) runs * kPhaseCount, sizeof(u8));
+    u8* totals = (u8*) calloc(runs, sizeof(u8));
+    if (samples == NULL || totals == NULL) {
+        free(samples);
+        free(totals);
+        return false;
+    }
+
+    bool ok = true;
+    if (!cold) {
+        u8 ignored[kPhaseCount];
+        ok = replay(apkPath, ignored);      /* warm the cache */
+    }
+    for (int r = 0; ok && r < runs; r++) {
+        if (cold) {
+            evictFile(apkPath);
+        }
+        u8* times = &samples[r * kPhaseCount];
+        ok = replay(apkPath, times);
+        for (int p = 0; p < kPhaseCount; p++) {
+            totals[r] += times[p];
+        }
+    }
+
+    if (ok) {
+        u8* column = (u8*) malloc(runs * sizeof(u8));
+        for (int p = 0; column != NULL && p <= kPhaseCount; p++) {
+            for (int r = 0; r < runs; r++) {
+                column[r] = (p < kPhaseCount) ? samples[r * kPhaseCount + p]
+                                              : totals[r];
+            }
+            qsort(column, runs, sizeof(u8), compareU8);
+            printf("%s,%s,%.1f,%.1f,%.1f\n", label,
+                p < kPhaseCount ? kPhaseNames[p] : "total",
+                column[0] / 1000.0, column[runs / 2] / 1000.0,
+                column[runs - 1] / 1000.0);
+        }
+        free(column);
+    }
+    free(samples);
+    free(totals);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <apk> [runs]\n", argv[0]);
+        return 2;
+    }
+    const char* apkPath = argv[1];
+    int runs = (argc > 2) ? atoi(argv[2]) : 10;
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    printf("cache,phase,minUs,medianUs,maxUs\n");
+    bool ok = runSeries("cold", apkPath, runs, true)
+        && runSeries("warm", apkPath, runs, false);
+    return ok ? 0 : 1;
+}
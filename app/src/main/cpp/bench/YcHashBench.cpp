@@ -0,0 +1,122 @@
+/*
+ * Correctness and throughput check for ycHash64 (dalvik/YcHash.cpp).  Not
+ * part of the app build; to run it on a device:
+ *
+ *   $NDK/toolchains/llvm/prebuilt/<host>/bin/armv7a-linux-androideabi21-clang++ \
+ *       -O2 -std=c++11 -mfpu=neon -I../dalvik \
+ *       YcHashBench.cpp ../dalvik/YcHash.cpp -llog -o ychash-bench
+ *   adb push ychash-bench /data/local/tmp && adb shell /data/local/tmp/ychash-bench
+ *
+ * or build the same two files with the host compiler for the x86 kernels.
+ * Every kernel is checked at four alignments against XXH3_64bits values
+ * computed with the reference xxHash 0.8; a mismatch exits non-zero.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "YcHash.h"
+
+static const char* kKernels[] = { "scalar", "sse2", "avx2", "neon" };
+
+/* XXH3_64bits(fillPattern(len)), from the reference implementation */
+static const struct {
+    size_t  len;
+    u8      hash;
+} kVectors[] = {
+    {       0, 0x2d06800538d394c2ULL },
+    {       1, 0xd0d496e05c553485ULL },
+    {       3, 0xcb412fafd0e16539ULL },
+    {       4, 0x4f4b99fe84f2cafdULL },
+    {       8, 0x33277cb46c5eaeb4ULL },
+    {       9, 0xc6f81e3bea15d8e5ULL },
+    {      16, 0xa647e24121484fc9ULL },
+    {      17, 0xf771e8fe473186faULL },
+    {      64, 0x3a3f4944035e501bULL },
+    {     128, 0xd177816bc64b1bb4ULL },
+    {     129, 0x765fa4d985fe65eeULL },
+    {     240, 0x46e148ac50290d2dULL },
+    {     241, 0x98aa8179cc71fcb5ULL },
+    {     255, 0x88e10b0766af0cd8ULL },
+    {     256, 0xacc6ad644701a151ULL },
+    {    1023, 0x54d9d40f4e3f350bULL },
+    {    1024, 0x0bd018ef80ebcb8fULL },
+    {    1025, 0xe32bac2d01c31f3bULL },
+    {    4096, 0x8d2d725c460268bbULL },
+    {   65549, 0x4fdaa4129d46a40aULL },
+    { 1048583, 0xd88c42683e7dab91ULL },
+};
+
+#define kNumVectors (sizeof(kVectors) / sizeof(kVectors[0]))
+
+static u8 nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the same LCG the vectors were generated with */
+static void fillPattern(u1* buf, size_t len)
+{
+    u4 x = 1;
+    for (size_t i = 0; i < len; i++) {
+        x = x * 1103515245u + 12345u;
+        buf[i] = (u1) (x >> 24);
+    }
+}
+
+static bool checkKernel(const char* name, const u1* pattern, u1* scratch)
+{
+    int failures = 0;
+    for (size_t v = 0; v < kNumVectors; v++) {
+        for (size_t off = 0; off < 4; off++) {
+            memcpy(scratch + off, pattern, kVectors[v].len);
+            u8 hash = ycHash64(scratch + off, kVectors[v].len);
+            if (hash != kVectors[v].hash && failures++ < 10) {
+                printf("  %s: mismatch len=%zu off=%zu\n", name,
+                    kVectors[v].len, off);
+            }
+        }
+    }
+    return failures == 0;
+}
+
+int main()
+{
+    size_t maxLen = kVectors[kNumVectors - 1].len;
+    u1* pattern = (u1*) malloc(maxLen);
+    u1* scratch = (u1*) malloc(maxLen + 4);
+    if (pattern == NULL || scratch == NULL) {
+        return 2;
+    }
+    fillPattern(pattern, maxLen);
+
+    bool ok = true;
+    printf("%-8s %12s\n", "kernel", "MB/s");
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++) {
+        const char* name = kKernels[k];
+        if (!ycHashSelectKernel(name)) {
+            continue;
+        }
+        if (!checkKernel(name, pattern, scratch)) {
+            printf("%s: FAILED\n", name);
+            ok = false;
+            continue;
+        }
+
+        const size_t iters = 64;
+        volatile u8 sink = 0;
+        u8 start = nowNs();
+        for (size_t i = 0; i < iters; i++) {
+            sink += ycHash64(pattern, maxLen);
+        }
+        double mb = (double) iters * maxLen / (1 << 20);
+        printf("%-8s %12.0f\n", name, mb / ((nowNs() - start) / 1e9));
+        (void) sink;
+    }
+
+    free(pattern);
+    free(scratch);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include "AdvmpProfiler.h"
+#include "AdvmpThread.h"
+#include "AllocSites.h"
+#include "Latency.h"
+#include "LockContention.h"
+#include "MethodTrace.h"
+#include "OpcodeStats.h"
+#include "PerfCounters.h"
+#include "PerfMap.h"
+#include "Sampler.h"
+#include "Startup.h"
+#include "VmStats.h"
+#include "Common.h"
+#include "log.h"
+
+static jlongArray newLongArray(JNIEnv* env, const u8* values, jsize count)
+{
+    jlongArray array = env->NewLongArray(count);
+    if (array != NULL) {
+        env->SetLongArrayRegion(array, 0, count, (const jlong*) values);
+    }
+    return array;
+}
+
+/*
+ * Call "func" with "path" as a C string.
+ */
+static jboolean withPath(JNIEnv* env, jstring path,
+    bool (*func)(const char* path))
+{
+    const char* pathStr = env->GetStringUTFChars(path, NULL);
+    if (pathStr == NULL) {
+        return JNI_FALSE;
+    }
+    bool ok = func(pathStr);
+    env->ReleaseStringUTFChars(path, pathStr);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+static void startOpcodeCounting(JNIEnv* env, jclass clazz,
+    jboolean countPairs)
+{
+    dvmOpcodeStatsStart(countPairs);
+}
+
+static void stopOpcodeCounting(JNIEnv* env, jclass clazz)
+{
+    dvmOpcodeStatsStop();
+}
+
+static void resetOpcodeCounts(JNIEnv* env, jclass clazz)
+{
+    dvmOpcodeStatsReset();
+}
+
+static jlongArray opcodeCounts(JNIEnv* env, jclass clazz)
+{
+    u8 single[kNumPackedOpcodes];
+    dvmOpcodeStatsSnapshot(single, NULL);
+    return newLongArray(env, single, kNumPackedOpcodes);
+}
+
+static jlongArray opcodePairCounts(JNIEnv* env, jclass clazz)
+{
+    u8 single[kNumPackedOpcodes];
+    u8* pairs = (u8*) malloc(kNumPackedOpcodes * kNumPackedOpcodes * sizeof(u8));
+    if (pairs == NULL) {
+        return NULL;
+    }
+    dvmOpcodeStatsSnapshot(single, pairs);
+    jlongArray array = newLongArray(env, pairs,
+        kNumPackedOpcodes * kNumPackedOpcodes);
+    free(pairs);
+    return array;
+}
+
+static jstring opcodeName(JNIEnv* env, jclass clazz, jint opcode)
+{
+    if (opcode < 0 || opcode >= kNumPackedOpcodes) {
+        return NULL;
+    }
+    return env->NewStringUTF(dexGetOpcodeName((Opcode) opcode));
+}
+
+static jboolean dumpOpcodeCounts(JNIEnv* env, jclass clazz, jstring path)
+{
+    return withPath(env, path, dvmOpcodeStatsDump);
+}
+
+static jlongArray vmStats(JNIEnv* env, jclass clazz)
+{
+    u8 stats[kVmStatCount];
+    dvmVmStatsSnapshot(stats);
+    return newLongArray(env, stats, kVmStatCount);
+}
+
+static jstring vmStatName(JNIEnv* env, jclass clazz, jint stat)
+{
+    const char* name = dvmVmStatName(stat);
+    return name != NULL ? env->NewStringUTF(name) : NULL;
+}
+
+static void startLatencyRecording(JNIEnv* env, jclass clazz, jint clocks)
+{
+    dvmLatencyStart(clocks);
+}
+
+static void stopLatencyRecording(JNIEnv* env, jclass clazz)
+{
+    dvmLatencyStop();
+}
+
+static void resetLatency(JNIEnv* env, jclass clazz)
+{
+    dvmLatencyReset();
+}
+
+/*
+ * { count, p50, p90, p99, max } in nanoseconds, or null if the method
+ * has no samples for that clock.
+ */
+static jlongArray latencySummary(JNIEnv* env, jclass clazz, jint methodIdx,
+    jint clock)
+{
+    LatencySummary summary;
+    if (methodIdx < 0
+        || !dvmLatencySummary(methodIdx, (LatencyClock) clock, &summary))
+    {
+        return NULL;
+    }
+    u8 values[] = {
+        summary.count, summary.p50, summary.p90, summary.p99, summary.max,
+    };
+    return newLongArray(env, values, array_size(values));
+}
+
+static jboolean startPerfCounters(JNIEnv* env, jclass clazz,
+    jboolean sampleOpcodes)
+{
+    return dvmPerfStart(sampleOpcodes) ? JNI_TRUE : JNI_FALSE;
+}
+
+static void stopPerfCounters(JNIEnv* env, jclass clazz)
+{
+    dvmPerfStop();
+}
+
+static void resetPerfCounters(JNIEnv* env, jclass clazz)
+{
+    dvmPerfReset();
+}
+
+static jboolean dumpPerfCounters(JNIEnv* env, jclass clazz, jstring path)
+{
+    return withPath(env, path, dvmPerfDump);
+}
+
+static jboolean writePerfMap(JNIEnv* env, jclass clazz, jstring dir)
+{
+    return withPath(env, dir, dvmPerfMapWrite);
+}
+
+static jboolean startMethodTrace(JNIEnv* env, jclass clazz, jstring path)
+{
+    return withPath(env, path, dvmMethodTraceStart);
+}
+
+static jboolean stopMethodTrace(JNIEnv* env, jclass clazz)
+{
+    return dvmMethodTraceStop() ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean isMethodTracing(JNIEnv* env, jclass clazz)
+{
+    return dvmMethodTraceActive() ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean startSampling(JNIEnv* env, jclass clazz, jint hz,
+    jint capacity, jboolean precise)
+{
+    return dvmSamplerStart(hz, capacity, precise) ? JNI_TRUE : JNI_FALSE;
+}
+
+static void stopSampling(JNIEnv* env, jclass clazz)
+{
+    dvmSamplerStop();
+}
+
+static jboolean isSampling(JNIEnv* env, jclass clazz)
+{
+    return dvmSamplerRunning() ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * { samples taken, samples dropped }
+ */
+static jlongArray samplingCounts(JNIEnv* env, jclass clazz)
+{
+    u8 values[] = { dvmSamplerSampleCount(), dvmSamplerDroppedCount() };
+    return newLongArray(env, values, array_size(values));
+}
+
+static bool writeFoldedWithLines(const char* path)
+{
+    return dvmSamplerWriteFolded(path, true);
+}
+
+static bool writeFoldedWithoutLines(const char* path)
+{
+    return dvmSamplerWriteFolded(path, false);
+}
+
+static jboolean writeFoldedStacks(JNIEnv* env, jclass clazz, jstring path,
+    jboolean withLines)
+{
+    return withPath(env, path,
+        withLines ? writeFoldedWithLines : writeFoldedWithoutLines);
+}
+
+static jboolean writePprof(JNIEnv* env, jclass clazz, jstring path)
+{
+    return withPath(env, path, dvmSamplerWritePprof);
+}
+
+static void startAllocSites(JNIEnv* env, jclass clazz)
+{
+    dvmAllocSitesStart();
+}
+
+static void stopAllocSites(JNIEnv* env, jclass clazz)
+{
+    dvmAllocSitesStop();
+}
+
+static void resetAllocSites(JNIEnv* env, jclass clazz)
+{
+    dvmAllocSitesReset();
+}
+
+static jboolean dumpAllocSites(JNIEnv* env, jclass clazz, jstring path)
+{
+    return withPath(env, path, dvmAllocSitesDump);
+}
+
+static void startLockContention(JNIEnv* env, jclass clazz)
+{
+    dvmLockContentionStart();
+}
+
+static void stopLockContention(JNIEnv* env, jclass clazz)
+{
+    dvmLockContentionStop();
+}
+
+static void resetLockContention(JNIEnv* env, jclass clazz)
+{
+    dvmLockContentionReset();
+}
+
+static jboolean dumpLockContention(JNIEnv* env, jclass clazz, jstring path)
+{
+    return withPath(env, path, dvmLockContentionDump);
+}
+
+static jlongArray startupTimeline(JNIEnv* env, jclass clazz)
+{
+    u8 times[kStartupPhaseCount];
+    dvmStartupTimeline(times);
+    return newLongArray(env, times, kStartupPhaseCount);
+}
+
+static jstring startupPhaseName(JNIEnv* env, jclass clazz, jint phase)
+{
+    const char* name = dvmStartupPhaseName(phase);
+    return name != NULL ? env->NewStringUTF(name) : NULL;
+}
+
+/*
+ * subModes that work on one thread by themselves; the others depend on
+ * state their start call sets up.
+ */
+#define kPerThreadSubModes  (kAdvmpSubModeCheckAlways                       \
+                             | kAdvmpSubModeOpcodeCount                     \
+                             | kAdvmpSubModeAllocSites                      \
+                             | kAdvmpSubModeLockContention)
+
+static jboolean enableThreadSubModes(JNIEnv* env, jclass clazz, jint tid,
+    jint modes)
+{
+    if ((modes & ~kPerThreadSubModes) != 0) {
+        return JNI_FALSE;
+    }
+    return dvmAdvmpEnableSubModeForTid(tid, modes) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean disableThreadSubModes(JNIEnv* env, jclass clazz, jint tid,
+    jint modes)
+{
+    if ((modes & ~kPerThreadSubModes) != 0) {
+        return JNI_FALSE;
+    }
+    return dvmAdvmpDisableSubModeForTid(tid, modes) ? JNI_TRUE : JNI_FALSE;
+}
+
+static void setSafepointInterval(JNIEnv* env, jclass clazz, jint interval)
+{
+    dvmAdvmpSetSafepointInterval(interval);
+}
+
+bool registerProfilerNatives(JNIEnv* env) {
+    const char* classDesc = "com/appvmp/AdvmpProfiler";
+    const JNINativeMethod methods[] = {
+        { "startOpcodeCounting", "(Z)V", (void*) startOpcodeCounting },
+        { "stopOpcodeCounting", "()V", (void*) stopOpcodeCounting },
+        { "resetOpcodeCounts", "()V", (void*) resetOpcodeCounts },
+        { "opcodeCounts", "()[J", (void*) opcodeCounts },
+        { "opcodePairCounts", "()[J", (void*) opcodePairCounts },
+        { "opcodeName", "(I)Ljava/lang/String;", (void*) opcodeName },
+        { "dumpOpcodeCounts", "(Ljava/lang/String;)Z", (void*) dumpOpcodeCounts },
+        { "vmStats", "()[J", (void*) vmStats },
+        { "vmStatName", "(I)Ljava/lang/String;", (void*) vmStatName },
+        { "startLatencyRecording", "(I)V", (void*) startLatencyRecording },
+        { "stopLatencyRecording", "()V", (void*) stopLatencyRecording },
+        { "resetLatency", "()V", (void*) resetLatency },
+        { "latencySummary", "(II)[J", (void*) latencySummary },
+        { "startPerfCounters", "(Z)Z", (void*) startPerfCounters },
+        { "stopPerfCounters", "()V", (void*) stopPerfCounters },
+        { "resetPerfCounters", "()V", (void*) resetPerfCounters },
+        { "dumpPerfCounters", "(Ljava/lang/String;)Z", (void*) dumpPerfCounters },
+        { "writePerfMap", "(Ljava/lang/String;)Z", (void*) writePerfMap },
+        { "startMethodTrace", "(Ljava/lang/String;)Z", (void*) startMethodTrace },
+        { "stopMethodTrace", "()Z", (void*) stopMethodTrace },
+        { "isMethodTracing", "()Z", (void*) isMethodTracing },
+        { "startSampling", "(IIZ)Z", (void*) startSampling },
+        { "stopSampling", "()V", (void*) stopSampling },
+        { "isSampling", "()Z", (void*) isSampling },
+        { "samplingCounts", "()[J", (void*) samplingCounts },
+        { "writeFoldedStacks", "(Ljava/lang/String;Z)Z", (void*) writeFoldedStacks },
+        { "writePprof", "(Ljava/lang/String;)Z", (void*) writePprof },
+        { "startAllocSites", "()V", (void*) startAllocSites },
+        { "stopAllocSites", "()V", (void*) stopAllocSites },
+        { "resetAllocSites", "()V", (void*) resetAllocSites },
+        { "dumpAllocSites", "(Ljava/lang/String;)Z", (void*) dumpAllocSites },
+        { "startLockContention", "()V", (void*) startLockContention },
+        { "stopLockContention", "()V", (void*) stopLockContention },
+        { "resetLockContention", "()V", (void*) resetLockContention },
+        { "dumpLockContention", "(Ljava/lang/String;)Z", (void*) dumpLockContention },
+        { "startupTimeline", "()[J", (void*) startupTimeline },
+        { "startupPhaseName", "(I)Ljava/lang/String;", (void*) startupPhaseName },
+        { "enableThreadSubModes", "(II)Z", (void*) enableThreadSubModes },
+        { "disableThreadSubModes", "(II)Z", (void*) disableThreadSubModes },
+        { "setSafepointInterval", "(I)V", (void*) setSafepointInterval },
+    };
+
+    jclass clazz = env->FindClass(classDesc);
+    if (!clazz) {
+        /* stripped from the app; the instrumentation stays native-only */
+        env->ExceptionClear();
+        MY_LOG_WARNING("not find class: %s", classDesc);
+        return false;
+    }
+
+    bool bRet = false;
+    if ( JNI_OK == env->RegisterNatives(clazz, methods, array_size(methods)) ) {
+        bRet = true;
+    } else {
+        MY_LOG_ERROR("register class:%s.register native method fail.", classDesc);
+    }
+    env->DeleteLocalRef(clazz);
+    return bRet;
+}
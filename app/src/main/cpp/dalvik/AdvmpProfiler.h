@@ -0,0 +1,12 @@
+#ifndef CUSTOMAPPVMP_ADVMPPROFILER_H
+#define CUSTOMAPPVMP_ADVMPPROFILER_H
+
+#include <jni.h>
+
+/*
+ * Natives of com.appvmp.AdvmpProfiler, the Java face of the interpreter's
+ * instrumentation.  Returns false if the class isn't in the app.
+ */
+bool registerProfilerNatives(JNIEnv* env);
+
+#endif //CUSTOMAPPVMP_ADVMPPROFILER_H
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "AdvmpThread.h"
+#include "AllocSites.h"
+#include "Latency.h"
+#include "LockContention.h"
+#include "MethodTrace.h"
+#include "PerfCounters.h"
+#include "OpcodeStats.h"
+#include "Sampler.h"
+#include "log.h"
+
+static pthread_key_t gAdvmpThreadKey;
+static pthread_once_t gAdvmpThreadKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t gAdvmpThreadLock = PTHREAD_MUTEX_INITIALIZER;
+static AdvmpThread* gAdvmpThreads;
+static volatile int32_t gSafepointInterval = kSafepointIntervalDefault;
+
+/*
+ * pthread key destructor: the thread is exiting.
+ */
+static void advmpThreadExit(void* arg)
+{
+    AdvmpThread* thread = (AdvmpThread*) arg;
+
+    pthread_mutex_lock(&gAdvmpThreadLock);
+    AdvmpThread** link = &gAdvmpThreads;
+    while (*link != NULL && *link != thread) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = thread->next;
+    }
+    dvmSamplerThreadExiting(thread);
+    dvmMethodTraceThreadExiting(thread);
+    dvmOpcodeStatsThreadExiting(thread);
+    dvmVmStatsThreadExiting(thread);
+    dvmLatencyThreadExiting(thread);
+    dvmPerfThreadExiting(thread);
+    dvmAllocSitesThreadExiting(thread);
+    pthread_mutex_unlock(&gAdvmpThreadLock);
+
+    free(thread);
+}
+
+static void createThreadKey()
+{
+    if (pthread_key_create(&gAdvmpThreadKey, advmpThreadExit) != 0) {
+        MY_LOG_ERROR("unable to create advmp thread key");
+        abort();
+    }
+}
+
+AdvmpThread* dvmAdvmpThreadSelf(Thread* self)
+{
+    pthread_once(&gAdvmpThreadKeyOnce, createThreadKey);
+    AdvmpThread* thread = (AdvmpThread*) pthread_getspecific(gAdvmpThreadKey);
+    if (thread != NULL) {
+        if (thread->self != self) {
+            /* detached and attached again; the old Thread is gone */
+            pthread_mutex_lock(&gAdvmpThreadLock);
+            thread->self = self;
+            dvmSamplerThreadStarted(thread);
+            pthread_mutex_unlock(&gAdvmpThreadLock);
+        }
+        return thread;
+    }
+
+    thread = (AdvmpThread*) calloc(1, sizeof(AdvmpThread));
+    if (thread == NULL) {
+        MY_LOG_ERROR("unable to allocate advmp thread state");
+        abort();
+    }
+    thread->self = self;
+    thread->tid = (pid_t) syscall(__NR_gettid);
+    thread->handle = pthread_self();
+    pthread_setspecific(gAdvmpThreadKey, thread);
+
+    pthread_mutex_lock(&gAdvmpThreadLock);
+    thread->safepointInterval = gSafepointInterval;
+    thread->next = gAdvmpThreads;
+    gAdvmpThreads = thread;
+    dvmSamplerThreadStarted(thread);
+    dvmMethodTraceThreadStarted(thread);
+    dvmOpcodeStatsThreadStarted(thread);
+    dvmAllocSitesThreadStarted(thread);
+    dvmLockContentionThreadStarted(thread);
+    pthread_mutex_unlock(&gAdvmpThreadLock);
+    return thread;
+}
+
+AdvmpThread* dvmAdvmpThreadCurrent()
+{
+    /* the key exists before any thread could have been registered */
+    if (gAdvmpThreads == NULL) {
+        return NULL;
+    }
+    return (AdvmpThread*) pthread_getspecific(gAdvmpThreadKey);
+}
+
+void dvmAdvmpEnableSubMode(AdvmpThread* thread, int32_t mode)
+{
+    __sync_fetch_and_or(&thread->subMode, mode);
+    thread->safepointRequested = 1;
+}
+
+void dvmAdvmpDisableSubMode(AdvmpThread* thread, int32_t mode)
+{
+    __sync_fetch_and_and(&thread->subMode, ~mode);
+    thread->safepointRequested = 1;
+}
+
+static bool updateSubModeForTid(pid_t tid, int32_t mode, bool enable)
+{
+    bool found = false;
+    pthread_mutex_lock(&gAdvmpThreadLock);
+    for (AdvmpThread* thread = gAdvmpThreads; thread != NULL;
+         thread = thread->next)
+    {
+        if (thread->tid == tid) {
+            if (enable) {
+                dvmAdvmpEnableSubMode(thread, mode);
+            } else {
+                dvmAdvmpDisableSubMode(thread, mode);
+            }
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gAdvmpThreadLock);
+    return found;
+}
+
+bool dvmAdvmpEnableSubModeForTid(pid_t tid, int32_t mode)
+{
+    return updateSubModeForTid(tid, mode, true);
+}
+
+bool dvmAdvmpDisableSubModeForTid(pid_t tid, int32_t mode)
+{
+    return updateSubModeForTid(tid, mode, false);
+}
+
+void dvmAdvmpSetSafepointInterval(int interval)
+{
+    int32_t value = interval;
+    if (value < 1) {
+        value = 1;
+    } else if (value > kSafepointIntervalMax) {
+        value = kSafepointIntervalMax;
+    }
+    /* update the default under the lock, so no new thread misses it */
+    pthread_mutex_lock(&gAdvmpThreadLock);
+    gSafepointInterval = value;
+    for (AdvmpThread* thread = gAdvmpThreads; thread != NULL;
+         thread = thread->next)
+    {
+        thread->safepointInterval = value;
+    }
+    pthread_mutex_unlock(&gAdvmpThreadLock);
+}
+
+void dvmAdvmpForEachThread(void (*func)(AdvmpThread* thread, void* arg),
+    void* arg)
+{
+    pthread_mutex_lock(&gAdvmpThreadLock);
+    dvmAdvmpForEachThreadLocked(func, arg);
+    pthread_mutex_unlock(&gAdvmpThreadLock);
+}
+
+void dvmAdvmpLockThreadList()
+{
+    pthread_mutex_lock(&gAdvmpThreadLock);
+}
+
+void dvmAdvmpUnlockThreadList()
+{
+    pthread_mutex_unlock(&gAdvmpThreadLock);
+}
+
+void dvmAdvmpForEachThreadLocked(
+    void (*func)(AdvmpThread* thread, void* arg), void* arg)
+{
+    for (AdvmpThread* thread = gAdvmpThreads; thread != NULL;
+         thread = thread->next)
+    {
+        func(thread, arg);
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef CUSTOMAPPVMP_ADVMPTHREAD_H
+#define CUSTOMAPPVMP_ADVMPTHREAD_H
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include "Thread.h"
+#include "VmStats.h"
+
+/*
+ * Per-thread state of our own, kept beside libdvm's Thread (which we can't
+ * extend).  Created the first time a thread enters the interpreter and
+ * freed when the thread exits.
+ *
+ * "subMode" is the advmp counterpart of interpBreak.ctl.subMode.  It can
+ * be set per thread from any other thread; the bits in
+ * kAdvmpAltTableSubModes move the thread onto the instrumented handler
+ * table.
+ */
+enum AdvmpSubMode {
+    kAdvmpSubModeNormal         = 0x0000,
+    kAdvmpSubModeCheckAlways    = 0x0001,   /* instrumented table, nothing else */
+    kAdvmpSubModeSamplePc       = 0x0002,   /* keep curPc current, for the sampler */
+    kAdvmpSubModeMethodTrace    = 0x0004,   /* MethodTrace events; main table */
+    kAdvmpSubModeOpcodeCount    = 0x0008,   /* OpcodeStats counting */
+    kAdvmpSubModePerfSample     = 0x0010,   /* keep curPc current, for PerfCounters */
+    kAdvmpSubModeAllocSites     = 0x0020,   /* AllocSites recording; main table */
+    kAdvmpSubModeLockContention = 0x0040,   /* LockContention recording; main table */
+};
+
+/* advmp subModes that need the instrumented table */
+#define kAdvmpAltTableSubModes  (kAdvmpSubModeCheckAlways                   \
+                                 | kAdvmpSubModeSamplePc                    \
+                                 | kAdvmpSubModeOpcodeCount                 \
+                                 | kAdvmpSubModePerfSample)
+
+struct OpcodeCounts;
+
+struct MethodLatency;
+
+struct PerfThread;
+
+struct AllocSiteTable;
+
+struct TraceChunk;
+
+/*
+ * Backward branches between suspend checks.  The interpreter keeps the
+ * countdown in a local and only reads the suspend flag when it runs out,
+ * so a GC or debugger suspend waits for at most this many loop
+ * iterations.  1 checks on every backward branch, like dalvik.
+ */
+#define kSafepointIntervalDefault   64
+#define kSafepointIntervalMax       1024
+
+struct AdvmpThread {
+    Thread*         self;
+    pid_t           tid;
+    volatile int32_t subMode;       /* AdvmpSubMode bits */
+    volatile int32_t safepointInterval;
+    volatile int32_t safepointRequested;    /* expire the countdown now */
+    pthread_t       handle;
+
+    /* pc of the current instruction, on the instrumented table */
+    const u2* volatile curPc;
+
+    /* SIGPROF timer; owned by the sampler, guarded by gAdvmpThreadLock */
+    timer_t         sampleTimer;
+    bool            hasSampleTimer;
+
+    /* MethodTrace buffer; see dvmMethodTraceEvent */
+    TraceChunk* volatile traceChunk;
+    volatile int32_t traceBusy;
+
+    /* OpcodeStats; only the thread itself writes these */
+    OpcodeCounts*   opcodeCounts;
+    u2              prevOpcode;
+
+    /* VmStats counters; only the thread itself writes these */
+    u8              stats[kVmStatCount];
+
+    /* Latency histograms by method; the table is grown under the lock */
+    MethodLatency** latency;
+    u4              latencyCount;
+
+    /* PerfCounters state, created on the first counted bridge call */
+    PerfThread*     perf;
+
+    /* AllocSites; only the thread itself inserts */
+    AllocSiteTable* allocSites;
+
+    AdvmpThread*    next;           /* registry; guarded by gAdvmpThreadLock */
+};
+
+/*
+ * libdvm subModes that need the instrumented table.  A pending suspend
+ * is handled by the backward-branch check instead.
+ */
+#define kAltTableSubModes   (0xffff & ~kSubModeSuspendPending)
+
+/*
+ * Returns the calling thread's AdvmpThread, creating it if necessary.
+ */
+AdvmpThread* dvmAdvmpThreadSelf(Thread* self);
+
+/*
+ * Returns the calling thread's AdvmpThread, or NULL if it has none (or is
+ * exiting).  Safe to call from a signal handler.
+ */
+AdvmpThread* dvmAdvmpThreadCurrent();
+
+/*
+ * Set or clear subMode bits.  Also sets safepointRequested, so the change
+ * takes effect at the thread's next check point (backward branch, return
+ * or throw) instead of when its safepoint countdown runs out.
+ */
+void dvmAdvmpEnableSubMode(AdvmpThread* thread, int32_t mode);
+void dvmAdvmpDisableSubMode(AdvmpThread* thread, int32_t mode);
+
+/*
+ * Same, for the thread with kernel id "tid".  Returns false if that
+ * thread has never entered the interpreter.
+ */
+bool dvmAdvmpEnableSubModeForTid(pid_t tid, int32_t mode);
+bool dvmAdvmpDisableSubModeForTid(pid_t tid, int32_t mode);
+
+/*
+ * Set the safepoint interval of every thread, present and future.
+ * Clamped to [1, kSafepointIntervalMax].  Threads already in a loop pick
+ * the new value up at their next suspend check.
+ */
+void dvmAdvmpSetSafepointInterval(int interval);
+
+/*
+ * Call "func" on every registered thread, with the registry locked.
+ */
+void dvmAdvmpForEachThread(void (*func)(AdvmpThread* thread, void* arg),
+    void* arg);
+
+/*
+ * The registry lock, for state that the thread start/exit hooks move
+ * between a thread and a global.  dvmAdvmpForEachThreadLocked is the
+ * iteration for callers that already hold it.
+ */
+void dvmAdvmpLockThreadList();
+void dvmAdvmpUnlockThreadList();
+void dvmAdvmpForEachThreadLocked(
+    void (*func)(AdvmpThread* thread, void* arg), void* arg);
+
+#endif //CUSTOMAPPVMP_ADVMPTHREAD_H
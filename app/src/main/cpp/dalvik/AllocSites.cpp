@@ -0,0 +1,323 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "AllocSites.h"
+#include "Array.h"
+#include "Stack.h"
+#include "atomic-arm.h"
+#include "log.h"
+
+#define kAllocSiteRetiredSize   8192
+
+static volatile int32_t gAllocSitesActive;
+
+/* sites of exited threads; guarded by the thread list lock */
+static AllocSite* gRetiredSites;
+static u4 gRetiredUsed;
+static u8 gRetiredDropped;
+
+static size_t objectBytes(const Object* obj)
+{
+    const ClassObject* clazz = obj->clazz;
+    if (!dvmIsArrayClass(clazz)) {
+        return clazz->objectSize;
+    }
+    size_t width;
+    switch (clazz->descriptor[1]) {
+    case 'Z':
+    case 'B':
+        width = 1;
+        break;
+    case 'C':
+    case 'S':
+        width = 2;
+        break;
+    case 'J':
+    case 'D':
+        width = 8;
+        break;
+    default:
+        width = 4;
+        break;
+    }
+    /* ArrayObject isn't standard-layout, so no offsetof */
+    const ArrayObject* array = (const ArrayObject*) obj;
+    size_t header = (const u1*) array->contents - (const u1*) obj;
+    return header + (size_t) array->length * width;
+}
+
+static u4 hashSite(const Method* method, u4 pcOffset)
+{
+    return (u4) ((uintptr_t) method >> 3) ^ (pcOffset * 0x9e3779b1u);
+}
+
+/*
+ * Find the slot for (method, pcOffset) in a table of "size" sites,
+ * claiming a free one if it isn't there.  NULL when the table is 3/4
+ * full.  Only one thread may insert into a table.
+ */
+static AllocSite* findSite(AllocSite* sites, u4 size, u4* pUsed,
+    const Method* method, u4 pcOffset, ClassObject* clazz)
+{
+    u4 mask = size - 1;
+    for (u4 idx = hashSite(method, pcOffset) & mask; ; idx = (idx + 1) & mask) {
+        AllocSite* site = &sites[idx];
+        const Method* cur = site->method;
+        if (cur == method && site->pcOffset == pcOffset) {
+            return site;
+        }
+        if (cur == NULL) {
+            if (*pUsed >= size / 4 * 3) {
+                return NULL;
+            }
+            site->pcOffset = pcOffset;
+            site->clazz = clazz;
+            ANDROID_MEMBAR_STORE();
+            site->method = method;
+            (*pUsed)++;
+            return site;
+        }
+    }
+}
+
+void dvmAllocSitesRecord(AdvmpThread* thread, const Method* method,
+    const u2* pc, const Object* obj)
+{
+    AllocSiteTable* table = thread->allocSites;
+    if (table == NULL) {
+        table = (AllocSiteTable*) calloc(1, sizeof(AllocSiteTable));
+        if (table == NULL) {
+            MY_LOG_ERROR("unable to allocate allocation site table");
+            dvmAdvmpDisableSubMode(thread, kAdvmpSubModeAllocSites);
+            return;
+        }
+        /* published under the lock; readers walk the thread list */
+        dvmAdvmpLockThreadList();
+        thread->allocSites = table;
+        dvmAdvmpUnlockThreadList();
+    }
+
+    AllocSite* site = findSite(table->sites, kAllocSiteTableSize, &table->used,
+        method, pc - method->insns, obj->clazz);
+    if (site == NULL) {
+        table->dropped++;
+        return;
+    }
+    site->count++;
+    site->bytes += objectBytes(obj);
+}
+
+/*
+ * Add "src"'s live sites into "dst".  Caller holds the thread list lock.
+ * Returns the allocations of sites that didn't fit.
+ */
+static u8 mergeSites(AllocSite* dst, u4 dstSize, u4* pDstUsed,
+    const AllocSite* src, u4 srcSize)
+{
+    u8 dropped = 0;
+    for (u4 i = 0; i < srcSize; i++) {
+        const Method* method = src[i].method;
+        if (method == NULL) {
+            continue;
+        }
+        ANDROID_MEMBAR_FULL();
+        AllocSite* site = findSite(dst, dstSize, pDstUsed, method,
+            src[i].pcOffset, src[i].clazz);
+        if (site == NULL) {
+            dropped += dvmReadCounter64(&src[i].count);
+            continue;
+        }
+        site->count += dvmReadCounter64(&src[i].count);
+        site->bytes += dvmReadCounter64(&src[i].bytes);
+    }
+    return dropped;
+}
+
+static void enableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpEnableSubMode(thread, kAdvmpSubModeAllocSites);
+}
+
+static void disableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpDisableSubMode(thread, kAdvmpSubModeAllocSites);
+}
+
+void dvmAllocSitesStart()
+{
+    dvmAdvmpLockThreadList();
+    gAllocSitesActive = 1;
+    dvmAdvmpForEachThreadLocked(enableThread, NULL);
+    dvmAdvmpUnlockThreadList();
+}
+
+void dvmAllocSitesStop()
+{
+    dvmAdvmpLockThreadList();
+    gAllocSitesActive = 0;
+    dvmAdvmpForEachThreadLocked(disableThread, NULL);
+    dvmAdvmpUnlockThreadList();
+}
+
+static void resetThread(AdvmpThread* thread, void* arg)
+{
+    /*
+     * Only the counts: the owner may be inserting, so the keys stay.
+     * Racing increments may survive; that's fine for a profile.
+     */
+    AllocSiteTable* table = thread->allocSites;
+    if (table == NULL) {
+        return;
+    }
+    for (u4 i = 0; i < kAllocSiteTableSize; i++) {
+        table->sites[i].count = 0;
+        table->sites[i].bytes = 0;
+    }
+    table->dropped = 0;
+}
+
+void dvmAllocSitesReset()
+{
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(resetThread, NULL);
+    free(gRetiredSites);
+    gRetiredSites = NULL;
+    gRetiredUsed = gRetiredDropped = 0;
+    dvmAdvmpUnlockThreadList();
+}
+
+void dvmAllocSitesThreadStarted(AdvmpThread* thread)
+{
+    if (gAllocSitesActive) {
+        enableThread(thread, NULL);
+    }
+}
+
+void dvmAllocSitesThreadExiting(AdvmpThread* thread)
+{
+    AllocSiteTable* table = thread->allocSites;
+    if (table == NULL) {
+        return;
+    }
+    thread->allocSites = NULL;
+
+    if (gRetiredSites == NULL) {
+        gRetiredSites = (AllocSite*) calloc(kAllocSiteRetiredSize,
+            sizeof(AllocSite));
+    }
+    if (gRetiredSites != NULL) {
+        gRetiredDropped += table->dropped + mergeSites(gRetiredSites,
+            kAllocSiteRetiredSize, &gRetiredUsed, table->sites,
+            kAllocSiteTableSize);
+    }
+    free(table);
+}
+
+struct MergeArgs {
+    AllocSite*  sites;
+    u4          size;
+    u4          used;
+    u8          dropped;
+};
+
+static void countThreadSites(AdvmpThread* thread, void* arg)
+{
+    if (thread->allocSites != NULL) {
+        *(u4*) arg += thread->allocSites->used;
+    }
+}
+
+static void mergeThreadSites(AdvmpThread* thread, void* arg)
+{
+    MergeArgs* args = (MergeArgs*) arg;
+    AllocSiteTable* table = thread->allocSites;
+    if (table != NULL) {
+        args->dropped += table->dropped + mergeSites(args->sites, args->size,
+            &args->used, table->sites, kAllocSiteTableSize);
+    }
+}
+
+static int compareSites(const void* a, const void* b)
+{
+    const AllocSite* sa = *(const AllocSite* const*) a;
+    const AllocSite* sb = *(const AllocSite* const*) b;
+    if (sa->bytes != sb->bytes) {
+        return sa->bytes > sb->bytes ? -1 : 1;
+    }
+    return sa->count > sb->count ? -1 : (sa->count < sb->count);
+}
+
+bool dvmAllocSitesDump(const char* path)
+{
+    MergeArgs args = { NULL, 16, 0, 0 };
+    AllocSite** sorted = NULL;
+    FILE* fp = NULL;
+    bool ok = false;
+
+    /*
+     * Threads add sites without the lock; the slack covers the few that
+     * may appear meanwhile, and any that don't fit count as dropped.
+     */
+    dvmAdvmpLockThreadList();
+    u4 total = gRetiredUsed;
+    dvmAdvmpForEachThreadLocked(countThreadSites, &total);
+    while (args.size / 2 <= total) {
+        args.size *= 2;
+    }
+    args.sites = (AllocSite*) calloc(args.size, sizeof(AllocSite));
+    if (args.sites != NULL) {
+        dvmAdvmpForEachThreadLocked(mergeThreadSites, &args);
+        if (gRetiredSites != NULL) {
+            args.dropped += gRetiredDropped + mergeSites(args.sites, args.size,
+                &args.used, gRetiredSites, kAllocSiteRetiredSize);
+        }
+    }
+    dvmAdvmpUnlockThreadList();
+
+    sorted = (AllocSite**) malloc((args.used + 1) * sizeof(AllocSite*));
+    if (args.sites == NULL || sorted == NULL) {
+        goto bail;
+    }
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        goto bail;
+    }
+
+    {
+        u4 count = 0;
+        for (u4 i = 0; i < args.size; i++) {
+            if (args.sites[i].method != NULL) {
+                sorted[count++] = &args.sites[i];
+            }
+        }
+        qsort(sorted, count, sizeof(AllocSite*), compareSites);
+
+        fprintf(fp, "class,method,pc,line,count,bytes\n");
+        for (u4 i = 0; i < count; i++) {
+            const AllocSite* site = sorted[i];
+            const Method* method = site->method;
+            int line = (dvmLineNumFromPChook != NULL)
+                ? dvmLineNumFromPChook(method, site->pcOffset) : -1;
+            fprintf(fp, "%s,%s.%s,0x%04x,%d,%llu,%llu\n",
+                site->clazz->descriptor, method->clazz->descriptor,
+                method->name, site->pcOffset, line,
+                (unsigned long long) site->count,
+                (unsigned long long) site->bytes);
+        }
+        if (args.dropped != 0) {
+            fprintf(fp, "# %llu allocations at sites past the table size\n",
+                (unsigned long long) args.dropped);
+        }
+    }
+    ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+bail:
+    free(sorted);
+    free(args.sites);
+    return ok;
+}
@@ -0,0 +1,60 @@
+#ifndef CUSTOMAPPVMP_ALLOCSITES_H
+#define CUSTOMAPPVMP_ALLOCSITES_H
+
+#include "Common.h"
+#include "AdvmpThread.h"
+#include "Object.h"
+
+/*
+ * Allocation sites of protected code: new-instance, new-array and
+ * filled-new-array, keyed by (method, pc).  Each thread counts into its
+ * own fixed-size table while kAdvmpSubModeAllocSites is set; tables are
+ * merged when dumped.  Sites past a thread's table size are only counted
+ * as dropped.
+ *
+ * libdvm's Thread::allocProf is libdvm's own (Debug.startAllocCounting)
+ * and isn't touched.
+ */
+#define kAllocSiteTableSize     1024        /* per thread, power of 2 */
+
+struct AllocSite {
+    const Method* volatile method;          /* set last; NULL if free */
+    u4              pcOffset;
+    ClassObject*    clazz;
+    u8              count;
+    u8              bytes;
+};
+
+struct AllocSiteTable {
+    u4              used;
+    u4              dropped;
+    AllocSite       sites[kAllocSiteTableSize];
+};
+
+/*
+ * Count "obj", just allocated by the instruction at "pc" of "method".
+ * Only called by the interpreter, and only while the subMode is set.
+ */
+void dvmAllocSitesRecord(AdvmpThread* thread, const Method* method,
+    const u2* pc, const Object* obj);
+
+/*
+ * Turn recording on or off for every interpreter thread, present and
+ * future.  Counts are kept until reset.
+ */
+void dvmAllocSitesStart();
+void dvmAllocSitesStop();
+void dvmAllocSitesReset();
+
+/*
+ * Write the merged sites as CSV, most bytes first.
+ */
+bool dvmAllocSitesDump(const char* path);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmAllocSitesThreadStarted(AdvmpThread* thread);
+void dvmAllocSitesThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_ALLOCSITES_H
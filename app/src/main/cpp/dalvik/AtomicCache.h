@@ -118,6 +118,11 @@ void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
 #else
 # define CACHE_XARG(_value)
 #endif
+/*
+ * The user defines ATOMIC_CACHE_CALC (the slow path), ATOMIC_CACHE_NULL_ALLOWED
+ * and ATOMIC_CACHE_STAT(_event), which is handed Hits, Misses, Fills or
+ * Fails for each lookup.  Define it as nothing to skip counting.
+ */
 #define ATOMIC_CACHE_LOOKUP(_cache, _cacheSize, _key1, _key2) ({            \
     AtomicCacheEntry* pEntry;                                               \
     int hash;                                                               \
@@ -148,11 +153,13 @@ void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
              */                                                             \
             if (CALC_CACHE_STATS)                                           \
                 (_cache)->fail++;                                           \
+            ATOMIC_CACHE_STAT(Fails);                                       \
             value = (u4) ATOMIC_CACHE_CALC;                                 \
         } else {                                                            \
             /* all good */                                                  \
             if (CALC_CACHE_STATS)                                           \
                 (_cache)->hits++;                                           \
+            ATOMIC_CACHE_STAT(Hits);                                        \
         }                                                                   \
     } else {                                                                \
         /*                                                                  \
@@ -161,8 +168,10 @@ void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
          * setup for this method simpler, which gives us a ~10% speed       \
          * boost.                                                           \
          */                                                                 \
+        ATOMIC_CACHE_STAT(Misses);                                          \
         value = (u4) ATOMIC_CACHE_CALC;                                     \
-        if (value == 0 && ATOMIC_CACHE_NULL_ALLOWED) { \
+        if (value != 0 || ATOMIC_CACHE_NULL_ALLOWED) {                      \
+            ATOMIC_CACHE_STAT(Fills);                                       \
             dvmUpdateAtomicCache((u4) (_key1), (u4) (_key2), value, pEntry, \
                         firstVersion CACHE_XARG(_cache) ); \
         } \
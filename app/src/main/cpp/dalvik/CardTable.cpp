@@ -5,12 +5,46 @@
 
 #include "CardTable.h"
 dvmMarkCard_func dvmMarkCardHook;
+CardTableInfo gCardTable;
+
+/*
+ * dvmCardFromAddr is plain arithmetic on gDvm.biasedCardTableBase (the
+ * bounds assert is compiled out of release libdvm), so probing it with
+ * arbitrary addresses is safe.  The card shift is the smallest power of
+ * two whose address lands on the next card.  libdvm biases the base so its
+ * low byte equals GC_CARD_DIRTY; that doubles as a check that we are
+ * talking to the layout we expect.
+ */
+static void discoverCardTable(void *dvm_hand) {
+    if (gCardTable.biasedBase != NULL) {
+        return;
+    }
+    dvmCardFromAddr_func cardFromAddr =
+        (dvmCardFromAddr_func)dlsym(dvm_hand, "dvmCardFromAddr");
+    if (!cardFromAddr) {
+        return;
+    }
+    u1* base = cardFromAddr(NULL);
+    if (base == NULL || (u1)(uintptr_t)base != GC_CARD_DIRTY) {
+        return;
+    }
+    for (u4 shift = 4; shift < 16; shift++) {
+        if (cardFromAddr((const void*)((uintptr_t)1 << shift)) == base + 1) {
+            gCardTable.shift = shift;
+            __sync_synchronize();   /* publish shift before base */
+            gCardTable.biasedBase = base;
+            return;
+        }
+    }
+}
+
 bool initCarTableFuction(void *dvm_hand,int apilevel){
     if (dvm_hand) {
         dvmMarkCardHook = (dvmMarkCard_func)dlsym(dvm_hand,"dvmMarkCard");
         if (!dvmMarkCardHook) {
             return JNI_FALSE;
         }
+        discoverCardTable(dvm_hand);
         return JNI_TRUE;
     } else {
         return JNI_FALSE;
@@ -6,9 +6,43 @@
 #define CUSTOMAPPVMP_CARDTABLE_H
 
 #include <dlfcn.h>
+#include <stdint.h>
 #include <jni.h>
 #include "base.h"
+#include "Common.h"
+#include "Inlines.h"
+
+#define GC_CARD_CLEAN 0
+#define GC_CARD_DIRTY 0x70
+
 typedef void (*dvmMarkCard_func)(const void *addr);
+typedef u1* (*dvmCardFromAddr_func)(const void *addr);
 extern dvmMarkCard_func dvmMarkCardHook;
 bool initCarTableFuction(void *dvm_hand,int apilevel);
+
+/*
+ * libdvm's card table geometry, discovered once by initCarTableFuction.
+ * "biasedBase" is gDvm.biasedCardTableBase (the value every Thread keeps
+ * in self->cardTable); the card for an address is
+ * biasedBase[addr >> shift].  It stays NULL if the layout couldn't be
+ * confirmed, and the barriers then call dvmMarkCardHook instead.
+ */
+struct CardTableInfo {
+    u1* biasedBase;
+    u4  shift;
+};
+extern CardTableInfo gCardTable;
+
+/*
+ * Dirty the card holding "addr".
+ */
+INLINE void dvmMarkCardInline(const void *addr)
+{
+    u1* base = gCardTable.biasedBase;
+    if (base != NULL) {
+        base[(uintptr_t)addr >> gCardTable.shift] = GC_CARD_DIRTY;
+    } else {
+        dvmMarkCardHook(addr);
+    }
+}
 #endif //CUSTOMAPPVMP_CARDTABLE_H
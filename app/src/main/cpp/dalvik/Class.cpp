@@ -6,6 +6,7 @@
 
 #include "Class.h"
 dvmInitClass_func dvmInitClassHook;
+dvmFindSystemClassNoInit_func dvmFindSystemClassNoInitHook;
 bool initClassFuction(void *dvm_hand,int apilevel){
 
     if (dvm_hand) {
@@ -13,6 +14,8 @@ bool initClassFuction(void *dvm_hand,int apilevel){
         if (!dvmInitClassHook) {
             return JNI_FALSE;
         }
+        /* optional: only used to bind intrinsics */
+        dvmFindSystemClassNoInitHook = (dvmFindSystemClassNoInit_func)dlsym(dvm_hand,"dvmFindSystemClassNoInit");
         return JNI_TRUE;
     } else {
         return JNI_FALSE;
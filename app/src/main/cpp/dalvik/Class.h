@@ -13,5 +13,7 @@ INLINE bool dvmIsClassInitialized(const ClassObject* clazz) {
 }
 typedef bool (*dvmInitClass_func)(ClassObject* clazz);
 extern dvmInitClass_func dvmInitClassHook;
+typedef ClassObject* (*dvmFindSystemClassNoInit_func)(const char* descriptor);
+extern dvmFindSystemClassNoInit_func dvmFindSystemClassNoInitHook;
 bool initClassFuction(void *dvm_hand,int apilevel);
 #endif //CUSTOMAPPVMP_CLASS_H
@@ -6,16 +6,23 @@
 #define CUSTOMAPPVMP_FINDINTERFACE_H
 
 #include "AtomicCache.h"
+#include "VmStats.h"
+
+/*
+ * "stats" is the calling thread's VmStats counters.
+ */
 INLINE Method* dvmFindInterfaceMethodInCache(ClassObject* thisClass,
-u4 methodIdx, const Method* method, DvmDex* methodClassDex)
+u4 methodIdx, const Method* method, DvmDex* methodClassDex, u8* stats)
 {
 #define ATOMIC_CACHE_CALC \
     dvmInterpFindInterfaceMethodHook(thisClass, methodIdx, method, methodClassDex)
 #define ATOMIC_CACHE_NULL_ALLOWED false
+#define ATOMIC_CACHE_STAT(_event) (stats[kVmStatInterfaceCache##_event]++)
 
 return (Method*) ATOMIC_CACHE_LOOKUP(methodClassDex->pInterfaceCache,
 DEX_INTERFACE_CACHE_SIZE, thisClass, methodIdx);
 
 #undef ATOMIC_CACHE_CALC
+#undef ATOMIC_CACHE_STAT
 }
 #endif //CUSTOMAPPVMP_FINDINTERFACE_H
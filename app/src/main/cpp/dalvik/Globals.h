@@ -1,6 +1,33 @@
 #pragma once
 
 #include <jni.h>
+#include <stddef.h>
+#include "Common.h"
+#include "SysUtil.h"
+#include "YcCache.h"
 
 
 extern JNIEnv *gEnv;
+
+class YcFile;
+
+/*
+ * Process-wide state of the protection runtime, set up in JNI_OnLoad.
+ */
+struct AdvmpGlobals {
+    char*       apkPath;        /* malloc'd */
+
+    /* yc image, mapped from the APK or extracted into anonymous memory */
+    MemMapping  ycMap;
+    const u1*   ycData;
+    size_t      ycSize;
+    u4          ycCrc;          /* crc32 from the zip central directory */
+
+    /* persistent cache of the prepared image, if it was usable */
+    MemMapping  cacheMap;
+    YcCacheKey  cacheKey;
+
+    YcFile*     ycFile;
+};
+
+extern AdvmpGlobals gAdvmp;
@@ -2,6 +2,7 @@
 // Created by liu meng on 2018/9/1.
 //
 #include "InlineNative.h"
+#include "MemUtf16.h"
 
 
 #ifdef HAVE__MEMCMP16
@@ -253,16 +254,14 @@ bool javaLangString_compareTo(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
 
 #else
     /*
-     * Straightforward implementation, examining 16 bits at a time.  Compare
-     * the characters that overlap, and if they're all the same then return
-     * the difference in lengths.
+     * Compare the characters that overlap, and if they're all the same then
+     * return the difference in lengths.  dvmMemcmp16 returns the unsigned
+     * char difference, same as the loop it replaces.
      */
-    int i;
-    for (i = 0; i < minCount; i++) {
-        if (thisChars[i] != compChars[i]) {
-            pResult->i = (s4) thisChars[i] - (s4) compChars[i];
-            return true;
-        }
+    int otherRes = dvmMemcmp16(thisChars, compChars, minCount);
+    if (otherRes != 0) {
+        pResult->i = otherRes;
+        return true;
     }
 #endif
 
@@ -355,25 +354,11 @@ bool javaLangString_equals(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
 # endif
 #else
     /*
-     * Straightforward implementation, examining 16 bits at a time.  The
-     * direction of the loop doesn't matter, and starting at the end may
-     * give us an advantage when comparing certain types of strings (e.g.
-     * class names).
-     *
-     * We want to go forward for benchmarks against __memcmp16 so we get a
-     * meaningful comparison when the strings don't match (could also test
-     * with palindromes).
+     * Vector compare, a register's worth of chars at a time.  Strings that
+     * share a long prefix (e.g. class names) still cost one vector op per
+     * 8-16 chars, so there's no point in scanning from the end any more.
      */
-    int i;
-    //for (i = 0; i < thisCount; i++)
-    for (i = thisCount-1; i >= 0; --i)
-    {
-        if (thisChars[i] != compChars[i]) {
-            pResult->i = false;
-            return true;
-        }
-    }
-    pResult->i = true;
+    pResult->i = dvmMemeq16(thisChars, compChars, thisCount);
 #endif
 
     return true;
@@ -456,12 +441,11 @@ static inline int indexOfCommon(Object* strObj, int ch, int start)
         start++;
     }
 #else
-    /* 16-bit loop, slightly better on ARM */
-    const u2* ptr = chars + start;
-    const u2* endPtr = chars + count;
-    while (ptr < endPtr) {
-        if (*ptr++ == ch)
-            return (ptr-1) - chars;
+    /* vector search; ch > 0xffff can't match, as before */
+    if ((ch & 0xffff) == ch) {
+        int idx = dvmMemchr16(chars + start, (u2) ch, count - start);
+        if (idx >= 0)
+            return start + idx;
     }
 #endif
 
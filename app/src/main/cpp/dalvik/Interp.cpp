@@ -16,6 +16,7 @@ dvmThrowVerificationError_func dvmThrowVerificationErrorHook;
 
 dvmAbort_func dvmAbortHook;
 dvmReportReturn_func dvmReportReturnHook;
+dvmCheckBefore_func dvmCheckBeforeHook;
 bool initInterpFuction(void *dvm_hand,int apilevel){
 
 
@@ -56,6 +57,10 @@ bool initInterpFuction(void *dvm_hand,int apilevel){
         if (!dvmReportReturnHook) {
             return JNI_FALSE;
         }
+        dvmCheckBeforeHook=(dvmCheckBefore_func)dlsym(dvm_hand,"dvmCheckBefore");
+        if (!dvmCheckBeforeHook) {
+            return JNI_FALSE;
+        }
         return JNI_TRUE;
     } else {
         return JNI_FALSE;
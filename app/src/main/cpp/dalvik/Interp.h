@@ -28,6 +28,8 @@ typedef void (*dvmAbort_func)();
 extern dvmAbort_func dvmAbortHook;
 typedef void (*dvmReportReturn_func)(Thread* self);
 extern dvmReportReturn_func dvmReportReturnHook;
+typedef void (*dvmCheckBefore_func)(const u2 *pc, u4 *fp, Thread* self);
+extern dvmCheckBefore_func dvmCheckBeforeHook;
   bool initInterpFuction(void *dvm_hand,int apilevel);
 INLINE void dvmDumpRegs(const Method* method, const u4* framePtr, bool inOnly)
 {
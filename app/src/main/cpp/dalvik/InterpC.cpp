@@ -11,9 +11,16 @@
 #include "FindInterface.h"
 #include "Allocc.h"
 #include "InlineNative.h"
+#include "Intrinsics.h"
 #include "TypeCheck.h"
 #include "Sync.h"
 #include "JniInternal.h"
+#include "AdvmpThread.h"
+#include "MethodTrace.h"
+#include "OpcodeStats.h"
+#include "AllocSites.h"
+#include "LockContention.h"
+#include "Startup.h"
 #include <stdlib.h>
 #include <string.h>
 #include "atomic-arm.h"
@@ -645,17 +652,81 @@ static inline bool checkForNullExportPC(JNIEnv* env, Object* obj, u4* fp, const
 # define FINISH(_offset) {                                                  \
         ADJUST_PC(_offset);                                                 \
         inst = FETCH(0);                                                    \
-        /*if (self->interpBreak.ctl.subMode) {*/                                \
-            /*dvmCheckBefore(pc, fp, self);*/                                   \
-        /*}*/                                                                   \
-        goto *handlerTable[INST_INST(inst)];                                \
+        insnCount++;                                                        \
+        goto *curHandlerTable[INST_INST(inst)];                             \
     }
+
 # define FINISH_BKPT(_opcode) {                                             \
         goto *handlerTable[_opcode];                                        \
     }
 
 #define OP_END
 
+/*
+ * Instrumented dispatch.  Like mterp, we keep two handler tables and
+ * FINISH goes through whichever one is current.  Every entry of the
+ * alternate table leads to one breakout label, which does the checks and
+ * then jumps to the real handler.  Normal execution never tests for
+ * debuggers or profilers per instruction.
+ *
+ * A thread changes tables only in PERIODIC_CHECKS, so invokes stay free
+ * of it.
+ */
+#define H_ALT4(_label)      H(_label), H(_label), H(_label), H(_label)
+#define H_ALT16(_label)     H_ALT4(_label), H_ALT4(_label), H_ALT4(_label), H_ALT4(_label)
+#define H_ALT64(_label)     H_ALT16(_label), H_ALT16(_label), H_ALT16(_label), H_ALT16(_label)
+#define DEFINE_ALT_GOTO_TABLE(_name, _label)                                \
+    static const void* _name[kNumPackedOpcodes] = {                         \
+        H_ALT64(_label), H_ALT64(_label), H_ALT64(_label), H_ALT64(_label)  \
+    }
+
+#define UPDATE_HANDLER_TABLE() {                                            \
+        advmpModes = advmpSelf->subMode;                                    \
+        curHandlerTable =                                                   \
+            ((self->interpBreak.ctl.subMode & kAltTableSubModes) != 0       \
+             || (advmpModes & kAdvmpAltTableSubModes) != 0)                 \
+            ? altHandlerTable : handlerTable;                               \
+    }
+
+/*
+ * Method entry/exit/unwind events for MethodTrace.  "advmpModes" is the
+ * copy UPDATE_HANDLER_TABLE took, so this is a register test when off.
+ */
+#define TRACE_METHOD(_action, _method) {                                    \
+        if ((advmpModes & kAdvmpSubModeMethodTrace) != 0)                   \
+            dvmMethodTraceEvent(advmpSelf, _action, _method);               \
+    }
+
+/*
+ * Count an allocation by the current instruction for AllocSites.  Like
+ * TRACE_METHOD, a register test when off.
+ */
+#define TRACK_ALLOC(_obj) {                                                 \
+        if ((advmpModes & kAdvmpSubModeAllocSites) != 0)                    \
+            dvmAllocSitesRecord(advmpSelf, curMethod, pc, (Object*) (_obj)); \
+    }
+
+/*
+ * Bump one of the calling thread's VmStats counters.
+ */
+#define VM_STAT(_stat)      (advmpSelf->stats[_stat]++)
+
+/*
+ * FINISH counts dispatches in the register "insnCount"; they reach
+ * kVmStatInstructions at each periodic check and when we bail.
+ */
+#define FLUSH_INSN_COUNT() {                                                \
+        advmpSelf->stats[kVmStatInstructions] += insnCount;                 \
+        insnCount = 0;                                                      \
+    }
+
+/*
+ * True if libdvm wants invoke/return/throw events.  Only possible while
+ * we're on the alternate table, so the normal case is a local compare.
+ */
+#define DVM_REPORTING()                                                     \
+    (curHandlerTable != handlerTable && self->interpBreak.ctl.subMode != 0)
+
 /*
  * The "goto" targets just turn into goto statements.  The "arguments" are
  * passed through local variables.
@@ -680,11 +751,29 @@ static inline bool checkForNullExportPC(JNIEnv* env, Object* obj, u4* fp, const
  *
  * While we're at it, see if a debugger has attached or the profiler has
  * started.  If so, switch to a different "goto" table.
+ *
+ * The checks only run once every safepointInterval backward branches,
+ * returns and throws, or on every one while we're on the instrumented
+ * table.  dvmAdvmpEnableSubMode and friends set safepointRequested to
+ * expire the countdown early.  libdvm changes its subModes with the
+ * threads suspended (method tracing, the debugger), so its way in is the
+ * suspend request, after which the table is always re-read.
  */
-#define PERIODIC_CHECKS(_pcadj) {                              \
-        if (dvmCheckSuspendQuick(self)) {                                   \
-            EXPORT_PC();  /* need for precise GC */                         \
-            dvmCheckSuspendPendingHook(self);                                   \
+#define PERIODIC_CHECKS(_pcadj) {                                           \
+        if (--safepointCountdown <= 0 || curHandlerTable != handlerTable    \
+            || advmpSelf->safepointRequested != 0)                          \
+        {                                                                   \
+            safepointCountdown = advmpSelf->safepointInterval;              \
+            FLUSH_INSN_COUNT();                                             \
+            if (advmpSelf->safepointRequested != 0) {                       \
+                advmpSelf->safepointRequested = 0;                          \
+                ANDROID_MEMBAR_FULL();  /* then read the new subMode */     \
+            }                                                               \
+            if (dvmCheckSuspendQuick(self)) {                               \
+                EXPORT_PC();  /* need for precise GC */                     \
+                dvmCheckSuspendPendingHook(self);                           \
+            }                                                               \
+            UPDATE_HANDLER_TABLE();                                         \
         }                                                                   \
     }
 
@@ -1184,6 +1273,7 @@ static inline bool checkForNullExportPC(JNIEnv* env, Object* obj, u4* fp, const
             GOTO_exceptionThrown();                                         \
         ifield = (InstField*) dvmDexGetResolvedField(methodClassDex, ref);  \
         if (ifield == NULL) {                                               \
+            VM_STAT(kVmStatResolveField);                                   \
             ifield = dvmResolveInstFieldhook(curMethod->clazz, ref);            \
             if (ifield == NULL)                                             \
                 GOTO_exceptionThrown();                                     \
@@ -1204,6 +1294,7 @@ static inline bool checkForNullExportPC(JNIEnv* env, Object* obj, u4* fp, const
         sfield = (StaticField*)dvmDexGetResolvedField(methodClassDex, ref); \
         if (sfield == NULL) {                                               \
             EXPORT_PC();                                                    \
+            VM_STAT(kVmStatResolveField);                                   \
             sfield = dvmResolveStaticFieldhook(curMethod->clazz, ref);          \
             if (sfield == NULL)                                             \
                 GOTO_exceptionThrown();                                     \
@@ -1231,6 +1322,7 @@ static inline bool checkForNullExportPC(JNIEnv* env, Object* obj, u4* fp, const
             GOTO_exceptionThrown();                                         \
         ifield = (InstField*) dvmDexGetResolvedField(methodClassDex, ref);  \
         if (ifield == NULL) {                                               \
+            VM_STAT(kVmStatResolveField);                                   \
             ifield = dvmResolveInstFieldhook(curMethod->clazz, ref);            \
             if (ifield == NULL)                                             \
                 GOTO_exceptionThrown();                                     \
@@ -1251,6 +1343,7 @@ static inline bool checkForNullExportPC(JNIEnv* env, Object* obj, u4* fp, const
         sfield = (StaticField*)dvmDexGetResolvedField(methodClassDex, ref); \
         if (sfield == NULL) {                                               \
             EXPORT_PC();                                                    \
+            VM_STAT(kVmStatResolveField);                                   \
             sfield = dvmResolveStaticFieldhook(curMethod->clazz, ref);          \
             if (sfield == NULL)                                             \
                 GOTO_exceptionThrown();                                     \
@@ -1336,6 +1429,8 @@ jvalue BWdvmInterpretPortable(JNIEnv* env) {
     initInterpFuction(dvm_hand,16);
     initExceptionFuction(dvm_hand,16);
     initInlineNaticeFuction(dvm_hand,16);
+    dvmStartupMark(kStartupHooksBound);
+    dvmIntrinsicsStartup();
 
     // 
 //    va_list args;
@@ -1366,10 +1461,33 @@ jvalue BWdvmInterpretPortable(JNIEnv* env) {
 
     /* static computed goto table */
     DEFINE_GOTO_TABLE(handlerTable);
+    DEFINE_ALT_GOTO_TABLE(altHandlerTable, ALT_CHECK_BEFORE);
+    const void* const* curHandlerTable;
+    AdvmpThread* advmpSelf = dvmAdvmpThreadSelf(self);
+    s4 advmpModes;
+    UPDATE_HANDLER_TABLE();
+    s4 safepointCountdown = advmpSelf->safepointInterval;
+    u4 insnCount = 0;
+    VM_STAT(kVmStatBridgeEntries);
+    dvmStartupMark(kStartupFirstInstruction);
 
     // ץȡһָ
     FINISH(0);
 
+/*
+ * Every entry of altHandlerTable lands here, with "inst" already fetched.
+ */
+HANDLE_OPCODE(ALT_CHECK_BEFORE)
+    advmpSelf->curPc = pc;
+    if ((advmpModes & kAdvmpSubModeOpcodeCount) != 0)
+        dvmOpcodeStatsRecord(advmpSelf, INST_INST(inst));
+    if ((self->interpBreak.ctl.subMode & kAltTableSubModes) != 0) {
+        PC_FP_TO_SELF();
+        dvmCheckBeforeHook(pc, fp, self);
+    }
+    FINISH_BKPT(INST_INST(inst));
+OP_END
+
 /*--- start of opcodes ---*/
 
 /* File: c/OP_NOP.cpp */
@@ -1665,6 +1783,7 @@ HANDLE_OPCODE(OP_CONST_STRING /*vAA, string@BBBB*/)
     strObj = dvmDexGetResolvedString(methodClassDex, ref);
     if (strObj == NULL) {
         EXPORT_PC();
+        VM_STAT(kVmStatResolveString);
         strObj = dvmResolveStringhook(curMethod->clazz, ref);
         if (strObj == NULL)
             GOTO_exceptionThrown();
@@ -1685,6 +1804,7 @@ HANDLE_OPCODE(OP_CONST_STRING_JUMBO /*vAA, string@BBBBBBBB*/)
     strObj = dvmDexGetResolvedString(methodClassDex, tmp);
     if (strObj == NULL) {
         EXPORT_PC();
+        VM_STAT(kVmStatResolveString);
         strObj = dvmResolveStringhook(curMethod->clazz, tmp);
         if (strObj == NULL)
             GOTO_exceptionThrown();
@@ -1703,6 +1823,7 @@ HANDLE_OPCODE(OP_CONST_CLASS /*vAA, class@BBBB*/)
     clazz = dvmDexGetResolvedClass(methodClassDex, ref);
     if (clazz == NULL) {
         EXPORT_PC();
+        VM_STAT(kVmStatResolveClass);
         clazz = dvmResolveClasshook(curMethod->clazz, ref, true);
         if (clazz == NULL)
             GOTO_exceptionThrown();
@@ -1724,7 +1845,10 @@ HANDLE_OPCODE(OP_MONITOR_ENTER /*vAA*/)
         GOTO_exceptionThrown();
     MY_LOG_INFO("+ locking %p %s", obj, obj->clazz->descriptor);
     EXPORT_PC();    /* need for precise GC */
-    dvmLockObjectHook(self, obj);
+    if ((advmpModes & kAdvmpSubModeLockContention) != 0)
+        dvmLockObjectProfiled(self, obj, curMethod, pc);
+    else
+        dvmLockObjectInline(self, obj);
 }
 FINISH(1);
 OP_END
@@ -1750,7 +1874,12 @@ HANDLE_OPCODE(OP_MONITOR_EXIT /*vAA*/)
         GOTO_exceptionThrown();
     }
     MY_LOG_INFO("+ unlocking %p %s", obj, obj->clazz->descriptor);
-    if (!dvmUnlockObjectHook(self, obj)) {
+    bool unlocked;
+    if ((advmpModes & kAdvmpSubModeLockContention) != 0)
+        unlocked = dvmUnlockObjectProfiled(self, obj);
+    else
+        unlocked = dvmUnlockObjectInline(self, obj);
+    if (!unlocked) {
         assert(dvmCheckException(self));
         ADJUST_PC(1);
         GOTO_exceptionThrown();
@@ -1779,6 +1908,7 @@ HANDLE_OPCODE(OP_CHECK_CAST /*vAA, class@BBBB*/)
 #endif
         clazz = dvmDexGetResolvedClass(methodClassDex, ref);
         if (clazz == NULL) {
+            VM_STAT(kVmStatResolveClass);
             clazz = dvmResolveClasshook(curMethod->clazz, ref, false);
             if (clazz == NULL)
                 GOTO_exceptionThrown();
@@ -1812,6 +1942,7 @@ HANDLE_OPCODE(OP_INSTANCE_OF /*vA, vB, class@CCCC*/)
         clazz = dvmDexGetResolvedClass(methodClassDex, ref);
         if (clazz == NULL) {
             EXPORT_PC();
+            VM_STAT(kVmStatResolveClass);
             clazz = dvmResolveClasshook(curMethod->clazz, ref, true);
             if (clazz == NULL)
                 GOTO_exceptionThrown();
@@ -1849,6 +1980,7 @@ HANDLE_OPCODE(OP_NEW_INSTANCE /*vAA, class@BBBB*/)
     MY_LOG_INFO("|new-instance v%d,class@0x%04x", vdst, ref);
     clazz = dvmDexGetResolvedClass(methodClassDex, ref);
     if (clazz == NULL) {
+        VM_STAT(kVmStatResolveClass);
         clazz = dvmResolveClasshook(curMethod->clazz, ref, false);
         if (clazz == NULL)
             GOTO_exceptionThrown();
@@ -1878,9 +2010,11 @@ HANDLE_OPCODE(OP_NEW_INSTANCE /*vAA, class@BBBB*/)
     //        clazz->descriptor);
     //    GOTO_exceptionThrown();
     //}
+    VM_STAT(kVmStatAllocations);
     newObj = dvmAllocObjectHook(clazz, ALLOC_DONT_TRACK);
     if (newObj == NULL)
         GOTO_exceptionThrown();
+    TRACK_ALLOC(newObj);
     SET_REGISTER(vdst, (u4) newObj);
 }
 FINISH(2);
@@ -1905,6 +2039,7 @@ HANDLE_OPCODE(OP_NEW_ARRAY /*vA, vB, class@CCCC*/)
     }
     arrayClass = dvmDexGetResolvedClass(methodClassDex, ref);
     if (arrayClass == NULL) {
+        VM_STAT(kVmStatResolveClass);
         arrayClass = dvmResolveClasshook(curMethod->clazz, ref, false);
         if (arrayClass == NULL)
             GOTO_exceptionThrown();
@@ -1913,9 +2048,11 @@ HANDLE_OPCODE(OP_NEW_ARRAY /*vA, vB, class@CCCC*/)
     assert(dvmIsArrayClass(arrayClass));
     assert(dvmIsClassInitialized(arrayClass));
 
+    VM_STAT(kVmStatAllocations);
     newArray = dvmAllocArrayByClassHook(arrayClass, length, ALLOC_DONT_TRACK);
     if (newArray == NULL)
         GOTO_exceptionThrown();
+    TRACK_ALLOC(newArray);
     SET_REGISTER(vdst, (u4) newArray);
 }
 FINISH(2);
@@ -2222,9 +2359,7 @@ HANDLE_OPCODE(OP_APUT_OBJECT /*vAA, vBB, vCC*/)
     }
     obj = (Object*) GET_REGISTER(vdst);
     if (obj != NULL) {
-        if (!checkForNull(env,obj))
-            GOTO_exceptionThrown();
-        if (!dvmCanPutArrayElementHook(obj->clazz, arrayObj->clazz)) {
+        if (!dvmCanPutArrayElementCached(pc, obj->clazz, arrayObj->clazz)) {
             MY_LOG_INFO("Can't put a '%s'(%p) into array type='%s'(%p)",
                   obj->clazz->descriptor, obj,
                   arrayObj->clazz->descriptor, arrayObj);
@@ -3001,7 +3136,7 @@ HANDLE_OPCODE(OP_EXECUTE_INLINE /*vB, {vD, vE, vF, vG}, inline@CCCC*/)
             ;
     }
 
-    if (self->interpBreak.ctl.subMode & kSubModeDebugProfile) {
+    if (DVM_REPORTING() && (self->interpBreak.ctl.subMode & kSubModeDebugProfile)) {
         if (!dvmPerformInlineOp4DbgHook(arg0, arg1, arg2, arg3, &retval, ref))
             GOTO_exceptionThrown();
     } else {
@@ -3101,6 +3236,7 @@ GOTO_TARGET(filledNewArray, bool methodCallRange, bool)
      */
     arrayClass = dvmDexGetResolvedClass(methodClassDex, ref);
     if (arrayClass == NULL) {
+        VM_STAT(kVmStatResolveClass);
         arrayClass = dvmResolveClasshook(curMethod->clazz, ref, false);
         if (arrayClass == NULL)
             GOTO_exceptionThrown();
@@ -3125,34 +3261,57 @@ GOTO_TARGET(filledNewArray, bool methodCallRange, bool)
         /* category 2 primitives not allowed */
         dvmThrowRuntimeException("bad filled array req");
         GOTO_exceptionThrown();
-    } else if (typeCh != 'L' && typeCh != '[' && typeCh != 'I') {
-        /* TODO: requires multiple "fill in" loops with different widths */
-        MY_LOG_INFO("non-int primitives not implemented");
-        dvmThrowInternalError(
-                "filled-new-array not implemented for anything but 'int'");
-        GOTO_exceptionThrown();
     }
 
+    VM_STAT(kVmStatAllocations);
     newArray = dvmAllocArrayByClassHook(arrayClass, vsrc1, ALLOC_DONT_TRACK);
     if (newArray == NULL)
         GOTO_exceptionThrown();
+    TRACK_ALLOC(newArray);
 
     /*
-     * Fill in the elements.  It's legal for vsrc1 to be zero.
+     * Fill in the elements.  It's legal for vsrc1 to be zero.  The range
+     * form reads straight out of the (contiguous) registers; the other
+     * form gathers its registers first, so that each element width needs
+     * just one store loop.
      */
-    contents = (u4*)(void*)newArray->contents;
-    if (methodCallRange) {
-        for (i = 0; i < vsrc1; i++)
-            contents[i] = GET_REGISTER(vdst+i);
-    } else {
-        assert(vsrc1 <= 5);
-        if (vsrc1 == 5) {
-            contents[4] = GET_REGISTER(arg5);
-            vsrc1--;
+    {
+        const u4* elements;
+        u4 gathered[5];
+
+        if (methodCallRange) {
+            elements = fp + vdst;
+        } else {
+            assert(vsrc1 <= 5);
+            if (vsrc1 == 5)
+                gathered[4] = GET_REGISTER(arg5);
+            for (i = 0; i < vsrc1 && i < 4; i++) {
+                gathered[i] = GET_REGISTER(vdst & 0x0f);
+                vdst >>= 4;
+            }
+            elements = gathered;
         }
-        for (i = 0; i < vsrc1; i++) {
-            contents[i] = GET_REGISTER(vdst & 0x0f);
-            vdst >>= 4;
+
+        switch (typeCh) {
+        case 'Z':
+        case 'B': {
+            u1* bytes = (u1*)(void*)newArray->contents;
+            for (i = 0; i < vsrc1; i++)
+                bytes[i] = (u1) elements[i];
+            break;
+        }
+        case 'C':
+        case 'S': {
+            u2* halves = (u2*)(void*)newArray->contents;
+            for (i = 0; i < vsrc1; i++)
+                halves[i] = (u2) elements[i];
+            break;
+        }
+        default:
+            /* 'I', 'F' and references are all register-sized */
+            contents = (u4*)(void*)newArray->contents;
+            memcpy(contents, elements, vsrc1 * sizeof(u4));
+            break;
         }
     }
     if (typeCh == 'L' || typeCh == '[') {
@@ -3200,7 +3359,7 @@ GOTO_TARGET(invokeInterface, bool methodCallRange)
      * actual code we want to execute.
      */
     methodToCall = dvmFindInterfaceMethodInCache(thisClass, ref, curMethod,
-                                                 methodClassDex);
+                                                 methodClassDex, advmpSelf->stats);
 #if defined(WITH_JIT) && defined(MTERP_STUB)
     self->callsiteClass = thisClass;
     self->methodToCall = methodToCall;
@@ -3249,6 +3408,7 @@ GOTO_TARGET(invokeVirtual, bool methodCallRange, bool)
      */
     baseMethod = dvmDexGetResolvedMethod(methodClassDex, ref);
     if (baseMethod == NULL) {
+        VM_STAT(kVmStatResolveMethod);
         baseMethod = dvmResolveMethodhook(curMethod->clazz, ref,METHOD_VIRTUAL);
         if (baseMethod == NULL) {
             MY_LOG_INFO("+ unknown method or access denied");
@@ -3285,6 +3445,7 @@ GOTO_TARGET(exceptionThrown)
 {
     Object* exception;
     int catchRelPc;
+    u4* throwFp;
 
     PERIODIC_CHECKS(0);
 
@@ -3298,6 +3459,7 @@ GOTO_TARGET(exceptionThrown)
     exception = dvmGetException(self);
     dvmAddTrackedAllocHook(exception, self);
     dvmClearException(self);
+    VM_STAT(kVmStatExceptionsThrown);
 
     MY_LOG_INFO("Handling exception %s at %s:%d",
           exception->clazz->descriptor, curMethod->name,
@@ -3317,7 +3479,7 @@ GOTO_TARGET(exceptionThrown)
      * here, and have the JNI exception code do the reporting to the
      * debugger.
      */
-    if (self->interpBreak.ctl.subMode != 0) {
+    if (DVM_REPORTING()) {
         PC_FP_TO_SELF();
         dvmReportExceptionThrowHook(self, exception);
     }
@@ -3337,9 +3499,21 @@ GOTO_TARGET(exceptionThrown)
      * Note this can cause an exception while resolving classes in
      * the "catch" blocks.
      */
+    throwFp = fp;
     catchRelPc = dvmFindCatchBlockHook(self, pc - curMethod->insns,
                                    exception, false, (void**)(void*)&fp);
 
+    /* every frame between the throw and fp was popped */
+    if ((advmpModes & kAdvmpSubModeMethodTrace) != 0) {
+        for (u4* unwoundFp = throwFp; unwoundFp != NULL && unwoundFp != fp;
+             unwoundFp = SAVEAREA_FROM_FP(unwoundFp)->prevFrame)
+        {
+            const Method* unwound = SAVEAREA_FROM_FP(unwoundFp)->method;
+            if (unwound != NULL)
+                dvmMethodTraceEvent(advmpSelf, kMethodTraceUnwind, unwound);
+        }
+    }
+
     /*
      * Restore the stack bounds after an overflow.  This isn't going to
      * be correct in all circumstances, e.g. if JNI code devours the
@@ -3375,6 +3549,7 @@ GOTO_TARGET(exceptionThrown)
         dvmReleaseTrackedAllocHook(exception, self);
         GOTO_bail();
     }
+    VM_STAT(kVmStatExceptionsCaught);
 
 #if DVM_SHOW_EXCEPTION >= 3
     {
@@ -3445,6 +3620,7 @@ GOTO_TARGET(invokeDirect, bool methodCallRange)
 
     methodToCall = dvmDexGetResolvedMethod(methodClassDex, ref);
     if (methodToCall == NULL) {
+        VM_STAT(kVmStatResolveMethod);
         methodToCall = dvmResolveMethodhook(curMethod->clazz, ref,
                                         METHOD_DIRECT);
         if (methodToCall == NULL) {
@@ -3490,6 +3666,7 @@ GOTO_TARGET(invokeSuper, bool methodCallRange)
      */
     baseMethod = dvmDexGetResolvedMethod(methodClassDex, ref);
     if (baseMethod == NULL) {
+        VM_STAT(kVmStatResolveMethod);
         baseMethod = dvmResolveMethodhook(curMethod->clazz, ref,METHOD_VIRTUAL);
         if (baseMethod == NULL) {
             MY_LOG_INFO("+ unknown method or access denied");
@@ -3562,10 +3739,11 @@ GOTO_TARGET(returnFromMethod)
     assert(fp != NULL);
 
     /* Handle any special subMode requirements */
-    if (self->interpBreak.ctl.subMode != 0) {
+    if (DVM_REPORTING()) {
         PC_FP_TO_SELF();
         dvmReportReturnHook(self);
     }
+    TRACE_METHOD(kMethodTraceExit, curMethod);
 
     if (dvmIsBreakFrame(fp)) {
         /* bail without popping the method frame from stack */
@@ -3612,6 +3790,7 @@ else
 
 methodToCall = dvmDexGetResolvedMethod(methodClassDex, ref);
 if (methodToCall == NULL) {
+    VM_STAT(kVmStatResolveMethod);
     methodToCall = dvmResolveMethodhook(curMethod->clazz, ref, METHOD_STATIC);
     if (methodToCall == NULL) {
         MY_LOG_INFO("+ unknown method");
@@ -3694,6 +3873,28 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
         }
 #endif
     }
+
+    /*
+     * Intrinsics run right here, off the arguments we just copied.  Not
+     * when a debugger or profiler is attached: they expect to see every
+     * invoke.
+     */
+    VM_STAT(kVmStatInvokes);
+    if (!DVM_REPORTING()) {
+        IntrinsicFunc intrinsic = dvmFindIntrinsic(methodToCall);
+        if (intrinsic != NULL) {
+            IntrinsicResult result = (*intrinsic)(outs, &retval);
+            if (result == kIntrinsicThrew)
+                GOTO_exceptionThrown();
+            if (result == kIntrinsicDone) {
+                VM_STAT(kVmStatIntrinsicCalls);
+                MY_LOG_INFO("> intrinsic %s.%s retval=0x%llx",
+                      methodToCall->clazz->descriptor, methodToCall->name,
+                      retval.j);
+                FINISH(3);
+            }
+        }
+    }
 }
 
 /*
@@ -3757,7 +3958,7 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
 #endif
     newSaveArea->method = methodToCall;
 
-    if (self->interpBreak.ctl.subMode != 0) {
+    if (DVM_REPORTING()) {
         /*
          * We mark ENTER here for both native and non-native
          * calls.  For native calls, we'll mark EXIT on return.
@@ -3766,6 +3967,7 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
         PC_TO_SELF();
         dvmReportInvokeHook(self, methodToCall);
     }
+    TRACE_METHOD(kMethodTraceEnter, methodToCall);
 
     if (!dvmIsNativeMethod(methodToCall)) {
         /*
@@ -3794,7 +3996,7 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
 
 //        DUMP_REGS(methodToCall, newFp, true);   // show input args
 
-        if (self->interpBreak.ctl.subMode != 0) {
+        if (DVM_REPORTING()) {
             dvmReportPreNativeInvokeHook(methodToCall, self, newSaveArea->prevFrame);
         }
 
@@ -3806,11 +4008,13 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
          * space for locals on native calls, "newFp" points directly
          * to the method arguments.
          */
+        VM_STAT(kVmStatNativeCalls);
         (*methodToCall->nativeFunc)(newFp, &retval, methodToCall, self);
 
-        if (self->interpBreak.ctl.subMode != 0) {
+        if (DVM_REPORTING()) {
             dvmReportPostNativeInvokeHook(methodToCall, self, newSaveArea->prevFrame);
         }
+        TRACE_METHOD(kMethodTraceExit, methodToCall);
 
         /* pop frame off */
         dvmPopJniLocals(self, newSaveArea);
@@ -3849,6 +4053,7 @@ assert(false);      // should not get here
 GOTO_TARGET_END
 
 bail:
+    FLUSH_INSN_COUNT();
     if (NULL != params) {
         delete[] params;
     }
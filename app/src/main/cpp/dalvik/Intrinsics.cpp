@@ -0,0 +1,685 @@
+#include <pthread.h>
+#include <string.h>
+#include "Intrinsics.h"
+#include "Class.h"
+#include "ObjectInlines.h"
+#include "TypeCheck.h"
+#include "UtfString.h"
+#include "WriteBarrier.h"
+#include "log.h"
+
+IntrinsicSlot gIntrinsicSlots[kIntrinsicTableSize];
+
+static pthread_once_t gIntrinsicOnce = PTHREAD_ONCE_INIT;
+static u4 gIntrinsicCount;
+
+union Convert32 {
+    u4 arg;
+    float ff;
+};
+
+union Convert64 {
+    u4 arg[2];
+    s8 ll;
+    double dd;
+};
+
+static inline s8 argLong(const u4* args, int idx)
+{
+    Convert64 convert;
+    convert.arg[0] = args[idx];
+    convert.arg[1] = args[idx + 1];
+    return convert.ll;
+}
+
+static inline float argFloat(const u4* args, int idx)
+{
+    Convert32 convert;
+    convert.arg = args[idx];
+    return convert.ff;
+}
+
+static inline double argDouble(const u4* args, int idx)
+{
+    Convert64 convert;
+    convert.arg[0] = args[idx];
+    convert.arg[1] = args[idx + 1];
+    return convert.dd;
+}
+
+/*
+ * ===========================================================================
+ *      java.lang.Math
+ * ===========================================================================
+ */
+
+static IntrinsicResult javaLangMath_min_long(const u4* args, JValue* pResult)
+{
+    s8 a = argLong(args, 0);
+    s8 b = argLong(args, 2);
+    pResult->j = (a <= b) ? a : b;
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangMath_max_long(const u4* args, JValue* pResult)
+{
+    s8 a = argLong(args, 0);
+    s8 b = argLong(args, 2);
+    pResult->j = (a >= b) ? a : b;
+    return kIntrinsicDone;
+}
+
+/*
+ * The float/double versions follow Math.java: NaN wins, and -0.0 is less
+ * than 0.0, which a plain compare doesn't give us.
+ */
+static IntrinsicResult javaLangMath_min_float(const u4* args, JValue* pResult)
+{
+    float a = argFloat(args, 0);
+    float b = argFloat(args, 1);
+    if (a != a) {
+        pResult->f = a;
+    } else if (a == 0.0f && b == 0.0f && (args[1] & 0x80000000) != 0) {
+        pResult->f = b;
+    } else {
+        pResult->f = (a <= b) ? a : b;
+    }
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangMath_max_float(const u4* args, JValue* pResult)
+{
+    float a = argFloat(args, 0);
+    float b = argFloat(args, 1);
+    if (a != a) {
+        pResult->f = a;
+    } else if (a == 0.0f && b == 0.0f && (args[0] & 0x80000000) != 0) {
+        pResult->f = b;
+    } else {
+        pResult->f = (a >= b) ? a : b;
+    }
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangMath_min_double(const u4* args, JValue* pResult)
+{
+    double a = argDouble(args, 0);
+    double b = argDouble(args, 2);
+    if (a != a) {
+        pResult->d = a;
+    } else if (a == 0.0 && b == 0.0 && argLong(args, 2) < 0) {
+        pResult->d = b;
+    } else {
+        pResult->d = (a <= b) ? a : b;
+    }
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangMath_max_double(const u4* args, JValue* pResult)
+{
+    double a = argDouble(args, 0);
+    double b = argDouble(args, 2);
+    if (a != a) {
+        pResult->d = a;
+    } else if (a == 0.0 && b == 0.0 && argLong(args, 0) < 0) {
+        pResult->d = b;
+    } else {
+        pResult->d = (a >= b) ? a : b;
+    }
+    return kIntrinsicDone;
+}
+
+/*
+ * ===========================================================================
+ *      java.lang.Integer, java.lang.Long
+ * ===========================================================================
+ */
+
+/*
+ * The builtins become clz/rev/popcount (or vcnt) where the CPU has them,
+ * and a short libgcc sequence otherwise.
+ */
+static IntrinsicResult javaLangInteger_bitCount(const u4* args, JValue* pResult)
+{
+    pResult->i = __builtin_popcount(args[0]);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangInteger_numberOfLeadingZeros(const u4* args,
+    JValue* pResult)
+{
+    pResult->i = (args[0] == 0) ? 32 : __builtin_clz(args[0]);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangInteger_numberOfTrailingZeros(const u4* args,
+    JValue* pResult)
+{
+    pResult->i = (args[0] == 0) ? 32 : __builtin_ctz(args[0]);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangInteger_rotateLeft(const u4* args,
+    JValue* pResult)
+{
+    u4 val = args[0];
+    int distance = args[1] & 31;
+    pResult->i = (distance == 0) ? val
+        : (val << distance) | (val >> (32 - distance));
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangInteger_rotateRight(const u4* args,
+    JValue* pResult)
+{
+    u4 val = args[0];
+    int distance = args[1] & 31;
+    pResult->i = (distance == 0) ? val
+        : (val >> distance) | (val << (32 - distance));
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangInteger_reverseBytes(const u4* args,
+    JValue* pResult)
+{
+    pResult->i = __builtin_bswap32(args[0]);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangLong_bitCount(const u4* args, JValue* pResult)
+{
+    pResult->i = __builtin_popcountll((u8) argLong(args, 0));
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangLong_numberOfLeadingZeros(const u4* args,
+    JValue* pResult)
+{
+    u8 val = (u8) argLong(args, 0);
+    pResult->i = (val == 0) ? 64 : __builtin_clzll(val);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangLong_numberOfTrailingZeros(const u4* args,
+    JValue* pResult)
+{
+    u8 val = (u8) argLong(args, 0);
+    pResult->i = (val == 0) ? 64 : __builtin_ctzll(val);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangLong_rotateLeft(const u4* args, JValue* pResult)
+{
+    u8 val = (u8) argLong(args, 0);
+    int distance = args[2] & 63;
+    pResult->j = (distance == 0) ? val
+        : (val << distance) | (val >> (64 - distance));
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangLong_rotateRight(const u4* args, JValue* pResult)
+{
+    u8 val = (u8) argLong(args, 0);
+    int distance = args[2] & 63;
+    pResult->j = (distance == 0) ? val
+        : (val >> distance) | (val << (64 - distance));
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangLong_reverseBytes(const u4* args,
+    JValue* pResult)
+{
+    pResult->j = __builtin_bswap64((u8) argLong(args, 0));
+    return kIntrinsicDone;
+}
+
+/*
+ * ===========================================================================
+ *      java.lang.Character
+ * ===========================================================================
+ */
+
+/*
+ * ASCII only; everything else needs the Unicode tables, so the real method
+ * handles it.  The int versions take a code point.
+ */
+static IntrinsicResult javaLangCharacter_isDigit(const u4* args,
+    JValue* pResult)
+{
+    if (args[0] >= 0x80) {
+        return kIntrinsicPunt;
+    }
+    pResult->z = (args[0] >= '0' && args[0] <= '9');
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult javaLangCharacter_isLetter(const u4* args,
+    JValue* pResult)
+{
+    if (args[0] >= 0x80) {
+        return kIntrinsicPunt;
+    }
+    u4 lower = args[0] | 0x20;
+    pResult->z = (lower >= 'a' && lower <= 'z');
+    return kIntrinsicDone;
+}
+
+/*
+ * ===========================================================================
+ *      java.lang.String
+ * ===========================================================================
+ */
+
+/*
+ * public int hashCode()
+ *
+ * Same as String.java: use the cached value if there is one, otherwise
+ * compute and cache it.  The cache write is a benign race.
+ */
+static IntrinsicResult javaLangString_hashCode(const u4* args,
+    JValue* pResult)
+{
+    Object* strObj = (Object*) args[0];
+    s4 hash = dvmGetFieldInt(strObj, STRING_FIELDOFF_HASHCODE);
+    if (hash == 0) {
+        int count = dvmGetFieldInt(strObj, STRING_FIELDOFF_COUNT);
+        if (count != 0) {
+            ArrayObject* charArray = (ArrayObject*)
+                dvmGetFieldObject(strObj, STRING_FIELDOFF_VALUE);
+            const u2* chars = (const u2*)(void*) charArray->contents
+                + dvmGetFieldInt(strObj, STRING_FIELDOFF_OFFSET);
+            u4 h = 0;
+            for (int i = 0; i < count; i++) {
+                h = 31 * h + chars[i];
+            }
+            hash = (s4) h;
+            dvmSetFieldInt(strObj, STRING_FIELDOFF_HASHCODE, hash);
+        }
+    }
+    pResult->i = hash;
+    return kIntrinsicDone;
+}
+
+/*
+ * ===========================================================================
+ *      Array bulk operations
+ * ===========================================================================
+ */
+
+/*
+ * These only handle the well-formed cases.  Anything that would throw
+ * (nulls, bad ranges, mismatched types, a failing store check) punts to
+ * the real method, which raises the exception with its usual message, so
+ * we never write anything before we know the whole operation succeeds.
+ */
+
+/*
+ * Element size of an array, from its descriptor, or 0 for arrays of
+ * references.
+ */
+static inline size_t primitiveWidth(const ArrayObject* array)
+{
+    switch (array->clazz->descriptor[1]) {
+    case 'Z':
+    case 'B':
+        return 1;
+    case 'C':
+    case 'S':
+        return 2;
+    case 'I':
+    case 'F':
+        return 4;
+    case 'J':
+    case 'D':
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static inline bool isArray(const Object* obj)
+{
+    return obj->clazz->descriptor[0] == '[';
+}
+
+/* "[from, to)" within an array of "length" elements, as Arrays checks it */
+static inline bool rangeOk(u4 length, s4 from, s4 to)
+{
+    return from >= 0 && from <= to && (u4) to <= length;
+}
+
+/*
+ * Copy references one word at a time, in the right direction for an
+ * overlapping move.  libc's memmove may copy a byte at a time at the
+ * edges, and the GC must never see half a pointer.
+ */
+static void moveReferences(Object** dst, Object* const* src, size_t count)
+{
+    if (dst < src) {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = src[i];
+        }
+    } else {
+        for (size_t i = count; i > 0; i--) {
+            dst[i - 1] = src[i - 1];
+        }
+    }
+}
+
+/*
+ * Fill "count" elements of "width" bytes with the value at "value".  After
+ * the first element we keep doubling the filled prefix with memcpy, so
+ * long fills run in libc's vectorized copy loop for any element width.
+ */
+static void fillPrimitives(u1* dst, const void* value, size_t width,
+    size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    if (width == 1) {
+        memset(dst, *(const u1*) value, count);
+        return;
+    }
+    size_t total = width * count;
+    size_t filled = width;
+    memcpy(dst, value, width);
+    while (filled < total) {
+        size_t chunk = (filled < total - filled) ? filled : total - filled;
+        memcpy(dst + filled, dst, chunk);
+        filled += chunk;
+    }
+}
+
+/*
+ * public static void arraycopy(Object src, int srcPos, Object dst,
+ *     int dstPos, int length)
+ */
+static IntrinsicResult javaLangSystem_arraycopy(const u4* args,
+    JValue* pResult)
+{
+    ArrayObject* srcArray = (ArrayObject*) args[0];
+    s4 srcPos = (s4) args[1];
+    ArrayObject* dstArray = (ArrayObject*) args[2];
+    s4 dstPos = (s4) args[3];
+    s4 length = (s4) args[4];
+
+    if (srcArray == NULL || dstArray == NULL
+        || !isArray(srcArray) || !isArray(dstArray)
+        || srcPos < 0 || dstPos < 0 || length < 0
+        || srcPos > (s4) srcArray->length - length
+        || dstPos > (s4) dstArray->length - length)
+    {
+        return kIntrinsicPunt;
+    }
+
+    size_t width = primitiveWidth(srcArray);
+    if (width != 0) {
+        if (srcArray->clazz != dstArray->clazz) {
+            return kIntrinsicPunt;
+        }
+        memmove((u1*) dstArray->contents + (size_t) dstPos * width,
+            (const u1*) srcArray->contents + (size_t) srcPos * width,
+            (size_t) length * width);
+        return kIntrinsicDone;
+    }
+    if (primitiveWidth(dstArray) != 0) {
+        return kIntrinsicPunt;
+    }
+
+    Object** dst = (Object**)(void*) dstArray->contents + dstPos;
+    Object* const* src = (Object* const*)(void*) srcArray->contents + srcPos;
+    if (srcArray->clazz != dstArray->clazz
+        && !dvmInstanceof(srcArray->clazz, dstArray->clazz))
+    {
+        /*
+         * Not statically safe: check every element before storing any.
+         * Runs of same-class elements are common, so remember the last
+         * class that passed.
+         */
+        const ClassObject* lastOk = NULL;
+        for (s4 i = 0; i < length; i++) {
+            Object* obj = src[i];
+            if (obj == NULL || obj->clazz == lastOk) {
+                continue;
+            }
+            if (!dvmCanPutArrayElementHook(obj->clazz, dstArray->clazz)) {
+                return kIntrinsicPunt;
+            }
+            lastOk = obj->clazz;
+        }
+    }
+    moveReferences(dst, src, length);
+    dvmWriteBarrierArray(dstArray, dstPos, dstPos + length);
+    return kIntrinsicDone;
+}
+
+static IntrinsicResult fillCommon(ArrayObject* array, s4 from, s4 to,
+    const u4* value)
+{
+    if (array == NULL || !rangeOk(array->length, from, to)) {
+        return kIntrinsicPunt;
+    }
+    size_t width = primitiveWidth(array);
+    if (width != 0) {
+        /*
+         * Narrow values sit in the low bits of their slot; wide ones use
+         * two slots in memory order.
+         */
+        u1 narrow[4];
+        const void* bits = value;
+        if (width == 1) {
+            narrow[0] = (u1) value[0];
+            bits = narrow;
+        } else if (width == 2) {
+            u2 half = (u2) value[0];
+            memcpy(narrow, &half, sizeof(half));
+            bits = narrow;
+        }
+        fillPrimitives((u1*) array->contents + (size_t) from * width, bits,
+            width, to - from);
+        return kIntrinsicDone;
+    }
+
+    Object* obj = (Object*) value[0];
+    if (obj != NULL && !dvmCanPutArrayElementHook(obj->clazz, array->clazz)) {
+        return kIntrinsicPunt;
+    }
+    Object** contents = (Object**)(void*) array->contents;
+    for (s4 i = from; i < to; i++) {
+        contents[i] = obj;
+    }
+    if (obj != NULL && to > from) {
+        dvmWriteBarrierArray(array, from, to);
+    }
+    return kIntrinsicDone;
+}
+
+/*
+ * public static void fill(T[] array, T value)
+ */
+static IntrinsicResult javaUtilArrays_fill(const u4* args, JValue* pResult)
+{
+    ArrayObject* array = (ArrayObject*) args[0];
+    if (array == NULL) {
+        return kIntrinsicPunt;
+    }
+    return fillCommon(array, 0, array->length, &args[1]);
+}
+
+/*
+ * public static void fill(T[] array, int start, int end, T value)
+ */
+static IntrinsicResult javaUtilArrays_fill_range(const u4* args,
+    JValue* pResult)
+{
+    return fillCommon((ArrayObject*) args[0], (s4) args[1], (s4) args[2],
+        &args[3]);
+}
+
+/*
+ * public static boolean equals(T[] array1, T[] array2)
+ *
+ * Every overload has the same shorty, so this sees all of them.  Only the
+ * integral ones are a plain memory compare: float and double compare by
+ * floatToIntBits, which folds NaNs, and references call equals().
+ */
+static IntrinsicResult javaUtilArrays_equals(const u4* args, JValue* pResult)
+{
+    ArrayObject* lhs = (ArrayObject*) args[0];
+    ArrayObject* rhs = (ArrayObject*) args[1];
+    if (lhs == rhs) {
+        pResult->z = true;
+        return kIntrinsicDone;
+    }
+    if (lhs == NULL || rhs == NULL) {
+        pResult->z = false;
+        return kIntrinsicDone;
+    }
+
+    char type = lhs->clazz->descriptor[1];
+    if (type == 'F' || type == 'D' || primitiveWidth(lhs) == 0
+        || lhs->clazz != rhs->clazz)
+    {
+        return kIntrinsicPunt;
+    }
+    pResult->z = lhs->length == rhs->length
+        && memcmp(lhs->contents, rhs->contents,
+               (size_t) lhs->length * primitiveWidth(lhs)) == 0;
+    return kIntrinsicDone;
+}
+
+struct IntrinsicEntry {
+    IntrinsicFunc   func;
+    const char*     classDescriptor;
+    const char*     methodName;
+    const char*     shorty;
+};
+
+static const IntrinsicEntry gIntrinsicTable[] = {
+    { javaLangMath_min_long, "Ljava/lang/Math;", "min", "JJJ" },
+    { javaLangMath_max_long, "Ljava/lang/Math;", "max", "JJJ" },
+    { javaLangMath_min_float, "Ljava/lang/Math;", "min", "FFF" },
+    { javaLangMath_max_float, "Ljava/lang/Math;", "max", "FFF" },
+    { javaLangMath_min_double, "Ljava/lang/Math;", "min", "DDD" },
+    { javaLangMath_max_double, "Ljava/lang/Math;", "max", "DDD" },
+
+    { javaLangInteger_bitCount, "Ljava/lang/Integer;", "bitCount", "II" },
+    { javaLangInteger_numberOfLeadingZeros, "Ljava/lang/Integer;", "numberOfLeadingZeros", "II" },
+    { javaLangInteger_numberOfTrailingZeros, "Ljava/lang/Integer;", "numberOfTrailingZeros", "II" },
+    { javaLangInteger_rotateLeft, "Ljava/lang/Integer;", "rotateLeft", "III" },
+    { javaLangInteger_rotateRight, "Ljava/lang/Integer;", "rotateRight", "III" },
+    { javaLangInteger_reverseBytes, "Ljava/lang/Integer;", "reverseBytes", "II" },
+
+    { javaLangLong_bitCount, "Ljava/lang/Long;", "bitCount", "IJ" },
+    { javaLangLong_numberOfLeadingZeros, "Ljava/lang/Long;", "numberOfLeadingZeros", "IJ" },
+    { javaLangLong_numberOfTrailingZeros, "Ljava/lang/Long;", "numberOfTrailingZeros", "IJ" },
+    { javaLangLong_rotateLeft, "Ljava/lang/Long;", "rotateLeft", "JJI" },
+    { javaLangLong_rotateRight, "Ljava/lang/Long;", "rotateRight", "JJI" },
+    { javaLangLong_reverseBytes, "Ljava/lang/Long;", "reverseBytes", "JJ" },
+
+    { javaLangCharacter_isDigit, "Ljava/lang/Character;", "isDigit", "ZC" },
+    { javaLangCharacter_isDigit, "Ljava/lang/Character;", "isDigit", "ZI" },
+    { javaLangCharacter_isLetter, "Ljava/lang/Character;", "isLetter", "ZC" },
+    { javaLangCharacter_isLetter, "Ljava/lang/Character;", "isLetter", "ZI" },
+
+    { javaLangString_hashCode, "Ljava/lang/String;", "hashCode", "I" },
+
+    { javaLangSystem_arraycopy, "Ljava/lang/System;", "arraycopy", "VLILII" },
+
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLZ" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLB" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLC" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLS" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLI" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLJ" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLF" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLD" },
+    { javaUtilArrays_fill, "Ljava/util/Arrays;", "fill", "VLL" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIZ" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIB" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIC" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIS" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIII" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIJ" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIF" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIID" },
+    { javaUtilArrays_fill_range, "Ljava/util/Arrays;", "fill", "VLIIL" },
+    { javaUtilArrays_equals, "Ljava/util/Arrays;", "equals", "ZLL" },
+};
+
+static void bindIntrinsic(const Method* method, IntrinsicFunc func)
+{
+    u4 idx = ((uintptr_t) method >> 3) & (kIntrinsicTableSize - 1);
+    while (gIntrinsicSlots[idx].method != NULL) {
+        if (gIntrinsicSlots[idx].method == method) {
+            return;
+        }
+        idx = (idx + 1) & (kIntrinsicTableSize - 1);
+    }
+    if (gIntrinsicCount >= kIntrinsicTableSize / 2) {
+        MY_LOG_WARNING("intrinsic table full, %s.%s not bound",
+            method->clazz->descriptor, method->name);
+        return;
+    }
+    gIntrinsicSlots[idx].func = func;
+    gIntrinsicSlots[idx].method = method;
+    gIntrinsicCount++;
+    MY_LOG_VERBOSE("intrinsic %s.%s %s", method->clazz->descriptor,
+        method->name, method->shorty);
+}
+
+/*
+ * Overloads can share a shorty (Arrays.equals has one per array type), so
+ * every match is bound; the intrinsic itself checks what it was given.
+ */
+static void bindMatching(const Method* methods, int count,
+    const IntrinsicEntry* entry)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(methods[i].name, entry->methodName) == 0
+            && strcmp(methods[i].shorty, entry->shorty) == 0)
+        {
+            bindIntrinsic(&methods[i], entry->func);
+        }
+    }
+}
+
+/*
+ * Look each target class up once and bind the methods the table names.
+ * Entries for the same class are adjacent, so each class is found once.
+ * A class or method this platform doesn't have is simply left out.
+ */
+static void bindIntrinsics()
+{
+    if (dvmFindSystemClassNoInitHook == NULL) {
+        MY_LOG_WARNING("no dvmFindSystemClassNoInit; intrinsics disabled");
+        return;
+    }
+
+    const char* descriptor = NULL;
+    ClassObject* clazz = NULL;
+    for (size_t i = 0; i < array_size(gIntrinsicTable); i++) {
+        const IntrinsicEntry* entry = &gIntrinsicTable[i];
+        if (descriptor == NULL
+            || strcmp(descriptor, entry->classDescriptor) != 0)
+        {
+            descriptor = entry->classDescriptor;
+            clazz = dvmFindSystemClassNoInitHook(descriptor);
+        }
+        if (clazz == NULL) {
+            continue;
+        }
+        bindMatching(clazz->directMethods, clazz->directMethodCount, entry);
+        bindMatching(clazz->virtualMethods, clazz->virtualMethodCount, entry);
+    }
+}
+
+/*
+ * pthread_once orders the table's stores before any caller's loads, and
+ * every interpreter goes through here before its first invoke.
+ */
+void dvmIntrinsicsStartup()
+{
+    pthread_once(&gIntrinsicOnce, bindIntrinsics);
+}
@@ -0,0 +1,63 @@
+#ifndef CUSTOMAPPVMP_INTRINSICS_H
+#define CUSTOMAPPVMP_INTRINSICS_H
+
+#include "object.h"
+#include <stdint.h>
+
+/*
+ * Intrinsics: well-known library methods the interpreter runs directly
+ * when it sees an invoke of them, without pushing a frame.  Unlike the
+ * execute-inline table these don't need the optimizer to have rewritten
+ * the call site.  dvmIntrinsicsStartup looks the handful of target classes
+ * up once and binds their matching methods by name and shorty; nothing
+ * else ever enters the table, so the invoke path is a read-only probe.
+ *
+ * An intrinsic gets the call's arguments as laid out in the outs area
+ * ("this" first for instance methods, wide values in two slots).  It may
+ * decline, e.g. for a non-ASCII char, in which case the real method runs.
+ */
+enum IntrinsicResult {
+    kIntrinsicDone = 0,         /* result in *pResult */
+    kIntrinsicThrew,            /* exception raised */
+    kIntrinsicPunt,             /* not handled; make the real call */
+};
+
+typedef IntrinsicResult (*IntrinsicFunc)(const u4* args, JValue* pResult);
+
+/* must be a power of 2, and at least twice the number of bound methods */
+#define kIntrinsicTableSize     256
+
+struct IntrinsicSlot {
+    const Method*   method;
+    IntrinsicFunc   func;
+};
+
+extern IntrinsicSlot gIntrinsicSlots[kIntrinsicTableSize];
+
+/*
+ * Binds the table.  Called on every interpreter entry once the libdvm
+ * hooks are bound; only the first call does any work.
+ */
+void dvmIntrinsicsStartup();
+
+/*
+ * Returns the intrinsic for "method", or NULL.  The table is complete
+ * before any interpreter reaches an invoke and never changes afterwards,
+ * so plain loads are enough.
+ */
+INLINE IntrinsicFunc dvmFindIntrinsic(const Method* method)
+{
+    u4 idx = ((uintptr_t) method >> 3) & (kIntrinsicTableSize - 1);
+    for (;;) {
+        const Method* key = gIntrinsicSlots[idx].method;
+        if (key == method) {
+            return gIntrinsicSlots[idx].func;
+        }
+        if (key == NULL) {
+            return NULL;
+        }
+        idx = (idx + 1) & (kIntrinsicTableSize - 1);
+    }
+}
+
+#endif //CUSTOMAPPVMP_INTRINSICS_H
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Latency.h"
+#include "log.h"
+
+static volatile int32_t gLatencyClocks;
+
+/* histograms of exited threads; guarded by the thread list lock */
+static MethodLatency** gRetiredLatency;
+static u4 gRetiredLatencyCount;
+
+static const clockid_t kClockIds[kLatencyClockCount] = {
+    CLOCK_MONOTONIC,
+    CLOCK_THREAD_CPUTIME_ID,
+};
+
+static u8 readClockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u4 bucketFor(u8 value)
+{
+    if (value >= (1ULL << kLatencyMaxBits)) {
+        value = (1ULL << kLatencyMaxBits) - 1;
+    }
+    if (value < 2 * kLatencySubBuckets) {
+        return (u4) value;
+    }
+    int shift = 63 - __builtin_clzll(value) - kLatencySubBucketBits;
+    return shift * kLatencySubBuckets + (u4) (value >> shift);
+}
+
+/* largest value that lands in "bucket" */
+static u8 bucketUpperBound(u4 bucket)
+{
+    if (bucket < 2 * kLatencySubBuckets) {
+        return bucket;
+    }
+    int shift = bucket / kLatencySubBuckets - 1;
+    u8 sub = bucket - shift * kLatencySubBuckets;
+    return ((sub + 1) << shift) - 1;
+}
+
+/*
+ * Grow "*pTable" to hold "methodIdx" and return its histograms, creating
+ * them if needed.  NULL if out of memory.
+ */
+static MethodLatency* getMethodLatency(MethodLatency*** pTable, u4* pCount,
+    u4 methodIdx)
+{
+    if (methodIdx >= *pCount) {
+        u4 count = (methodIdx + 64) & ~63;
+        MethodLatency** table = (MethodLatency**) realloc(*pTable,
+            count * sizeof(MethodLatency*));
+        if (table == NULL) {
+            return NULL;
+        }
+        memset(table + *pCount, 0, (count - *pCount) * sizeof(MethodLatency*));
+        *pTable = table;
+        *pCount = count;
+    }
+    MethodLatency* latency = (*pTable)[methodIdx];
+    if (latency == NULL) {
+        latency = (MethodLatency*) calloc(1, sizeof(MethodLatency));
+        (*pTable)[methodIdx] = latency;
+    }
+    return latency;
+}
+
+void dvmLatencyEnter(LatencyScope* scope)
+{
+    int clocks = gLatencyClocks;
+    scope->clocks = clocks;
+    for (int i = 0; i < kLatencyClockCount; i++) {
+        if ((clocks & (1 << i)) != 0) {
+            scope->startNs[i] = readClockNs(kClockIds[i]);
+        }
+    }
+}
+
+void dvmLatencyExit(LatencyScope* scope, u4 methodIdx)
+{
+    if (scope->clocks == 0) {
+        return;
+    }
+    u8 endNs[kLatencyClockCount];
+    for (int i = 0; i < kLatencyClockCount; i++) {
+        if ((scope->clocks & (1 << i)) != 0) {
+            endNs[i] = readClockNs(kClockIds[i]);
+        }
+    }
+
+    AdvmpThread* thread = dvmAdvmpThreadCurrent();
+    if (thread == NULL) {
+        return;
+    }
+    MethodLatency* latency = (methodIdx < thread->latencyCount)
+        ? thread->latency[methodIdx] : NULL;
+    if (latency == NULL) {
+        /* first call of this method on this thread; readers walk the table */
+        dvmAdvmpLockThreadList();
+        latency = getMethodLatency(&thread->latency, &thread->latencyCount,
+            methodIdx);
+        dvmAdvmpUnlockThreadList();
+        if (latency == NULL) {
+            MY_LOG_ERROR("unable to allocate latency histograms");
+            return;
+        }
+    }
+
+    for (int i = 0; i < kLatencyClockCount; i++) {
+        if ((scope->clocks & (1 << i)) != 0) {
+            LatencyHistogram* hist = &latency->clocks[i];
+            u8 value = endNs[i] - scope->startNs[i];
+            hist->buckets[bucketFor(value)]++;
+            if (value > hist->max) {
+                hist->max = value;
+            }
+        }
+    }
+}
+
+void dvmLatencyStart(int clocks)
+{
+    gLatencyClocks = clocks & (kLatencyRecordWall | kLatencyRecordCpu);
+}
+
+void dvmLatencyStop()
+{
+    gLatencyClocks = 0;
+}
+
+static void resetTable(MethodLatency** table, u4 count)
+{
+    for (u4 i = 0; i < count; i++) {
+        if (table[i] != NULL) {
+            memset(table[i], 0, sizeof(MethodLatency));
+        }
+    }
+}
+
+static void resetThread(AdvmpThread* thread, void* arg)
+{
+    /* racing samples may survive; that's fine for a histogram */
+    resetTable(thread->latency, thread->latencyCount);
+}
+
+void dvmLatencyReset()
+{
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(resetThread, NULL);
+    resetTable(gRetiredLatency, gRetiredLatencyCount);
+    dvmAdvmpUnlockThreadList();
+}
+
+struct SummaryArgs {
+    u4              methodIdx;
+    LatencyClock    clock;
+    u8*             buckets;
+    u8              max;
+    bool            found;
+};
+
+static void addHistogram(MethodLatency** table, u4 count, SummaryArgs* args)
+{
+    if (args->methodIdx >= count || table[args->methodIdx] == NULL) {
+        return;
+    }
+    const LatencyHistogram* hist = &table[args->methodIdx]->clocks[args->clock];
+    for (int i = 0; i < kLatencyBucketCount; i++) {
+        args->buckets[i] += ((const volatile u4*) hist->buckets)[i];
+    }
+    u8 max = dvmReadCounter64(&hist->max);
+    if (max > args->max) {
+        args->max = max;
+    }
+    args->found = true;
+}
+
+static void addThreadHistogram(AdvmpThread* thread, void* arg)
+{
+    addHistogram(thread->latency, thread->latencyCount, (SummaryArgs*) arg);
+}
+
+static u8 percentile(const u8* buckets, u8 count, u8 max, u4 perMille)
+{
+    u8 rank = (count * perMille + 999) / 1000;
+    u8 seen = 0;
+    for (int i = 0; i < kLatencyBucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= rank && seen != 0) {
+            u8 value = bucketUpperBound(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+bool dvmLatencySummary(u4 methodIdx, LatencyClock clock,
+    LatencySummary* summary)
+{
+    u8 buckets[kLatencyBucketCount];
+    SummaryArgs args = { methodIdx, clock, buckets, 0, false };
+    memset(buckets, 0, sizeof(buckets));
+    memset(summary, 0, sizeof(LatencySummary));
+    if ((unsigned) clock >= kLatencyClockCount) {
+        return false;
+    }
+
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(addThreadHistogram, &args);
+    addHistogram(gRetiredLatency, gRetiredLatencyCount, &args);
+    dvmAdvmpUnlockThreadList();
+
+    for (int i = 0; i < kLatencyBucketCount; i++) {
+        summary->count += buckets[i];
+    }
+    summary->max = args.max;
+    summary->p50 = percentile(buckets, summary->count, args.max, 500);
+    summary->p90 = percentile(buckets, summary->count, args.max, 900);
+    summary->p99 = percentile(buckets, summary->count, args.max, 990);
+    return args.found;
+}
+
+void dvmLatencyThreadExiting(AdvmpThread* thread)
+{
+    for (u4 idx = 0; idx < thread->latencyCount; idx++) {
+        MethodLatency* src = thread->latency[idx];
+        if (src == NULL) {
+            continue;
+        }
+        MethodLatency* dst = getMethodLatency(&gRetiredLatency,
+            &gRetiredLatencyCount, idx);
+        if (dst != NULL) {
+            for (int c = 0; c < kLatencyClockCount; c++) {
+                for (int i = 0; i < kLatencyBucketCount; i++) {
+                    dst->clocks[c].buckets[i] += src->clocks[c].buckets[i];
+                }
+                if (src->clocks[c].max > dst->clocks[c].max) {
+                    dst->clocks[c].max = src->clocks[c].max;
+                }
+            }
+        }
+        free(src);
+    }
+    free(thread->latency);
+    thread->latency = NULL;
+    thread->latencyCount = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef CUSTOMAPPVMP_LATENCY_H
+#define CUSTOMAPPVMP_LATENCY_H
+
+#include "Common.h"
+#include "AdvmpThread.h"
+
+/*
+ * Per-method latency of protected calls, measured at the JNI bridge.
+ *
+ * Each method gets a log-linear histogram per clock: values below
+ * 2 * kLatencySubBuckets ns have a bucket each, and every power of two
+ * above that is split into kLatencySubBuckets equal buckets, so a
+ * percentile is off by at most 1/kLatencySubBuckets of its value.
+ * Values past kLatencyMaxBits are clamped into the last bucket; the
+ * exact maximum is kept beside the buckets.
+ *
+ * Threads record into their own histograms (allocated the first time a
+ * thread records a method); queries sum them.
+ */
+#define kLatencySubBucketBits   5
+#define kLatencySubBuckets      (1 << kLatencySubBucketBits)
+#define kLatencyMaxBits         36      /* about 68 seconds */
+#define kLatencyBucketCount                                                 \
+    ((kLatencyMaxBits - kLatencySubBucketBits + 1) * kLatencySubBuckets)
+
+enum LatencyClock {
+    kLatencyClockWall   = 0,            /* CLOCK_MONOTONIC */
+    kLatencyClockCpu    = 1,            /* CLOCK_THREAD_CPUTIME_ID */
+
+    kLatencyClockCount
+};
+
+/* dvmLatencyStart flags */
+#define kLatencyRecordWall  (1 << kLatencyClockWall)
+#define kLatencyRecordCpu   (1 << kLatencyClockCpu)
+
+struct LatencyHistogram {
+    u8      max;
+    u4      buckets[kLatencyBucketCount];
+};
+
+struct MethodLatency {
+    LatencyHistogram clocks[kLatencyClockCount];
+};
+
+/*
+ * Start times of one bridge call, on the caller's stack.
+ */
+struct LatencyScope {
+    int     clocks;                     /* kLatencyRecord* bits, or 0 */
+    u8      startNs[kLatencyClockCount];
+};
+
+struct LatencySummary {
+    u8      count;
+    u8      p50;
+    u8      p90;
+    u8      p99;
+    u8      max;
+};
+
+/*
+ * Record the given clocks (kLatencyRecord* bits) for every bridge call
+ * from now on.  Histograms are kept until reset.
+ */
+void dvmLatencyStart(int clocks);
+void dvmLatencyStop();
+void dvmLatencyReset();
+
+/*
+ * Bracket a bridge call into protected method "methodIdx" (the index of
+ * its SeparatorData).  Enter reads the clocks only while recording.
+ */
+void dvmLatencyEnter(LatencyScope* scope);
+void dvmLatencyExit(LatencyScope* scope, u4 methodIdx);
+
+/*
+ * Sum every thread's histogram of "methodIdx" for "clock".  Percentiles
+ * are the upper bound of the bucket they fall in, capped at the maximum.
+ * Returns false if the method has never been recorded.
+ */
+bool dvmLatencySummary(u4 methodIdx, LatencyClock clock,
+    LatencySummary* summary);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmLatencyThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_LATENCY_H
@@ -0,0 +1,247 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "LockContention.h"
+#include "Stack.h"
+#include "Sync.h"
+#include "log.h"
+
+struct ContentionSite {
+    const Method*   waitMethod;             /* NULL if free */
+    u4              waitPc;
+    const Method*   ownerMethod;            /* NULL if unknown */
+    u4              ownerPc;
+    u8              count;
+    u8              waitNs;
+    u8              maxWaitNs;
+};
+
+/*
+ * One table for all threads.  A record follows a blocking wait, so a
+ * mutex costs nothing next to it, and it keeps the table in one piece.
+ */
+static pthread_mutex_t gContentionLock = PTHREAD_MUTEX_INITIALIZER;
+static ContentionSite gContentionSites[kLockContentionTableSize];
+static u4 gContentionUsed;
+static u8 gContentionDropped;
+static volatile int32_t gContentionActive;
+
+static u8 monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u4 hashPair(const Method* waitMethod, u4 waitPc,
+    const Method* ownerMethod, u4 ownerPc)
+{
+    u4 hash = (u4) ((uintptr_t) waitMethod >> 3) ^ (waitPc * 0x9e3779b1u);
+    return hash * 31 + ((u4) ((uintptr_t) ownerMethod >> 3) ^ ownerPc);
+}
+
+static void recordContention(const Method* waitMethod, u4 waitPc,
+    const Method* ownerMethod, u4 ownerPc, u8 waitNs)
+{
+    const u4 mask = kLockContentionTableSize - 1;
+    pthread_mutex_lock(&gContentionLock);
+    u4 idx = hashPair(waitMethod, waitPc, ownerMethod, ownerPc) & mask;
+    for (; ; idx = (idx + 1) & mask) {
+        ContentionSite* site = &gContentionSites[idx];
+        if (site->waitMethod == NULL) {
+            if (gContentionUsed >= kLockContentionTableSize / 4 * 3) {
+                gContentionDropped++;
+                break;
+            }
+            site->waitMethod = waitMethod;
+            site->waitPc = waitPc;
+            site->ownerMethod = ownerMethod;
+            site->ownerPc = ownerPc;
+            gContentionUsed++;
+        } else if (site->waitMethod != waitMethod || site->waitPc != waitPc
+                   || site->ownerMethod != ownerMethod
+                   || site->ownerPc != ownerPc) {
+            continue;
+        }
+        site->count++;
+        site->waitNs += waitNs;
+        if (waitNs > site->maxWaitNs) {
+            site->maxWaitNs = waitNs;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&gContentionLock);
+}
+
+void dvmLockObjectProfiled(Thread* self, Object* obj, const Method* method,
+    const u2* pc)
+{
+    /*
+     * Racy peek at the lock word: it only decides whether this wait is
+     * worth timing.  "obj" is live in a register, so its monitor is too.
+     */
+    u4 thin = obj->lock;
+    const Method* ownerMethod = NULL;
+    u4 ownerPc = 0;
+    bool contended;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
+        contended = LW_LOCK_OWNER(thin) != 0
+            && LW_LOCK_OWNER(thin) != self->threadId;
+    } else {
+        Monitor* mon = LW_MONITOR(thin);
+        Thread* owner = mon->owner;
+        contended = owner != NULL && owner != self;
+        if (contended) {
+            ownerMethod = mon->ownerMethod;
+            ownerPc = mon->ownerPc;
+        }
+    }
+
+    if (!contended) {
+        dvmLockObjectInline(self, obj);
+    } else {
+        u8 start = monotonicNs();
+        dvmLockObjectHook(self, obj);
+        recordContention(method, pc - method->insns, ownerMethod, ownerPc,
+            monotonicNs() - start);
+    }
+
+    /* leave our site for whoever waits next */
+    thin = obj->lock;
+    if (LW_SHAPE(thin) == LW_SHAPE_FAT) {
+        Monitor* mon = LW_MONITOR(thin);
+        if (mon->owner == self && mon->lockCount == 0) {
+            mon->ownerMethod = method;
+            mon->ownerPc = pc - method->insns;
+        }
+    }
+}
+
+bool dvmUnlockObjectProfiled(Thread* self, Object* obj)
+{
+    /* the next owner may not be ours; don't let it inherit our site */
+    u4 thin = obj->lock;
+    if (LW_SHAPE(thin) == LW_SHAPE_FAT) {
+        Monitor* mon = LW_MONITOR(thin);
+        if (mon->owner == self && mon->lockCount == 0) {
+            mon->ownerMethod = NULL;
+            mon->ownerPc = 0;
+        }
+    }
+    return dvmUnlockObjectInline(self, obj);
+}
+
+static void enableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpEnableSubMode(thread, kAdvmpSubModeLockContention);
+}
+
+static void disableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpDisableSubMode(thread, kAdvmpSubModeLockContention);
+}
+
+void dvmLockContentionStart()
+{
+    dvmAdvmpLockThreadList();
+    gContentionActive = 1;
+    dvmAdvmpForEachThreadLocked(enableThread, NULL);
+    dvmAdvmpUnlockThreadList();
+}
+
+void dvmLockContentionStop()
+{
+    dvmAdvmpLockThreadList();
+    gContentionActive = 0;
+    dvmAdvmpForEachThreadLocked(disableThread, NULL);
+    dvmAdvmpUnlockThreadList();
+}
+
+void dvmLockContentionReset()
+{
+    pthread_mutex_lock(&gContentionLock);
+    memset(gContentionSites, 0, sizeof(gContentionSites));
+    gContentionUsed = 0;
+    gContentionDropped = 0;
+    pthread_mutex_unlock(&gContentionLock);
+}
+
+void dvmLockContentionThreadStarted(AdvmpThread* thread)
+{
+    if (gContentionActive) {
+        enableThread(thread, NULL);
+    }
+}
+
+static int compareSites(const void* a, const void* b)
+{
+    const ContentionSite* sa = (const ContentionSite*) a;
+    const ContentionSite* sb = (const ContentionSite*) b;
+    if (sa->waitNs != sb->waitNs) {
+        return sa->waitNs > sb->waitNs ? -1 : 1;
+    }
+    return sa->count > sb->count ? -1 : (sa->count < sb->count);
+}
+
+/* "class.method,pc,line", or ",," for an unknown site */
+static void printSite(FILE* fp, const Method* method, u4 pcOffset)
+{
+    if (method == NULL) {
+        fprintf(fp, ",,");
+        return;
+    }
+    int line = (dvmLineNumFromPChook != NULL)
+        ? dvmLineNumFromPChook(method, pcOffset) : -1;
+    fprintf(fp, "%s.%s,0x%04x,%d", method->clazz->descriptor, method->name,
+        pcOffset, line);
+}
+
+bool dvmLockContentionDump(const char* path)
+{
+    ContentionSite* sites = (ContentionSite*) malloc(sizeof(gContentionSites));
+    if (sites == NULL) {
+        return false;
+    }
+    u4 count = 0;
+    pthread_mutex_lock(&gContentionLock);
+    for (u4 i = 0; i < kLockContentionTableSize; i++) {
+        if (gContentionSites[i].waitMethod != NULL) {
+            sites[count++] = gContentionSites[i];
+        }
+    }
+    u8 dropped = gContentionDropped;
+    pthread_mutex_unlock(&gContentionLock);
+    qsort(sites, count, sizeof(ContentionSite), compareSites);
+
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        free(sites);
+        return false;
+    }
+    fprintf(fp, "waiter,waiterPc,waiterLine,owner,ownerPc,ownerLine,"
+        "count,waitNs,maxWaitNs\n");
+    for (u4 i = 0; i < count; i++) {
+        const ContentionSite* site = &sites[i];
+        printSite(fp, site->waitMethod, site->waitPc);
+        fputc(',', fp);
+        printSite(fp, site->ownerMethod, site->ownerPc);
+        fprintf(fp, ",%llu,%llu,%llu\n", (unsigned long long) site->count,
+            (unsigned long long) site->waitNs,
+            (unsigned long long) site->maxWaitNs);
+    }
+    if (dropped != 0) {
+        fprintf(fp, "# %llu contended acquisitions past the table size\n",
+            (unsigned long long) dropped);
+    }
+    free(sites);
+
+    bool ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    return ok;
+}
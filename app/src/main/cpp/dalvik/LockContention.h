@@ -0,0 +1,49 @@
+#ifndef CUSTOMAPPVMP_LOCKCONTENTION_H
+#define CUSTOMAPPVMP_LOCKCONTENTION_H
+
+#include "Common.h"
+#include "AdvmpThread.h"
+#include "Object.h"
+
+/*
+ * Contended monitor-enter in protected code.  While
+ * kAdvmpSubModeLockContention is set, monitor-enter times every
+ * acquisition of a lock another thread holds and charges the wait to the
+ * pair (waiting site, owner site).
+ *
+ * The owner site is the Monitor's ownerMethod/ownerPc, which we fill in
+ * whenever protected code takes a fat lock while recording.  A lock that
+ * is thin, or was taken outside protected code, has no owner site; those
+ * waits are charged to an unknown owner.  libdvm inflates a thin lock
+ * once its waiter gets it, so the next waiter usually sees a site.
+ */
+#define kLockContentionTableSize    1024    /* site pairs, power of 2 */
+
+/*
+ * monitor-enter/monitor-exit of "obj" by the instruction at "pc" of
+ * "method", while the subMode is set.  Same contract as
+ * dvmLockObjectInline/dvmUnlockObjectInline.
+ */
+void dvmLockObjectProfiled(Thread* self, Object* obj, const Method* method,
+    const u2* pc);
+bool dvmUnlockObjectProfiled(Thread* self, Object* obj);
+
+/*
+ * Turn recording on or off for every interpreter thread, present and
+ * future.  Counts are kept until reset.
+ */
+void dvmLockContentionStart();
+void dvmLockContentionStop();
+void dvmLockContentionReset();
+
+/*
+ * Write the site pairs as CSV, longest total wait first.
+ */
+bool dvmLockContentionDump(const char* path);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmLockContentionThreadStarted(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_LOCKCONTENTION_H
@@ -0,0 +1,353 @@
+#include <pthread.h>
+#include <string.h>
+#include "MemUtf16.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <emmintrin.h>
+# include <immintrin.h>
+# define MEM_UTF16_X86 1
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+# include <arm_neon.h>
+# define MEM_UTF16_NEON 1
+# if !defined(__aarch64__)
+#  include <sys/auxv.h>
+#  ifndef HWCAP_NEON
+#   define HWCAP_NEON (1 << 12)
+#  endif
+# endif
+#endif
+
+typedef int (*Memcmp16_func)(const u2* lhs, const u2* rhs, size_t count);
+typedef bool (*Memeq16_func)(const u2* lhs, const u2* rhs, size_t count);
+typedef int (*Memchr16_func)(const u2* chars, u2 ch, size_t count);
+
+/*
+ * Scalar versions.  The vector kernels use these for their tails.
+ */
+static int memcmp16Scalar(const u2* lhs, const u2* rhs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (lhs[i] != rhs[i]) {
+            return (s4) lhs[i] - (s4) rhs[i];
+        }
+    }
+    return 0;
+}
+
+static bool memeq16Scalar(const u2* lhs, const u2* rhs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (lhs[i] != rhs[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int memchr16Scalar(const u2* chars, u2 ch, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (chars[i] == ch) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+#if MEM_UTF16_X86
+/*
+ * movemask gives two bits per u2 lane, so a byte index halves into a char
+ * index.
+ */
+static int memcmp16Sse2(const u2* lhs, const u2* rhs, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (lhs + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (rhs + i));
+        u4 diff = ~(u4) _mm_movemask_epi8(_mm_cmpeq_epi16(a, b)) & 0xffff;
+        if (diff != 0) {
+            size_t at = i + __builtin_ctz(diff) / 2;
+            return (s4) lhs[at] - (s4) rhs[at];
+        }
+    }
+    return memcmp16Scalar(lhs + i, rhs + i, count - i);
+}
+
+static bool memeq16Sse2(const u2* lhs, const u2* rhs, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x0 = _mm_xor_si128(
+            _mm_loadu_si128((const __m128i*) (lhs + i)),
+            _mm_loadu_si128((const __m128i*) (rhs + i)));
+        __m128i x1 = _mm_xor_si128(
+            _mm_loadu_si128((const __m128i*) (lhs + i + 8)),
+            _mm_loadu_si128((const __m128i*) (rhs + i + 8)));
+        __m128i any = _mm_or_si128(x0, x1);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128()))
+            != 0xffff)
+        {
+            return false;
+        }
+    }
+    return memeq16Scalar(lhs + i, rhs + i, count - i);
+}
+
+static int memchr16Sse2(const u2* chars, u2 ch, size_t count)
+{
+    __m128i needle = _mm_set1_epi16((short) ch);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (chars + i));
+        u4 hit = (u4) _mm_movemask_epi8(_mm_cmpeq_epi16(v, needle));
+        if (hit != 0) {
+            return (int) (i + __builtin_ctz(hit) / 2);
+        }
+    }
+    int idx = memchr16Scalar(chars + i, ch, count - i);
+    return idx < 0 ? -1 : (int) i + idx;
+}
+
+/*
+ * The AVX2 versions hand their tails to the SSE2 ones.  GCC doesn't always
+ * emit vzeroupper before calling a non-AVX function, and the legacy-SSE
+ * transition penalty costs more than the whole call on short strings, so
+ * clear the upper halves by hand.
+ */
+__attribute__((target("avx2")))
+static int memcmp16Avx2(const u2* lhs, const u2* rhs, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (lhs + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (rhs + i));
+        u4 diff = ~(u4) _mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b));
+        if (diff != 0) {
+            size_t at = i + __builtin_ctz(diff) / 2;
+            return (s4) lhs[at] - (s4) rhs[at];
+        }
+    }
+    _mm256_zeroupper();
+    return memcmp16Sse2(lhs + i, rhs + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static bool memeq16Avx2(const u2* lhs, const u2* rhs, size_t count)
+{
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x0 = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i*) (lhs + i)),
+            _mm256_loadu_si256((const __m256i*) (rhs + i)));
+        __m256i x1 = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i*) (lhs + i + 16)),
+            _mm256_loadu_si256((const __m256i*) (rhs + i + 16)));
+        __m256i any = _mm256_or_si256(x0, x1);
+        if (!_mm256_testz_si256(any, any)) {
+            return false;
+        }
+    }
+    _mm256_zeroupper();
+    return memeq16Sse2(lhs + i, rhs + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static int memchr16Avx2(const u2* chars, u2 ch, size_t count)
+{
+    __m256i needle = _mm256_set1_epi16((short) ch);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (chars + i));
+        u4 hit = (u4) _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, needle));
+        if (hit != 0) {
+            return (int) (i + __builtin_ctz(hit) / 2);
+        }
+    }
+    _mm256_zeroupper();
+    int idx = memchr16Sse2(chars + i, ch, count - i);
+    return idx < 0 ? -1 : (int) i + idx;
+}
+#endif
+
+#if MEM_UTF16_NEON
+/*
+ * NEON has no movemask.  Narrowing the 16-bit compare result gives one
+ * 0x00/0xff byte per lane, which reads as a u8 whose trailing zero bits
+ * over 8 are the lane index.
+ */
+static inline u8 laneMask(uint16x8_t eq)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(eq)), 0);
+}
+
+static int memcmp16Neon(const u2* lhs, const u2* rhs, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        u8 diff = ~laneMask(vceqq_u16(vld1q_u16(lhs + i), vld1q_u16(rhs + i)));
+        if (diff != 0) {
+            size_t at = i + __builtin_ctzll(diff) / 8;
+            return (s4) lhs[at] - (s4) rhs[at];
+        }
+    }
+    return memcmp16Scalar(lhs + i, rhs + i, count - i);
+}
+
+static bool memeq16Neon(const u2* lhs, const u2* rhs, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint16x8_t x0 = veorq_u16(vld1q_u16(lhs + i), vld1q_u16(rhs + i));
+        uint16x8_t x1 = veorq_u16(vld1q_u16(lhs + i + 8),
+            vld1q_u16(rhs + i + 8));
+        uint16x8_t any = vorrq_u16(x0, x1);
+        uint16x4_t half = vorr_u16(vget_low_u16(any), vget_high_u16(any));
+        if (vget_lane_u64(vreinterpret_u64_u16(half), 0) != 0) {
+            return false;
+        }
+    }
+    return memeq16Scalar(lhs + i, rhs + i, count - i);
+}
+
+static int memchr16Neon(const u2* chars, u2 ch, size_t count)
+{
+    uint16x8_t needle = vdupq_n_u16(ch);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        u8 hit = laneMask(vceqq_u16(vld1q_u16(chars + i), needle));
+        if (hit != 0) {
+            return (int) (i + __builtin_ctzll(hit) / 8);
+        }
+    }
+    int idx = memchr16Scalar(chars + i, ch, count - i);
+    return idx < 0 ? -1 : (int) i + idx;
+}
+#endif
+
+#if MEM_UTF16_X86 || MEM_UTF16_NEON
+
+struct MemUtf16Kernel {
+    const char*     name;
+    Memcmp16_func   memcmp16;
+    Memeq16_func    memeq16;
+    Memchr16_func   memchr16;
+    bool            (*supported)();
+};
+
+static bool alwaysSupported() { return true; }
+
+#if MEM_UTF16_X86
+static bool avx2Supported() { return __builtin_cpu_supports("avx2"); }
+#endif
+
+#if MEM_UTF16_NEON
+static bool neonSupported()
+{
+# if defined(__aarch64__)
+    return true;
+# else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+# endif
+}
+#endif
+
+/* best first */
+static const MemUtf16Kernel gMemUtf16Kernels[] = {
+#if MEM_UTF16_X86
+    { "avx2",   memcmp16Avx2,   memeq16Avx2,    memchr16Avx2,   avx2Supported },
+    { "sse2",   memcmp16Sse2,   memeq16Sse2,    memchr16Sse2,   alwaysSupported },
+#endif
+#if MEM_UTF16_NEON
+    { "neon",   memcmp16Neon,   memeq16Neon,    memchr16Neon,   neonSupported },
+#endif
+    { "scalar", memcmp16Scalar, memeq16Scalar,  memchr16Scalar, alwaysSupported },
+};
+
+static const MemUtf16Kernel* gMemUtf16Kernel;
+static pthread_once_t gMemUtf16KernelOnce = PTHREAD_ONCE_INIT;
+
+static void selectBestKernel()
+{
+    for (size_t i = 0; i < array_size(gMemUtf16Kernels); i++) {
+        if (gMemUtf16Kernels[i].supported()) {
+            gMemUtf16Kernel = &gMemUtf16Kernels[i];
+            return;
+        }
+    }
+}
+
+static const MemUtf16Kernel* getKernel()
+{
+    pthread_once(&gMemUtf16KernelOnce, selectBestKernel);
+    return gMemUtf16Kernel;
+}
+
+int dvmMemcmp16(const u2* lhs, const u2* rhs, size_t count)
+{
+    return getKernel()->memcmp16(lhs, rhs, count);
+}
+
+bool dvmMemeq16(const u2* lhs, const u2* rhs, size_t count)
+{
+    return getKernel()->memeq16(lhs, rhs, count);
+}
+
+int dvmMemchr16(const u2* chars, u2 ch, size_t count)
+{
+    return getKernel()->memchr16(chars, ch, count);
+}
+
+const char* dvmMemUtf16KernelName()
+{
+    return getKernel()->name;
+}
+
+bool dvmMemUtf16SelectKernel(const char* name)
+{
+    getKernel();
+    for (size_t i = 0; i < array_size(gMemUtf16Kernels); i++) {
+        if (strcmp(gMemUtf16Kernels[i].name, name) == 0
+            && gMemUtf16Kernels[i].supported())
+        {
+            gMemUtf16Kernel = &gMemUtf16Kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+#else
+
+/*
+ * Nothing to choose from (armeabi): call the scalar loops directly
+ * rather than paying for pthread_once and an indirect call every time.
+ */
+int dvmMemcmp16(const u2* lhs, const u2* rhs, size_t count)
+{
+    return memcmp16Scalar(lhs, rhs, count);
+}
+
+bool dvmMemeq16(const u2* lhs, const u2* rhs, size_t count)
+{
+    return memeq16Scalar(lhs, rhs, count);
+}
+
+int dvmMemchr16(const u2* chars, u2 ch, size_t count)
+{
+    return memchr16Scalar(chars, ch, count);
+}
+
+const char* dvmMemUtf16KernelName()
+{
+    return "scalar";
+}
+
+bool dvmMemUtf16SelectKernel(const char* name)
+{
+    return strcmp(name, "scalar") == 0;
+}
+
+#endif
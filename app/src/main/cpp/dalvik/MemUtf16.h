@@ -0,0 +1,41 @@
+#ifndef CUSTOMAPPVMP_MEMUTF16_H
+#define CUSTOMAPPVMP_MEMUTF16_H
+
+#include <stddef.h>
+#include "Common.h"
+
+/*
+ * UTF-16 array primitives behind the String intrinsics.  Each has SSE2,
+ * AVX2 and NEON versions; the fastest one the CPU supports is picked on
+ * first use.  All versions give the same results as the plain loops.
+ */
+
+/*
+ * Compare "count" chars.  Returns the difference between the first pair of
+ * chars that differ, as unsigned values (so the String.compareTo result),
+ * or 0 if they're all the same.
+ */
+int dvmMemcmp16(const u2* lhs, const u2* rhs, size_t count);
+
+/*
+ * Returns true if the first "count" chars of both arrays are the same.
+ */
+bool dvmMemeq16(const u2* lhs, const u2* rhs, size_t count);
+
+/*
+ * Index of the first "ch" in "chars[0..count)", or -1.
+ */
+int dvmMemchr16(const u2* chars, u2 ch, size_t count);
+
+/*
+ * Name of the selected kernel ("scalar", "sse2", "avx2", "neon").
+ */
+const char* dvmMemUtf16KernelName();
+
+/*
+ * Force a kernel by name, for benchmarking.  Returns false if it isn't
+ * compiled in or the CPU doesn't support it.
+ */
+bool dvmMemUtf16SelectKernel(const char* name);
+
+#endif //CUSTOMAPPVMP_MEMUTF16_H
@@ -0,0 +1,401 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MethodTrace.h"
+#include "WorkerPool.h"
+#include "atomic-arm.h"
+#include "log.h"
+
+/* two varints: 64-bit delta with the action folded in, 32-bit id */
+#define kMaxEventSize           16
+#define kMethodIdTableSize      16384
+
+struct TraceChunk {
+    pid_t           tid;
+    u8              baseNs;
+    u8              lastNs;
+    u4              used;
+    u1              data[kTraceChunkSize];
+};
+
+struct MethodTraceState {
+    volatile int32_t active;
+    FILE*           fp;
+    bool            failed;
+    pthread_mutex_t fileLock;       /* serializes records in the file */
+    WorkGroup       group;          /* chunks queued for writing */
+};
+
+static MethodTraceState gTrace = {
+    0, NULL, false, PTHREAD_MUTEX_INITIALIZER,
+};
+static pthread_mutex_t gTraceLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t gTraceOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Method ids.  Insert-only; readers don't lock.  A slot points at the
+ * entry for id N, gMethodIdEntries[N - 1], which is filled in before the
+ * slot is published, so a reader's loads through the slot are ordered by
+ * the address dependency alone.  When the table is full a method gets
+ * kTraceMethodUnknown.  Ids stay the same across traces; each trace file
+ * gets the method records for all of them.
+ */
+#define kMethodIdMax            (kMethodIdTableSize / 4 * 3)
+
+struct MethodIdEntry {
+    const Method*   method;
+    u4              id;
+};
+
+static MethodIdEntry gMethodIdEntries[kMethodIdMax];
+static const MethodIdEntry* volatile gMethodIds[kMethodIdTableSize];
+static u4 gMethodIdCount;
+static pthread_mutex_t gMethodIdLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* method records not yet in the file; guarded by gMethodIdLock */
+static u1* gPendingDefs;
+static size_t gPendingLen;
+static size_t gPendingCap;
+static bool gPendingFailed;         /* a record was lost; the trace is bad */
+
+static void initTraceState()
+{
+    dvmWorkGroupInit(&gTrace.group);
+}
+
+static u8 nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u1* putLe(u1* ptr, u8 val, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        *ptr++ = (u1) (val >> (8 * i));
+    }
+    return ptr;
+}
+
+static u1* putVarint(u1* ptr, u8 val)
+{
+    while (val >= 0x80) {
+        *ptr++ = (u1) (val | 0x80);
+        val >>= 7;
+    }
+    *ptr++ = (u1) val;
+    return ptr;
+}
+
+/*
+ * Queue the method record for "id".  Caller holds gMethodIdLock.  Returns
+ * false if there's no memory for the record; events must not use an id
+ * whose record wasn't appended, since the reader can't name them.
+ */
+static bool appendMethodDef(u4 id, const Method* method)
+{
+    char text[512];
+    int len = snprintf(text, sizeof(text), "%s\t%s\t%s",
+        method->clazz->descriptor, method->name, method->shorty);
+    if (len < 0) {
+        return false;
+    }
+    if ((size_t) len >= sizeof(text)) {
+        len = sizeof(text) - 1;
+    }
+
+    size_t need = gPendingLen + 1 + 4 + 2 + len;
+    if (need > gPendingCap) {
+        size_t cap = gPendingCap != 0 ? gPendingCap * 2 : 4096;
+        while (cap < need) {
+            cap *= 2;
+        }
+        u1* grown = (u1*) realloc(gPendingDefs, cap);
+        if (grown == NULL) {
+            return false;
+        }
+        gPendingDefs = grown;
+        gPendingCap = cap;
+    }
+    u1* ptr = gPendingDefs + gPendingLen;
+    *ptr++ = kTraceRecordMethod;
+    ptr = putLe(ptr, id, 4);
+    ptr = putLe(ptr, len, 2);
+    memcpy(ptr, text, len);
+    gPendingLen = need;
+    return true;
+}
+
+static u4 addMethodId(const Method* method)
+{
+    pthread_mutex_lock(&gMethodIdLock);
+    u4 idx = ((uintptr_t) method >> 3) & (kMethodIdTableSize - 1);
+    while (gMethodIds[idx] != NULL && gMethodIds[idx]->method != method) {
+        idx = (idx + 1) & (kMethodIdTableSize - 1);
+    }
+    u4 id = kTraceMethodUnknown;
+    if (gMethodIds[idx] != NULL) {
+        id = gMethodIds[idx]->id;
+    } else if (gMethodIdCount < kMethodIdMax) {
+        if (appendMethodDef(gMethodIdCount + 1, method)) {
+            MethodIdEntry* entry = &gMethodIdEntries[gMethodIdCount];
+            entry->method = method;
+            entry->id = id = ++gMethodIdCount;
+            ANDROID_MEMBAR_STORE();
+            gMethodIds[idx] = entry;
+        } else if (!gPendingFailed) {
+            /* dvmMethodTraceStop reports it; the method is retried */
+            MY_LOG_ERROR("out of memory for method records, trace incomplete");
+            gPendingFailed = true;
+        }
+    }
+    pthread_mutex_unlock(&gMethodIdLock);
+    return id;
+}
+
+static u4 methodIdFor(const Method* method)
+{
+    u4 idx = ((uintptr_t) method >> 3) & (kMethodIdTableSize - 1);
+    while (true) {
+        const MethodIdEntry* entry = gMethodIds[idx];
+        if (entry == NULL) {
+            return addMethodId(method);
+        }
+        if (entry->method == method) {
+            return entry->id;
+        }
+        idx = (idx + 1) & (kMethodIdTableSize - 1);
+    }
+}
+
+/*
+ * Worker pool task: append a chunk, preceded by any method records its
+ * events might use.
+ */
+static void writeChunkTask(void* arg)
+{
+    TraceChunk* chunk = (TraceChunk*) arg;
+
+    pthread_mutex_lock(&gTrace.fileLock);
+    pthread_mutex_lock(&gMethodIdLock);
+    u1* defs = gPendingDefs;
+    size_t defsLen = gPendingLen;
+    gPendingDefs = NULL;
+    gPendingLen = gPendingCap = 0;
+    pthread_mutex_unlock(&gMethodIdLock);
+
+    u1 header[1 + 4 + 8 + 4];
+    u1* ptr = header;
+    *ptr++ = kTraceRecordChunk;
+    ptr = putLe(ptr, chunk->tid, 4);
+    ptr = putLe(ptr, chunk->baseNs, 8);
+    ptr = putLe(ptr, chunk->used, 4);
+    if (gTrace.fp != NULL
+        && (fwrite(defs, 1, defsLen, gTrace.fp) != defsLen
+            || fwrite(header, 1, sizeof(header), gTrace.fp) != sizeof(header)
+            || fwrite(chunk->data, 1, chunk->used, gTrace.fp) != chunk->used))
+    {
+        gTrace.failed = true;
+    }
+    pthread_mutex_unlock(&gTrace.fileLock);
+
+    free(defs);
+    free(chunk);
+}
+
+static void submitChunk(TraceChunk* chunk)
+{
+    if (chunk->used == 0) {
+        free(chunk);
+        return;
+    }
+    dvmWorkerPoolSubmit(dvmGetSharedWorkerPool(), &gTrace.group,
+        writeChunkTask, chunk);
+}
+
+/*
+ * Hand the thread's current chunk (if any) to the writer and start a new
+ * one.  Runs on the owning thread, inside its busy section.
+ */
+static TraceChunk* replaceChunk(AdvmpThread* thread, TraceChunk* old, u8 now)
+{
+    /* the CAS fails if dvmMethodTraceStop took the chunk first */
+    if (old != NULL
+        && __sync_bool_compare_and_swap(&thread->traceChunk, old, NULL))
+    {
+        submitChunk(old);
+    }
+
+    TraceChunk* chunk = (TraceChunk*) malloc(sizeof(TraceChunk));
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->tid = thread->tid;
+    chunk->baseNs = chunk->lastNs = now;
+    chunk->used = 0;
+    thread->traceChunk = chunk;
+    return chunk;
+}
+
+void dvmMethodTraceEvent(AdvmpThread* thread, MethodTraceAction action,
+    const Method* method)
+{
+    u4 methodId = methodIdFor(method);
+    u8 now = nowNs();
+
+    /*
+     * The busy flag lets dvmMethodTraceStop take our chunk without a
+     * lock: it clears "active" and then waits for us to leave.  That
+     * handshake is the event's only barrier pair; the id lookup above
+     * needs none.
+     */
+    thread->traceBusy = 1;
+    ANDROID_MEMBAR_FULL();
+    if (gTrace.active) {
+        TraceChunk* chunk = thread->traceChunk;
+        if (chunk == NULL || chunk->used > kTraceChunkSize - kMaxEventSize) {
+            chunk = replaceChunk(thread, chunk, now);
+        }
+        if (chunk != NULL) {
+            u1* ptr = chunk->data + chunk->used;
+            ptr = putVarint(ptr, ((now - chunk->lastNs) << 2) | action);
+            ptr = putVarint(ptr, methodId);
+            chunk->lastNs = now;
+            chunk->used = ptr - chunk->data;
+        }
+    }
+    android_atomic_release_store(0, &thread->traceBusy);
+}
+
+/*
+ * Take "thread"'s chunk for writing.  If the thread is in the middle of
+ * an event, wait for it; it may have installed a new chunk meanwhile.
+ */
+static void flushThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpDisableSubMode(thread, kAdvmpSubModeMethodTrace);
+    do {
+        TraceChunk* chunk =
+            (TraceChunk*) __sync_lock_test_and_set(&thread->traceChunk, NULL);
+        ANDROID_MEMBAR_FULL();
+        while (android_atomic_acquire_load(&thread->traceBusy) != 0) {
+            sched_yield();
+        }
+        if (chunk != NULL) {
+            submitChunk(chunk);
+        }
+    } while (thread->traceChunk != NULL);
+}
+
+static void enableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpEnableSubMode(thread, kAdvmpSubModeMethodTrace);
+}
+
+void dvmMethodTraceThreadStarted(AdvmpThread* thread)
+{
+    if (gTrace.active) {
+        enableThread(thread, NULL);
+    }
+}
+
+void dvmMethodTraceThreadExiting(AdvmpThread* thread)
+{
+    flushThread(thread, NULL);
+}
+
+bool dvmMethodTraceStart(const char* path)
+{
+    pthread_once(&gTraceOnce, initTraceState);
+    pthread_mutex_lock(&gTraceLock);
+    if (gTrace.active) {
+        pthread_mutex_unlock(&gTraceLock);
+        return false;
+    }
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        pthread_mutex_unlock(&gTraceLock);
+        return false;
+    }
+    u1 header[8 + 4];
+    memcpy(header, kTraceMagic, 8);
+    putLe(header + 8, kTraceVersion, 4);
+    fwrite(header, 1, sizeof(header), fp);
+
+    /* the new file needs records for the ids handed out earlier */
+    pthread_mutex_lock(&gMethodIdLock);
+    gPendingLen = 0;
+    gPendingFailed = false;
+    for (u4 i = 0; i < gMethodIdCount && !gPendingFailed; i++) {
+        if (!appendMethodDef(gMethodIdEntries[i].id, gMethodIdEntries[i].method)) {
+            gPendingFailed = true;
+        }
+    }
+    bool defsOk = !gPendingFailed;
+    pthread_mutex_unlock(&gMethodIdLock);
+    if (!defsOk) {
+        MY_LOG_ERROR("out of memory for method records, trace not started");
+        fclose(fp);
+        pthread_mutex_unlock(&gTraceLock);
+        return false;
+    }
+
+    pthread_mutex_lock(&gTrace.fileLock);
+    gTrace.fp = fp;
+    gTrace.failed = false;
+    pthread_mutex_unlock(&gTrace.fileLock);
+    ANDROID_MEMBAR_FULL();
+    gTrace.active = 1;
+    dvmAdvmpForEachThread(enableThread, NULL);
+    pthread_mutex_unlock(&gTraceLock);
+
+    MY_LOG_INFO("method trace started: %s", path);
+    return true;
+}
+
+bool dvmMethodTraceStop()
+{
+    pthread_mutex_lock(&gTraceLock);
+    if (!gTrace.active) {
+        pthread_mutex_unlock(&gTraceLock);
+        return false;
+    }
+    gTrace.active = 0;
+    ANDROID_MEMBAR_FULL();
+    dvmAdvmpForEachThread(flushThread, NULL);
+    dvmWorkGroupWait(&gTrace.group);
+
+    pthread_mutex_lock(&gTrace.fileLock);
+    pthread_mutex_lock(&gMethodIdLock);
+    if (gPendingLen != 0
+        && fwrite(gPendingDefs, 1, gPendingLen, gTrace.fp) != gPendingLen)
+    {
+        gTrace.failed = true;
+    }
+    if (gPendingFailed) {
+        gTrace.failed = true;
+    }
+    gPendingLen = 0;
+    pthread_mutex_unlock(&gMethodIdLock);
+    if (fclose(gTrace.fp) != 0) {
+        gTrace.failed = true;
+    }
+    gTrace.fp = NULL;
+    bool ok = !gTrace.failed;
+    pthread_mutex_unlock(&gTrace.fileLock);
+    pthread_mutex_unlock(&gTraceLock);
+
+    MY_LOG_INFO("method trace stopped%s", ok ? "" : " (write errors)");
+    return ok;
+}
+
+bool dvmMethodTraceActive()
+{
+    return gTrace.active != 0;
+}
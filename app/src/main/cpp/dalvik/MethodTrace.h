@@ -0,0 +1,44 @@
+#ifndef CUSTOMAPPVMP_METHODTRACE_H
+#define CUSTOMAPPVMP_METHODTRACE_H
+
+#include "Common.h"
+#include "AdvmpThread.h"
+#include "MethodTraceFormat.h"
+
+/*
+ * Method entry/exit tracing for code run by our interpreter.
+ *
+ * Events go into a chunk owned by the thread; a full chunk is handed to
+ * the shared worker pool, which appends it to the trace file (format in
+ * MethodTraceFormat.h).
+ */
+#define kTraceChunkSize         (64 * 1024)
+
+/*
+ * Start tracing every interpreter thread, present and future, to "path".
+ */
+bool dvmMethodTraceStart(const char* path);
+
+/*
+ * Stop tracing, write out every thread's partial chunk and close the
+ * file.  Returns false if anything failed to be written, including
+ * method records lost for lack of memory.
+ */
+bool dvmMethodTraceStop();
+
+bool dvmMethodTraceActive();
+
+/*
+ * Record an event for the calling thread.  Only called by the
+ * interpreter, and only while kAdvmpSubModeMethodTrace is set.
+ */
+void dvmMethodTraceEvent(AdvmpThread* thread, MethodTraceAction action,
+    const Method* method);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmMethodTraceThreadStarted(AdvmpThread* thread);
+void dvmMethodTraceThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_METHODTRACE_H
@@ -0,0 +1,43 @@
+#ifndef CUSTOMAPPVMP_METHODTRACEFORMAT_H
+#define CUSTOMAPPVMP_METHODTRACEFORMAT_H
+
+#include "Common.h"
+
+/*
+ * MethodTrace file format.  Shared with the host-side converter
+ * (tools/TraceToJson.cpp), so no runtime headers here.
+ *
+ * An event is two varints, so a typical one takes 3-5 bytes:
+ *
+ *   (nanoseconds since the previous event in the chunk << 2) | action
+ *   method id
+ *
+ * File layout (little-endian):
+ *
+ *   header:  "AVMPTRC\0", u4 version
+ *   records: u1 kind, then
+ *     kTraceRecordMethod:  u4 id, u2 len, "descriptor\tname\tshorty"
+ *     kTraceRecordChunk:   u4 tid, u8 baseNs, u4 len, events
+ *
+ * A method record always precedes the first chunk that uses its id.
+ * The exception is kTraceMethodUnknown, which never has a record: the
+ * runtime ran out of ids (or memory for the record) for that method.
+ * Its events are still written so entries and exits stay balanced.
+ * baseNs is CLOCK_MONOTONIC; chunks of one thread can appear out of order.
+ */
+#define kTraceMagic             "AVMPTRC"
+#define kTraceVersion           1
+#define kTraceMethodUnknown     0
+
+enum TraceRecordKind {
+    kTraceRecordMethod      = 1,
+    kTraceRecordChunk       = 2,
+};
+
+enum MethodTraceAction {
+    kMethodTraceEnter       = 0,
+    kMethodTraceExit        = 1,
+    kMethodTraceUnwind      = 2,    /* frame popped by an exception */
+};
+
+#endif //CUSTOMAPPVMP_METHODTRACEFORMAT_H
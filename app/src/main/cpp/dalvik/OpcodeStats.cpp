@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "OpcodeStats.h"
+#include "atomic-arm.h"
+#include "log.h"
+
+#define kPairCount  (kNumPackedOpcodes * kNumPackedOpcodes)
+
+static volatile int32_t gOpcodeStatsActive;
+volatile int32_t gOpcodeStatsPairs;
+
+/* counts of exited threads; guarded by the thread list lock */
+static OpcodeCounts* gRetiredCounts;
+
+OpcodeCounts* dvmOpcodeStatsAlloc(AdvmpThread* thread)
+{
+    OpcodeCounts* counts = thread->opcodeCounts;
+    if (counts == NULL) {
+        counts = (OpcodeCounts*) calloc(1, sizeof(OpcodeCounts));
+        if (counts == NULL) {
+            MY_LOG_ERROR("unable to allocate opcode counts");
+            dvmAdvmpDisableSubMode(thread, kAdvmpSubModeOpcodeCount);
+            return NULL;
+        }
+        thread->prevOpcode = kNoPreviousOpcode;
+        ANDROID_MEMBAR_STORE();
+        thread->opcodeCounts = counts;
+    }
+    if (counts->pairs == NULL && gOpcodeStatsPairs) {
+        u8* pairs = (u8*) calloc(kPairCount, sizeof(u8));
+        if (pairs == NULL) {
+            MY_LOG_ERROR("unable to allocate opcode pair counts");
+            dvmAdvmpDisableSubMode(thread, kAdvmpSubModeOpcodeCount);
+            return NULL;
+        }
+        ANDROID_MEMBAR_STORE();
+        counts->pairs = pairs;
+    }
+    return counts;
+}
+
+static void addCounts(const OpcodeCounts* counts, u8* single, u8* pairs)
+{
+    for (int i = 0; i < kNumPackedOpcodes; i++) {
+        single[i] += dvmReadCounter64(&counts->single[i]);
+    }
+    const u8* src = counts->pairs;
+    if (pairs != NULL && src != NULL) {
+        for (int i = 0; i < kPairCount; i++) {
+            pairs[i] += dvmReadCounter64(&src[i]);
+        }
+    }
+}
+
+struct SnapshotArgs {
+    u8*     single;
+    u8*     pairs;
+};
+
+static void addThreadCounts(AdvmpThread* thread, void* arg)
+{
+    SnapshotArgs* args = (SnapshotArgs*) arg;
+    if (thread->opcodeCounts != NULL) {
+        addCounts(thread->opcodeCounts, args->single, args->pairs);
+    }
+}
+
+void dvmOpcodeStatsSnapshot(u8* single, u8* pairs)
+{
+    SnapshotArgs args = { single, pairs };
+    memset(single, 0, kNumPackedOpcodes * sizeof(u8));
+    if (pairs != NULL) {
+        memset(pairs, 0, kPairCount * sizeof(u8));
+    }
+
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(addThreadCounts, &args);
+    if (gRetiredCounts != NULL) {
+        addCounts(gRetiredCounts, single, pairs);
+    }
+    dvmAdvmpUnlockThreadList();
+}
+
+static void enableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpEnableSubMode(thread, kAdvmpSubModeOpcodeCount);
+}
+
+static void disableThread(AdvmpThread* thread, void* arg)
+{
+    dvmAdvmpDisableSubMode(thread, kAdvmpSubModeOpcodeCount);
+}
+
+void dvmOpcodeStatsStart(bool countPairs)
+{
+    dvmAdvmpLockThreadList();
+    if (countPairs) {
+        gOpcodeStatsPairs = 1;
+    }
+    gOpcodeStatsActive = 1;
+    dvmAdvmpForEachThreadLocked(enableThread, NULL);
+    dvmAdvmpUnlockThreadList();
+}
+
+void dvmOpcodeStatsStop()
+{
+    dvmAdvmpLockThreadList();
+    gOpcodeStatsActive = 0;
+    dvmAdvmpForEachThreadLocked(disableThread, NULL);
+    dvmAdvmpUnlockThreadList();
+}
+
+static void resetThread(AdvmpThread* thread, void* arg)
+{
+    /* racing increments may survive; that's fine for a histogram */
+    OpcodeCounts* counts = thread->opcodeCounts;
+    if (counts != NULL) {
+        memset(counts->single, 0, sizeof(counts->single));
+        if (counts->pairs != NULL) {
+            memset(counts->pairs, 0, kPairCount * sizeof(u8));
+        }
+    }
+}
+
+static void freeCounts(OpcodeCounts* counts)
+{
+    if (counts != NULL) {
+        free(counts->pairs);
+        free(counts);
+    }
+}
+
+void dvmOpcodeStatsReset()
+{
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(resetThread, NULL);
+    freeCounts(gRetiredCounts);
+    gRetiredCounts = NULL;
+    dvmAdvmpUnlockThreadList();
+}
+
+void dvmOpcodeStatsThreadStarted(AdvmpThread* thread)
+{
+    if (gOpcodeStatsActive) {
+        enableThread(thread, NULL);
+    }
+}
+
+void dvmOpcodeStatsThreadExiting(AdvmpThread* thread)
+{
+    OpcodeCounts* counts = thread->opcodeCounts;
+    if (counts == NULL) {
+        return;
+    }
+    thread->opcodeCounts = NULL;
+
+    if (gRetiredCounts == NULL) {
+        /* the first thread to exit donates its table */
+        gRetiredCounts = counts;
+        return;
+    }
+    for (int i = 0; i < kNumPackedOpcodes; i++) {
+        gRetiredCounts->single[i] += counts->single[i];
+    }
+    if (counts->pairs != NULL && gRetiredCounts->pairs == NULL) {
+        gRetiredCounts->pairs = counts->pairs;
+        counts->pairs = NULL;
+    } else if (counts->pairs != NULL) {
+        u8* dst = gRetiredCounts->pairs;
+        const u8* src = counts->pairs;
+        for (int i = 0; i < kPairCount; i++) {
+            dst[i] += src[i];
+        }
+    }
+    freeCounts(counts);
+}
+
+struct CountEntry {
+    u8      count;
+    u4      index;
+};
+
+static int compareEntries(const void* a, const void* b)
+{
+    const CountEntry* ea = (const CountEntry*) a;
+    const CountEntry* eb = (const CountEntry*) b;
+    if (ea->count != eb->count) {
+        return ea->count > eb->count ? -1 : 1;
+    }
+    return ea->index < eb->index ? -1 : (ea->index > eb->index);
+}
+
+/* gather the nonzero counts, most frequent first */
+static u4 sortCounts(const u8* counts, u4 size, CountEntry* entries)
+{
+    u4 used = 0;
+    for (u4 i = 0; i < size; i++) {
+        if (counts[i] != 0) {
+            entries[used].count = counts[i];
+            entries[used].index = i;
+            used++;
+        }
+    }
+    qsort(entries, used, sizeof(CountEntry), compareEntries);
+    return used;
+}
+
+bool dvmOpcodeStatsDump(const char* path)
+{
+    u8* single = (u8*) malloc(kNumPackedOpcodes * sizeof(u8));
+    u8* pairs = (u8*) malloc(kPairCount * sizeof(u8));
+    CountEntry* entries = (CountEntry*) malloc(kPairCount * sizeof(CountEntry));
+    FILE* fp = NULL;
+    bool ok = false;
+    if (single == NULL || pairs == NULL || entries == NULL) {
+        goto bail;
+    }
+
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        goto bail;
+    }
+
+    dvmOpcodeStatsSnapshot(single, pairs);
+    {
+        u8 total = 0;
+        for (int i = 0; i < kNumPackedOpcodes; i++) {
+            total += single[i];
+        }
+
+        fprintf(fp, "opcode,count,percent\n");
+        u4 used = sortCounts(single, kNumPackedOpcodes, entries);
+        for (u4 i = 0; i < used; i++) {
+            fprintf(fp, "%s,%llu,%.3f\n",
+                dexGetOpcodeName((Opcode) entries[i].index),
+                (unsigned long long) entries[i].count,
+                100.0 * entries[i].count / total);
+        }
+
+        fprintf(fp, "\nprevious,opcode,count,percent\n");
+        used = sortCounts(pairs, kPairCount, entries);
+        for (u4 i = 0; i < used; i++) {
+            fprintf(fp, "%s,%s,%llu,%.3f\n",
+                dexGetOpcodeName((Opcode) (entries[i].index / kNumPackedOpcodes)),
+                dexGetOpcodeName((Opcode) (entries[i].index % kNumPackedOpcodes)),
+                (unsigned long long) entries[i].count,
+                100.0 * entries[i].count / total);
+        }
+    }
+    ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+bail:
+    free(single);
+    free(pairs);
+    free(entries);
+    return ok;
+}
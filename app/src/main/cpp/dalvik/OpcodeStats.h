@@ -0,0 +1,81 @@
+#ifndef CUSTOMAPPVMP_OPCODESTATS_H
+#define CUSTOMAPPVMP_OPCODESTATS_H
+
+#include "Common.h"
+#include "DexOpcodes.h"
+#include "AdvmpThread.h"
+
+/*
+ * Opcode and opcode-pair execution counts.  Counting runs from the
+ * instrumented handler table (kAdvmpSubModeOpcodeCount), so it costs
+ * nothing while off.  Each thread counts into its own table, without
+ * atomics; tables are summed when read.  Pairs are (previous, current)
+ * in execution order, across invokes and returns.
+ *
+ * The pair table is 512 KB per thread, so it is only allocated once pair
+ * counting has been asked for.
+ */
+#define kNoPreviousOpcode   0xffff
+
+struct OpcodeCounts {
+    u8  single[kNumPackedOpcodes];
+    u8* volatile pairs;     /* [previous * kNumPackedOpcodes + current] */
+};
+
+extern volatile int32_t gOpcodeStatsPairs;
+
+/*
+ * Allocate whichever of the thread's tables are missing.
+ */
+OpcodeCounts* dvmOpcodeStatsAlloc(AdvmpThread* thread);
+
+/*
+ * Count one execution of "opcode" on the calling thread.
+ */
+INLINE void dvmOpcodeStatsRecord(AdvmpThread* thread, u1 opcode)
+{
+    OpcodeCounts* counts = thread->opcodeCounts;
+    if (counts == NULL || (counts->pairs == NULL && gOpcodeStatsPairs)) {
+        counts = dvmOpcodeStatsAlloc(thread);
+        if (counts == NULL) {
+            return;
+        }
+    }
+    counts->single[opcode]++;
+    u8* pairs = counts->pairs;
+    if (pairs != NULL && thread->prevOpcode != kNoPreviousOpcode) {
+        pairs[thread->prevOpcode * kNumPackedOpcodes + opcode]++;
+    }
+    thread->prevOpcode = opcode;
+}
+
+/*
+ * Turn counting on or off for every interpreter thread, present and
+ * future.  Counts are kept until reset.  Pairs are counted from the first
+ * start with "countPairs" on; that stays on, since a thread's pair table
+ * can't be taken away while the thread may be counting into it.
+ */
+void dvmOpcodeStatsStart(bool countPairs);
+void dvmOpcodeStatsStop();
+void dvmOpcodeStatsReset();
+
+/*
+ * Sum the counts of all threads, including exited ones.  "single" holds
+ * kNumPackedOpcodes entries, "pairs" (may be NULL) kNumPackedOpcodes
+ * squared, indexed previous * kNumPackedOpcodes + current.
+ */
+void dvmOpcodeStatsSnapshot(u8* single, u8* pairs);
+
+/*
+ * Write the counts as CSV, most frequent first, using the opcode names
+ * from DexOpcodes.cpp.  Opcodes and pairs never executed are left out.
+ */
+bool dvmOpcodeStatsDump(const char* path);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmOpcodeStatsThreadStarted(AdvmpThread* thread);
+void dvmOpcodeStatsThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_OPCODESTATS_H
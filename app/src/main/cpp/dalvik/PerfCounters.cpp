@@ -0,0 +1,661 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "PerfCounters.h"
+#include "DexOpcodes.h"
+#include "VmStats.h"
+#include "log.h"
+
+#ifndef F_SETSIG
+#define F_SETSIG 10
+#endif
+#ifndef F_SETOWN_EX
+#define F_SETOWN_EX 15
+#define F_OWNER_TID 0
+struct f_owner_ex {
+    int     type;
+    pid_t   pid;
+};
+#endif
+
+struct MethodPerf {
+    u8      calls;
+    u8      counts[kPerfEventCount];
+};
+
+/*
+ * A thread's counters.  The fds and "depth" are only touched by the
+ * thread itself (and its signal handler); the counts are read by others
+ * under the thread list lock.
+ */
+struct PerfThread {
+    u4              generation;
+    bool            open;
+    bool            failed;                         /* open failed this run */
+    int             fds[kPerfEventCount];           /* -1 if not available */
+    int             slotEvent[kPerfEventCount];     /* group read order */
+    int             slotCount;
+    volatile int32_t depth;                         /* bridge calls in progress */
+
+    u8              families[kPerfEventCount][kOpFamilyCount];
+    MethodPerf**    methods;                        /* grown under the lock */
+    u4              methodCount;
+};
+
+struct PerfEventInfo {
+    const char*     name;
+    u4              type;
+    u8              config;
+    u8              period;                         /* when sampling */
+};
+
+#define CACHE_READ_MISS(_cache)                                             \
+    ((_cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8)                          \
+     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const PerfEventInfo kPerfEvents[kPerfEventCount] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1000000 },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1000000 },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 10000 },
+    { "l1d-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), 10000 },
+    { "l1i-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1I), 10000 },
+};
+
+static const char* kOpFamilyNames[kOpFamilyCount] = {
+    "move", "const", "return", "invoke", "field", "array", "object",
+    "branch", "compare", "arith", "convert", "other",
+};
+
+struct PerfState {
+    volatile int32_t active;
+    volatile int32_t generation;
+    bool            sampleOpcodes;
+    int             signo;
+    bool            handlerInstalled;
+};
+
+static PerfState gPerf;
+static pthread_mutex_t gPerfLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* counts of exited threads; guarded by the thread list lock */
+static u8 gRetiredFamilies[kPerfEventCount][kOpFamilyCount];
+static MethodPerf** gRetiredMethods;
+static u4 gRetiredMethodCount;
+
+/* opcodes not listed are kOpFamilyOther */
+static const struct {
+    u1      first;
+    u1      last;
+    u1      family;
+} kOpFamilyRanges[] = {
+    { OP_MOVE, OP_MOVE_EXCEPTION, kOpFamilyMove },
+    { OP_RETURN_VOID, OP_RETURN_OBJECT, kOpFamilyReturn },
+    { OP_CONST_4, OP_CONST_CLASS, kOpFamilyConst },
+    { OP_MONITOR_ENTER, OP_INSTANCE_OF, kOpFamilyObject },
+    { OP_ARRAY_LENGTH, OP_ARRAY_LENGTH, kOpFamilyArray },
+    { OP_NEW_INSTANCE, OP_NEW_INSTANCE, kOpFamilyObject },
+    { OP_NEW_ARRAY, OP_FILL_ARRAY_DATA, kOpFamilyArray },
+    { OP_THROW, OP_THROW, kOpFamilyObject },
+    { OP_GOTO, OP_SPARSE_SWITCH, kOpFamilyBranch },
+    { OP_CMPL_FLOAT, OP_CMP_LONG, kOpFamilyCompare },
+    { OP_IF_EQ, OP_IF_LEZ, kOpFamilyBranch },
+    { OP_AGET, OP_APUT_SHORT, kOpFamilyArray },
+    { OP_IGET, OP_SPUT_SHORT, kOpFamilyField },
+    { OP_INVOKE_VIRTUAL, OP_INVOKE_INTERFACE_RANGE, kOpFamilyInvoke },
+    { OP_NEG_INT, OP_NEG_DOUBLE, kOpFamilyArith },
+    { OP_INT_TO_LONG, OP_INT_TO_SHORT, kOpFamilyConvert },
+    { OP_ADD_INT, OP_USHR_INT_LIT8, kOpFamilyArith },
+    { OP_IGET_VOLATILE, OP_SPUT_WIDE_VOLATILE, kOpFamilyField },
+    { OP_EXECUTE_INLINE, OP_INVOKE_OBJECT_INIT_RANGE, kOpFamilyInvoke },
+    { OP_RETURN_VOID_BARRIER, OP_RETURN_VOID_BARRIER, kOpFamilyReturn },
+    { OP_IGET_QUICK, OP_IPUT_OBJECT_QUICK, kOpFamilyField },
+    { OP_INVOKE_VIRTUAL_QUICK, OP_INVOKE_SUPER_QUICK_RANGE, kOpFamilyInvoke },
+    { OP_IPUT_OBJECT_VOLATILE, OP_SPUT_OBJECT_VOLATILE, kOpFamilyField },
+};
+
+static int opcodeFamily(u1 opcode)
+{
+    for (size_t i = 0; i < array_size(kOpFamilyRanges); i++) {
+        if (opcode >= kOpFamilyRanges[i].first
+            && opcode <= kOpFamilyRanges[i].last)
+        {
+            return kOpFamilyRanges[i].family;
+        }
+    }
+    return kOpFamilyOther;
+}
+
+/*
+ * Signal context.  The handler only runs on the thread that owns the
+ * counter, so the PerfThread can't go away underneath it.
+ */
+static void perfSignalHandler(int signo, siginfo_t* info, void* context)
+{
+    int savedErrno = errno;
+    AdvmpThread* thread = dvmAdvmpThreadCurrent();
+    PerfThread* perf = (thread != NULL) ? thread->perf : NULL;
+    if (perf != NULL && perf->open) {
+        for (int event = 0; event < kPerfEventCount; event++) {
+            if (perf->fds[event] != info->si_fd) {
+                continue;
+            }
+            const u2* pc = thread->curPc;
+            if (perf->depth > 0 && pc != NULL) {
+                perf->families[event][opcodeFamily(*pc & 0xff)] +=
+                    kPerfEvents[event].period;
+            }
+            break;
+        }
+    }
+    errno = savedErrno;
+}
+
+static bool installHandler()
+{
+    if (gPerf.handlerInstalled) {
+        return true;
+    }
+    int signo = SIGRTMIN + 3;
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = perfSignalHandler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(signo, NULL, &old) != 0) {
+        return false;
+    }
+    if ((old.sa_flags & SA_SIGINFO) != 0
+        || (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN))
+    {
+        MY_LOG_ERROR("signal %d already has a handler, not sampling", signo);
+        return false;
+    }
+    if (sigaction(signo, &sa, NULL) != 0) {
+        return false;
+    }
+
+    /* never uninstalled, for overflows still queued after close */
+    gPerf.signo = signo;
+    gPerf.handlerInstalled = true;
+    return true;
+}
+
+static int openEvent(int event, int groupFd, bool sample)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = kPerfEvents[event].type;
+    attr.config = kPerfEvents[event].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    if (sample) {
+        attr.sample_period = kPerfEvents[event].period;
+        attr.wakeup_events = 1;
+        /* the leader is enabled last, once every overflow is routed */
+        attr.disabled = (groupFd == -1);
+    }
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+/*
+ * Send "fd"'s overflows to the calling thread as gPerf.signo.  No
+ * PERF_EVENT_IOC_REFRESH: that stops the group at every overflow until
+ * the handler re-arms it, which loses counts.  We map no ring buffer, so
+ * a kernel that only signals through one leaves the families empty.
+ */
+static bool routeOverflows(int fd, pid_t tid)
+{
+    struct f_owner_ex owner;
+    owner.type = F_OWNER_TID;
+    owner.pid = tid;
+    return fcntl(fd, F_SETFL, O_ASYNC) == 0
+        && fcntl(fd, F_SETSIG, gPerf.signo) == 0
+        && fcntl(fd, F_SETOWN_EX, &owner) == 0;
+}
+
+static void closeCounters(AdvmpThread* thread, PerfThread* perf)
+{
+    if (!perf->open) {
+        return;
+    }
+    perf->open = false;
+    for (int event = 0; event < kPerfEventCount; event++) {
+        if (perf->fds[event] >= 0) {
+            close(perf->fds[event]);
+            perf->fds[event] = -1;
+        }
+    }
+    dvmAdvmpDisableSubMode(thread, kAdvmpSubModePerfSample);
+}
+
+/*
+ * Open this thread's group: cycles leads, the rest join if the CPU has
+ * them.
+ */
+static void openCounters(AdvmpThread* thread, PerfThread* perf)
+{
+    bool sample = gPerf.sampleOpcodes;
+    perf->slotCount = 0;
+    for (int event = 0; event < kPerfEventCount; event++) {
+        perf->fds[event] = -1;
+    }
+
+    int leader = -1;
+    for (int event = 0; event < kPerfEventCount; event++) {
+        int fd = openEvent(event, leader, sample);
+        if (fd < 0) {
+            if (event == kPerfEventCycles) {
+                MY_LOG_WARNING("perf_event_open for thread %d failed: %s",
+                    thread->tid, strerror(errno));
+                return;
+            }
+            continue;
+        }
+        if (leader == -1) {
+            leader = fd;
+        }
+        perf->fds[event] = fd;
+        perf->slotEvent[perf->slotCount++] = event;
+    }
+    perf->open = true;
+
+    if (sample) {
+        for (int slot = 0; slot < perf->slotCount; slot++) {
+            int fd = perf->fds[perf->slotEvent[slot]];
+            if (!routeOverflows(fd, thread->tid)) {
+                MY_LOG_WARNING("perf overflow signals unavailable: %s",
+                    strerror(errno));
+                closeCounters(thread, perf);
+                return;
+            }
+        }
+        ioctl(perf->fds[kPerfEventCycles], PERF_EVENT_IOC_ENABLE, 0);
+        dvmAdvmpEnableSubMode(thread, kAdvmpSubModePerfSample);
+    }
+}
+
+static bool readCounters(PerfThread* perf, u8* values)
+{
+    u8 buf[1 + kPerfEventCount];
+    int leader = perf->fds[perf->slotEvent[0]];
+    if (read(leader, buf, sizeof(buf)) < (ssize_t) sizeof(u8)) {
+        return false;
+    }
+    memset(values, 0, kPerfEventCount * sizeof(u8));
+    for (u4 slot = 0; slot < buf[0] && (int) slot < perf->slotCount; slot++) {
+        values[perf->slotEvent[slot]] = buf[1 + slot];
+    }
+    return true;
+}
+
+static MethodPerf* getMethodPerf(MethodPerf*** pTable, u4* pCount,
+    u4 methodIdx)
+{
+    if (methodIdx >= *pCount) {
+        u4 count = (methodIdx + 64) & ~63;
+        MethodPerf** table = (MethodPerf**) realloc(*pTable,
+            count * sizeof(MethodPerf*));
+        if (table == NULL) {
+            return NULL;
+        }
+        memset(table + *pCount, 0, (count - *pCount) * sizeof(MethodPerf*));
+        *pTable = table;
+        *pCount = count;
+    }
+    MethodPerf* method = (*pTable)[methodIdx];
+    if (method == NULL) {
+        method = (MethodPerf*) calloc(1, sizeof(MethodPerf));
+        (*pTable)[methodIdx] = method;
+    }
+    return method;
+}
+
+void dvmPerfEnter(PerfScope* scope)
+{
+    scope->counting = false;
+    AdvmpThread* thread = dvmAdvmpThreadCurrent();
+    if (thread == NULL) {
+        return;
+    }
+    PerfThread* perf = thread->perf;
+    if (!gPerf.active) {
+        if (perf != NULL) {
+            closeCounters(thread, perf);
+        }
+        return;
+    }
+
+    if (perf == NULL) {
+        perf = (PerfThread*) calloc(1, sizeof(PerfThread));
+        if (perf == NULL) {
+            return;
+        }
+        /* published under the lock; readers walk the thread list */
+        dvmAdvmpLockThreadList();
+        thread->perf = perf;
+        dvmAdvmpUnlockThreadList();
+    }
+    if (perf->generation != (u4) gPerf.generation) {
+        /* first call since a (re)start, possibly with another mode */
+        closeCounters(thread, perf);
+        perf->generation = gPerf.generation;
+        perf->failed = false;
+    }
+    if (!perf->open) {
+        if (perf->failed) {
+            return;
+        }
+        openCounters(thread, perf);
+        if (!perf->open) {
+            perf->failed = true;
+            return;
+        }
+    }
+
+    if (readCounters(perf, scope->start)) {
+        scope->counting = true;
+        scope->generation = perf->generation;
+        perf->depth++;
+    }
+}
+
+void dvmPerfExit(PerfScope* scope, u4 methodIdx)
+{
+    if (!scope->counting) {
+        return;
+    }
+    AdvmpThread* thread = dvmAdvmpThreadCurrent();
+    PerfThread* perf = (thread != NULL) ? thread->perf : NULL;
+    if (perf == NULL) {
+        return;
+    }
+    perf->depth--;
+
+    /* a nested call may have reopened the counters for a new run */
+    u8 end[kPerfEventCount];
+    if (!perf->open || perf->generation != scope->generation
+        || !readCounters(perf, end))
+    {
+        return;
+    }
+
+    MethodPerf* method = (methodIdx < perf->methodCount)
+        ? perf->methods[methodIdx] : NULL;
+    if (method == NULL) {
+        dvmAdvmpLockThreadList();
+        method = getMethodPerf(&perf->methods, &perf->methodCount, methodIdx);
+        dvmAdvmpUnlockThreadList();
+        if (method == NULL) {
+            return;
+        }
+    }
+    method->calls++;
+    for (int event = 0; event < kPerfEventCount; event++) {
+        method->counts[event] += end[event] - scope->start[event];
+    }
+}
+
+bool dvmPerfStart(bool sampleOpcodes)
+{
+    pthread_mutex_lock(&gPerfLock);
+    if (gPerf.active) {
+        pthread_mutex_unlock(&gPerfLock);
+        return false;
+    }
+
+    /* probe once here, so an unusable kernel fails the start */
+    int fd = openEvent(kPerfEventCycles, -1, false);
+    if (fd < 0) {
+        MY_LOG_ERROR("perf_event_open unavailable: %s", strerror(errno));
+        pthread_mutex_unlock(&gPerfLock);
+        return false;
+    }
+    close(fd);
+    if (sampleOpcodes && !installHandler()) {
+        pthread_mutex_unlock(&gPerfLock);
+        return false;
+    }
+
+    gPerf.sampleOpcodes = sampleOpcodes;
+    gPerf.generation++;
+    gPerf.active = 1;
+    pthread_mutex_unlock(&gPerfLock);
+    return true;
+}
+
+void dvmPerfStop()
+{
+    pthread_mutex_lock(&gPerfLock);
+    gPerf.active = 0;
+    pthread_mutex_unlock(&gPerfLock);
+}
+
+static void resetThread(AdvmpThread* thread, void* arg)
+{
+    PerfThread* perf = thread->perf;
+    if (perf == NULL) {
+        return;
+    }
+    /* racing updates may survive; fine for a profile */
+    memset(perf->families, 0, sizeof(perf->families));
+    for (u4 i = 0; i < perf->methodCount; i++) {
+        if (perf->methods[i] != NULL) {
+            memset(perf->methods[i], 0, sizeof(MethodPerf));
+        }
+    }
+}
+
+void dvmPerfReset()
+{
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(resetThread, NULL);
+    memset(gRetiredFamilies, 0, sizeof(gRetiredFamilies));
+    for (u4 i = 0; i < gRetiredMethodCount; i++) {
+        free(gRetiredMethods[i]);
+        gRetiredMethods[i] = NULL;
+    }
+    dvmAdvmpUnlockThreadList();
+}
+
+struct MethodArgs {
+    u4      methodIdx;
+    u8*     counts;
+    bool    found;
+};
+
+static void addMethod(MethodPerf** table, u4 count, MethodArgs* args)
+{
+    if (args->methodIdx >= count || table[args->methodIdx] == NULL) {
+        return;
+    }
+    const MethodPerf* method = table[args->methodIdx];
+    args->counts[0] += dvmReadCounter64(&method->calls);
+    for (int event = 0; event < kPerfEventCount; event++) {
+        args->counts[1 + event] += dvmReadCounter64(&method->counts[event]);
+    }
+    args->found = true;
+}
+
+static void addThreadMethod(AdvmpThread* thread, void* arg)
+{
+    if (thread->perf != NULL) {
+        addMethod(thread->perf->methods, thread->perf->methodCount,
+            (MethodArgs*) arg);
+    }
+}
+
+bool dvmPerfMethodCounts(u4 methodIdx, u8* counts)
+{
+    MethodArgs args = { methodIdx, counts, false };
+    memset(counts, 0, (1 + kPerfEventCount) * sizeof(u8));
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(addThreadMethod, &args);
+    addMethod(gRetiredMethods, gRetiredMethodCount, &args);
+    dvmAdvmpUnlockThreadList();
+    return args.found;
+}
+
+static void addFamilies(const u8 (*families)[kOpFamilyCount], u8* counts)
+{
+    for (int event = 0; event < kPerfEventCount; event++) {
+        for (int family = 0; family < kOpFamilyCount; family++) {
+            counts[event * kOpFamilyCount + family] +=
+                dvmReadCounter64(&families[event][family]);
+        }
+    }
+}
+
+static void addThreadFamilies(AdvmpThread* thread, void* arg)
+{
+    if (thread->perf != NULL) {
+        addFamilies(thread->perf->families, (u8*) arg);
+    }
+}
+
+void dvmPerfFamilyCounts(u8* counts)
+{
+    memset(counts, 0, kPerfEventCount * kOpFamilyCount * sizeof(u8));
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(addThreadFamilies, counts);
+    addFamilies(gRetiredFamilies, counts);
+    dvmAdvmpUnlockThreadList();
+}
+
+const char* dvmPerfEventName(int event)
+{
+    if (event < 0 || event >= kPerfEventCount) {
+        return NULL;
+    }
+    return kPerfEvents[event].name;
+}
+
+const char* dvmOpcodeFamilyName(int family)
+{
+    if (family < 0 || family >= kOpFamilyCount) {
+        return NULL;
+    }
+    return kOpFamilyNames[family];
+}
+
+static void maxMethodCount(AdvmpThread* thread, void* arg)
+{
+    u4* pMax = (u4*) arg;
+    if (thread->perf != NULL && thread->perf->methodCount > *pMax) {
+        *pMax = thread->perf->methodCount;
+    }
+}
+
+/* IPC and misses per thousand instructions, after the raw counts */
+static void printRow(FILE* fp, const u8* counts)
+{
+    for (int event = 0; event < kPerfEventCount; event++) {
+        fprintf(fp, ",%llu", (unsigned long long) counts[event]);
+    }
+    double insns = (double) counts[kPerfEventInstructions];
+    fprintf(fp, ",%.3f",
+        counts[kPerfEventCycles] != 0 ? insns / counts[kPerfEventCycles] : 0.0);
+    for (int event = kPerfEventBranchMisses; event < kPerfEventCount; event++) {
+        fprintf(fp, ",%.3f", insns != 0 ? 1000.0 * counts[event] / insns : 0.0);
+    }
+    fputc('\n', fp);
+}
+
+static void printHeader(FILE* fp, const char* first)
+{
+    fprintf(fp, "%s", first);
+    for (int event = 0; event < kPerfEventCount; event++) {
+        fprintf(fp, ",%s", kPerfEvents[event].name);
+    }
+    fprintf(fp, ",ipc");
+    for (int event = kPerfEventBranchMisses; event < kPerfEventCount; event++) {
+        fprintf(fp, ",%s-pki", kPerfEvents[event].name);
+    }
+    fputc('\n', fp);
+}
+
+bool dvmPerfDump(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    u4 methodCount = 0;
+    dvmAdvmpLockThreadList();
+    dvmAdvmpForEachThreadLocked(maxMethodCount, &methodCount);
+    if (gRetiredMethodCount > methodCount) {
+        methodCount = gRetiredMethodCount;
+    }
+    dvmAdvmpUnlockThreadList();
+
+    printHeader(fp, "method,calls");
+    for (u4 idx = 0; idx < methodCount; idx++) {
+        u8 counts[1 + kPerfEventCount];
+        if (dvmPerfMethodCounts(idx, counts) && counts[0] != 0) {
+            fprintf(fp, "%u,%llu", idx, (unsigned long long) counts[0]);
+            printRow(fp, counts + 1);
+        }
+    }
+
+    u8 families[kPerfEventCount * kOpFamilyCount];
+    dvmPerfFamilyCounts(families);
+    fputc('\n', fp);
+    printHeader(fp, "family");
+    for (int family = 0; family < kOpFamilyCount; family++) {
+        u8 counts[kPerfEventCount];
+        for (int event = 0; event < kPerfEventCount; event++) {
+            counts[event] = families[event * kOpFamilyCount + family];
+        }
+        fprintf(fp, "%s", kOpFamilyNames[family]);
+        printRow(fp, counts);
+    }
+
+    bool ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+void dvmPerfThreadExiting(AdvmpThread* thread)
+{
+    PerfThread* perf = thread->perf;
+    if (perf == NULL) {
+        return;
+    }
+    closeCounters(thread, perf);
+    thread->perf = NULL;
+
+    for (int event = 0; event < kPerfEventCount; event++) {
+        for (int family = 0; family < kOpFamilyCount; family++) {
+            gRetiredFamilies[event][family] += perf->families[event][family];
+        }
+    }
+    for (u4 idx = 0; idx < perf->methodCount; idx++) {
+        MethodPerf* src = perf->methods[idx];
+        if (src == NULL) {
+            continue;
+        }
+        MethodPerf* dst = getMethodPerf(&gRetiredMethods, &gRetiredMethodCount,
+            idx);
+        if (dst != NULL) {
+            dst->calls += src->calls;
+            for (int event = 0; event < kPerfEventCount; event++) {
+                dst->counts[event] += src->counts[event];
+            }
+        }
+        free(src);
+    }
+    free(perf->methods);
+    free(perf);
+}
@@ -0,0 +1,103 @@
+#ifndef CUSTOMAPPVMP_PERFCOUNTERS_H
+#define CUSTOMAPPVMP_PERFCOUNTERS_H
+
+#include "Common.h"
+#include "AdvmpThread.h"
+
+/*
+ * Hardware counters (perf_event_open) for protected calls.  Needs a
+ * kernel that lets us count our own threads in user mode, i.e.
+ * perf_event_paranoid <= 2 or root; otherwise start fails.
+ *
+ * Each thread opens one counter group the first time it crosses the
+ * bridge while counting is on.  Deltas between bridge entry and exit are
+ * added to the protected method, callees included.
+ *
+ * Per-opcode-family numbers are sampled: every event overflows each
+ * "period" occurrences and the signal handler charges the period to the
+ * family of the instruction the thread is on (threads are kept on the
+ * instrumented handler table so that is known).  Time in native callees
+ * is charged to the invoke.
+ */
+enum PerfEvent {
+    kPerfEventCycles = 0,
+    kPerfEventInstructions,
+    kPerfEventBranchMisses,
+    kPerfEventL1dMisses,
+    kPerfEventL1iMisses,
+
+    kPerfEventCount
+};
+
+enum OpcodeFamily {
+    kOpFamilyMove = 0,
+    kOpFamilyConst,
+    kOpFamilyReturn,
+    kOpFamilyInvoke,
+    kOpFamilyField,
+    kOpFamilyArray,
+    kOpFamilyObject,                /* new-instance, casts, monitors, throw */
+    kOpFamilyBranch,
+    kOpFamilyCompare,
+    kOpFamilyArith,
+    kOpFamilyConvert,
+    kOpFamilyOther,
+
+    kOpFamilyCount
+};
+
+/*
+ * Start counting, with opcode family sampling if "sampleOpcodes".
+ * Returns false if this kernel won't give us the cycle counter.
+ */
+bool dvmPerfStart(bool sampleOpcodes);
+
+/*
+ * Stop counting.  Each thread closes its counters the next time it
+ * crosses the bridge, or when it exits.
+ */
+void dvmPerfStop();
+void dvmPerfReset();
+
+/*
+ * Bracket a bridge call into protected method "methodIdx" (the index of
+ * its SeparatorData).  A thread's first call into the interpreter isn't
+ * counted: it has no counters yet.
+ */
+struct PerfScope {
+    bool    counting;
+    u4      generation;             /* of the counters "start" came from */
+    u8      start[kPerfEventCount];
+};
+
+void dvmPerfEnter(PerfScope* scope);
+void dvmPerfExit(PerfScope* scope, u4 methodIdx);
+
+/*
+ * Totals over all threads.  "counts" gets the number of calls followed
+ * by kPerfEventCount event counts; an event the CPU doesn't have stays
+ * 0.  Returns false if the method was never counted.
+ */
+bool dvmPerfMethodCounts(u4 methodIdx, u8* counts);
+
+/*
+ * Sampled event counts by opcode family, indexed
+ * event * kOpFamilyCount + family.
+ */
+void dvmPerfFamilyCounts(u8* counts);
+
+const char* dvmPerfEventName(int event);
+const char* dvmOpcodeFamilyName(int family);
+
+/*
+ * Write per-method and per-family counts, IPC and misses per thousand
+ * instructions as CSV.
+ */
+bool dvmPerfDump(const char* path);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmPerfThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_PERFCOUNTERS_H
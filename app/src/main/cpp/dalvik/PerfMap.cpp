@@ -0,0 +1,59 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "PerfMap.h"
+#include "Globals.h"
+#include "YcFile.h"
+#include "log.h"
+
+#ifndef PR_SET_VMA
+#define PR_SET_VMA              0x53564d41
+#define PR_SET_VMA_ANON_NAME    0
+#endif
+
+void dvmNameAnonRegion(void* addr, size_t length, const char* name)
+{
+    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, (unsigned long) addr, length,
+        (unsigned long) name);
+}
+
+bool dvmPerfMapWrite(const char* dir)
+{
+    YcFile* ycFile = gAdvmp.ycFile;
+    if (ycFile == NULL) {
+        return false;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/perf-%d.map", dir, (int) getpid());
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    /* "<start> <size> <name>", hex without 0x, one range per line */
+    const u1* raw = ycFile->getCodeSection()->raw;
+    u4 count = ycFile->getSeparatorCount();
+    for (u4 i = 0; i < count; i++) {
+        const SeparatorData* sd = ycFile->getSeparatorData(i);
+        if (sd->insnsSize == 0) {
+            continue;
+        }
+        fprintf(fp, "%zx %zx advmp:method@%u(%.*s)#%u\n",
+            (size_t) (raw + sd->codeOff), (size_t) sd->insnsSize * sizeof(u2),
+            sd->methodIndex, (int) sd->shortyLen, sd->shorty, i);
+    }
+
+    bool ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (ok) {
+        MY_LOG_INFO("perf map written: %s", path);
+    }
+    return ok;
+}
@@ -0,0 +1,32 @@
+#ifndef CUSTOMAPPVMP_PERFMAP_H
+#define CUSTOMAPPVMP_PERFMAP_H
+
+#include <stddef.h>
+#include "Common.h"
+
+/*
+ * Names for our anonymous memory, for native tools.
+ *
+ * We generate no machine code, so native samples already land in named
+ * functions (the interpreter, intrinsics, bridges).  What tools can't
+ * name is the anonymous memory we fill at run time: the decoded bytecode
+ * of every protected method, which shows up as data addresses in
+ * "perf mem"/"simpleperf" cache-miss samples and in debuggers.
+ */
+
+/*
+ * Name an anonymous mapping in /proc/<pid>/maps ("[anon:<name>]").
+ * "name" must be a string literal: older kernels keep the pointer.
+ * Ignored where the kernel doesn't support it.
+ */
+void dvmNameAnonRegion(void* addr, size_t length, const char* name);
+
+/*
+ * Write <dir>/perf-<pid>.map with an entry per protected method, naming
+ * the range its decoded instructions occupy.  The code section is
+ * reserved up front, so the ranges are valid before their chunks are
+ * inflated.  perf reads the file from /tmp; elsewhere, copy it there.
+ */
+bool dvmPerfMapWrite(const char* dir);
+
+#endif //CUSTOMAPPVMP_PERFMAP_H
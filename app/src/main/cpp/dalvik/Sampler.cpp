@@ -0,0 +1,752 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "Sampler.h"
+#include "PerfMap.h"
+#include "Stack.h"
+#include "atomic-arm.h"
+#include "log.h"
+
+#ifndef SIGEV_THREAD_ID
+#define SIGEV_THREAD_ID 4
+#endif
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+struct SamplerState {
+    volatile int32_t running;
+    volatile int32_t nextSample;    /* slots claimed, may exceed capacity */
+    volatile int32_t dropped;
+    int32_t         capacity;
+    bool            precise;
+    long            periodNs;
+    u8              startRealNs;    /* for pprof's time_nanos */
+    u8              startNs;
+    u8              stopNs;
+    Sample*         samples;
+    size_t          mapLength;
+};
+
+static SamplerState gSampler;
+static pthread_mutex_t gSamplerLock = PTHREAD_MUTEX_INITIALIZER;
+static bool gHandlerInstalled;
+
+static u8 nowNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Stop a timer from the signal handler; timer_settime is async-signal-safe,
+ * timer_delete isn't.  The timer itself goes at stop or thread exit.
+ */
+static void pauseTimer(AdvmpThread* thread)
+{
+    if (thread->hasSampleTimer) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        timer_settime(thread->sampleTimer, 0, &spec, NULL);
+    }
+}
+
+/*
+ * Signal context: no locks, no allocation, and of libdvm only
+ * dvmThreadSelf, which is a pthread_getspecific.  Everything else we read
+ * is either our own state or frame data the thread itself wrote before
+ * publishing the frame through curFrame.
+ */
+static void recordSample(AdvmpThread* thread)
+{
+    /*
+     * A thread can detach from the VM and go on running native code long
+     * before its AdvmpThread goes away at pthread exit.  libdvm clears its
+     * thread-local before freeing the Thread, so a mismatch means "self"
+     * is stale: stop sampling until the thread is back in the interpreter.
+     */
+    Thread* self = thread->self;
+    if (self == NULL || dvmThreadSelfHook == NULL
+        || dvmThreadSelfHook() != self)
+    {
+        pauseTimer(thread);
+        return;
+    }
+
+    u4* fp = (u4*) self->interpSave.curFrame;
+    if (fp == NULL) {
+        return;
+    }
+
+    int32_t idx = __sync_fetch_and_add(&gSampler.nextSample, 1);
+    if (idx >= gSampler.capacity) {
+        __sync_fetch_and_add(&gSampler.dropped, 1);
+        return;
+    }
+    Sample* sample = &gSampler.samples[idx];
+
+    const u1* stackLow = self->interpStackStart - self->interpStackSize;
+    const u1* stackHigh = self->interpStackStart;
+    const u2* pc = gSampler.precise ? thread->curPc : NULL;
+    u4 depth = 0;
+    while (fp != NULL && depth < kSamplerMaxDepth) {
+        const StackSaveArea* saveArea = SAVEAREA_FROM_FP(fp);
+        if ((const u1*) saveArea < stackLow || (const u1*) fp > stackHigh) {
+            break;
+        }
+        const Method* method = saveArea->method;
+        if (method != NULL) {
+            s4 pcOffset = -1;
+            if (pc != NULL && !dvmIsNativeMethod(method)
+                && pc >= method->insns
+                && pc < method->insns + dvmGetMethodInsnsSize(method))
+            {
+                pcOffset = pc - method->insns;
+            }
+            sample->frames[depth].method = method;
+            sample->frames[depth].pcOffset = pcOffset;
+            depth++;
+            pc = saveArea->savedPc;
+        } else {
+            /* break frame; whatever called it isn't interpreted */
+            pc = NULL;
+        }
+
+        /* callers live at higher addresses; anything else is garbage */
+        u4* prevFrame = saveArea->prevFrame;
+        if (prevFrame != NULL && prevFrame <= fp) {
+            break;
+        }
+        fp = prevFrame;
+    }
+
+    sample->tid = thread->tid;
+    sample->depth = depth;
+    ANDROID_MEMBAR_STORE();
+    sample->ready = 1;
+}
+
+static void samplerSignalHandler(int signo, siginfo_t* info, void* context)
+{
+    int savedErrno = errno;
+    if (gSampler.running) {
+        /* NULL once the thread has started exiting */
+        AdvmpThread* thread = dvmAdvmpThreadCurrent();
+        if (thread != NULL) {
+            recordSample(thread);
+        }
+    }
+    errno = savedErrno;
+}
+
+static void armTimer(AdvmpThread* thread, void* arg)
+{
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = gSampler.periodNs / 1000000000L;
+    spec.it_interval.tv_nsec = gSampler.periodNs % 1000000000L;
+    spec.it_value = spec.it_interval;
+
+    if (thread->hasSampleTimer) {
+        /* paused by the handler while the thread was detached */
+        timer_settime(thread->sampleTimer, 0, &spec, NULL);
+        return;
+    }
+
+    clockid_t clock;
+    if (pthread_getcpuclockid(thread->handle, &clock) != 0) {
+        MY_LOG_WARNING("no cpu clock for thread %d, not sampled", thread->tid);
+        return;
+    }
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = thread->tid;
+    if (timer_create(clock, &sev, &thread->sampleTimer) != 0) {
+        MY_LOG_WARNING("timer_create for thread %d failed: %s", thread->tid,
+            strerror(errno));
+        return;
+    }
+
+    if (timer_settime(thread->sampleTimer, 0, &spec, NULL) != 0) {
+        MY_LOG_WARNING("timer_settime for thread %d failed: %s", thread->tid,
+            strerror(errno));
+        timer_delete(thread->sampleTimer);
+        return;
+    }
+    thread->hasSampleTimer = true;
+    if (gSampler.precise) {
+        dvmAdvmpEnableSubMode(thread, kAdvmpSubModeSamplePc);
+    }
+}
+
+static void disarmTimer(AdvmpThread* thread, void* arg)
+{
+    if (thread->hasSampleTimer) {
+        timer_delete(thread->sampleTimer);
+        thread->hasSampleTimer = false;
+    }
+    dvmAdvmpDisableSubMode(thread, kAdvmpSubModeSamplePc);
+}
+
+void dvmSamplerThreadStarted(AdvmpThread* thread)
+{
+    if (gSampler.running) {
+        armTimer(thread, NULL);
+    }
+}
+
+void dvmSamplerThreadExiting(AdvmpThread* thread)
+{
+    disarmTimer(thread, NULL);
+}
+
+static bool installHandler()
+{
+    if (gHandlerInstalled) {
+        return true;
+    }
+
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = samplerSignalHandler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, NULL, &old) != 0) {
+        return false;
+    }
+    if ((old.sa_flags & SA_SIGINFO) != 0
+        || (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN))
+    {
+        MY_LOG_ERROR("SIGPROF already has a handler, not sampling");
+        return false;
+    }
+    if (sigaction(SIGPROF, &sa, NULL) != 0) {
+        return false;
+    }
+
+    /*
+     * Never uninstalled: a signal can still be queued after the timers
+     * are deleted, and SIGPROF's default action kills the process.
+     */
+    gHandlerInstalled = true;
+    return true;
+}
+
+bool dvmSamplerStart(int hz, int capacity, bool precise)
+{
+    if (hz <= 0 || hz > 10000
+        || capacity <= 0 || capacity > kSamplerMaxCapacity)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&gSamplerLock);
+    if (gSampler.running || !installHandler()) {
+        pthread_mutex_unlock(&gSamplerLock);
+        return false;
+    }
+
+    /*
+     * A fresh zeroed map each run.  The old one is released here rather
+     * than at stop, so a handler that was already running when its timer
+     * was deleted has long finished with it.
+     */
+    if (gSampler.samples != NULL) {
+        munmap(gSampler.samples, gSampler.mapLength);
+        gSampler.samples = NULL;
+    }
+    size_t mapLength = (size_t) capacity * sizeof(Sample);
+    void* map = mmap(NULL, mapLength, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        MY_LOG_ERROR("unable to map %zu bytes of samples", mapLength);
+        pthread_mutex_unlock(&gSamplerLock);
+        return false;
+    }
+
+    dvmNameAnonRegion(map, mapLength, "advmp-samples");
+    gSampler.samples = (Sample*) map;
+    gSampler.mapLength = mapLength;
+    gSampler.capacity = capacity;
+    gSampler.nextSample = 0;
+    gSampler.dropped = 0;
+    gSampler.precise = precise;
+    gSampler.periodNs = 1000000000L / hz;
+    gSampler.startRealNs = nowNs(CLOCK_REALTIME);
+    gSampler.startNs = nowNs(CLOCK_MONOTONIC);
+    gSampler.stopNs = 0;
+    ANDROID_MEMBAR_STORE();
+    gSampler.running = 1;
+
+    /* threads registering from now on arm their own timer */
+    dvmAdvmpForEachThread(armTimer, NULL);
+    pthread_mutex_unlock(&gSamplerLock);
+
+    MY_LOG_INFO("sampler started: %d Hz, %d samples%s", hz, capacity,
+        precise ? ", precise" : "");
+    return true;
+}
+
+void dvmSamplerStop()
+{
+    pthread_mutex_lock(&gSamplerLock);
+    if (gSampler.running) {
+        gSampler.running = 0;
+        dvmAdvmpForEachThread(disarmTimer, NULL);
+        gSampler.stopNs = nowNs(CLOCK_MONOTONIC);
+        MY_LOG_INFO("sampler stopped: %u samples, %u dropped",
+            dvmSamplerSampleCount(), dvmSamplerDroppedCount());
+    }
+    pthread_mutex_unlock(&gSamplerLock);
+}
+
+bool dvmSamplerRunning()
+{
+    return gSampler.running != 0;
+}
+
+u4 dvmSamplerSampleCount()
+{
+    int32_t count = gSampler.nextSample;
+    return (u4) (count < gSampler.capacity ? count : gSampler.capacity);
+}
+
+u4 dvmSamplerDroppedCount()
+{
+    return (u4) gSampler.dropped;
+}
+
+/*
+ * ===========================================================================
+ *      Output
+ * ===========================================================================
+ */
+
+/*
+ * Identical stacks are merged before writing.  Without "withPc", frames
+ * that differ only in pc are the same.
+ */
+struct StackCount {
+    const Sample*   sample;
+    u4              count;
+};
+
+struct StackTable {
+    StackCount*     entries;
+    u4              mask;
+    u4              used;
+};
+
+static u4 roundUpPow2(u4 val)
+{
+    u4 size = 16;
+    while (size < val) {
+        size <<= 1;
+    }
+    return size;
+}
+
+static u4 hashStack(const Sample* sample, bool withPc)
+{
+    u4 hash = 2166136261u;
+    for (u4 i = 0; i < sample->depth; i++) {
+        hash = (hash ^ (u4) ((uintptr_t) sample->frames[i].method >> 2))
+            * 16777619u;
+        if (withPc) {
+            hash = (hash ^ (u4) sample->frames[i].pcOffset) * 16777619u;
+        }
+    }
+    return hash ^ (hash >> 15);
+}
+
+static bool sameStack(const Sample* a, const Sample* b, bool withPc)
+{
+    if (a->depth != b->depth) {
+        return false;
+    }
+    for (u4 i = 0; i < a->depth; i++) {
+        if (a->frames[i].method != b->frames[i].method
+            || (withPc && a->frames[i].pcOffset != b->frames[i].pcOffset))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool mergeStacks(StackTable* table, bool withPc)
+{
+    u4 count = dvmSamplerSampleCount();
+    table->mask = roundUpPow2(count * 2) - 1;
+    table->used = 0;
+    table->entries = (StackCount*) calloc(table->mask + 1, sizeof(StackCount));
+    if (table->entries == NULL) {
+        return false;
+    }
+
+    for (u4 i = 0; i < count; i++) {
+        const Sample* sample = &gSampler.samples[i];
+        if (android_atomic_acquire_load(&sample->ready) == 0
+            || sample->depth == 0)
+        {
+            continue;
+        }
+        u4 idx = hashStack(sample, withPc) & table->mask;
+        while (table->entries[idx].sample != NULL
+            && !sameStack(table->entries[idx].sample, sample, withPc))
+        {
+            idx = (idx + 1) & table->mask;
+        }
+        if (table->entries[idx].sample == NULL) {
+            table->entries[idx].sample = sample;
+            table->used++;
+        }
+        table->entries[idx].count++;
+    }
+    return true;
+}
+
+/*
+ * "Lcom/foo/Bar;" + "baz" -> "com.foo.Bar.baz"
+ */
+static void formatMethod(char* buf, size_t len, const Method* method)
+{
+    const char* desc = method->clazz->descriptor;
+    size_t pos = 0;
+    if (*desc == 'L') {
+        desc++;
+    }
+    while (*desc != '\0' && *desc != ';' && pos + 1 < len) {
+        buf[pos++] = (*desc == '/') ? '.' : *desc;
+        desc++;
+    }
+    snprintf(buf + pos, len - pos, ".%s", method->name);
+}
+
+static int lineNumber(const SampleFrame* frame)
+{
+    if (frame->pcOffset < 0 || dvmIsNativeMethod(frame->method)
+        || dvmLineNumFromPChook == NULL)
+    {
+        return 0;
+    }
+    return dvmLineNumFromPChook(frame->method, frame->pcOffset);
+}
+
+bool dvmSamplerWriteFolded(const char* path, bool withLines)
+{
+    pthread_mutex_lock(&gSamplerLock);
+    StackTable table;
+    if (gSampler.samples == NULL || !mergeStacks(&table, withLines)) {
+        pthread_mutex_unlock(&gSamplerLock);
+        return false;
+    }
+
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+        free(table.entries);
+        pthread_mutex_unlock(&gSamplerLock);
+        return false;
+    }
+
+    char name[512];
+    for (u4 i = 0; i <= table.mask; i++) {
+        const Sample* sample = table.entries[i].sample;
+        if (sample == NULL) {
+            continue;
+        }
+        /* outermost frame first */
+        for (u4 j = sample->depth; j-- > 0; ) {
+            const SampleFrame* frame = &sample->frames[j];
+            formatMethod(name, sizeof(name), frame->method);
+            fputs(name, fp);
+            int line = withLines ? lineNumber(frame) : 0;
+            if (line > 0) {
+                fprintf(fp, ":%d", line);
+            }
+            fputc(j != 0 ? ';' : ' ', fp);
+        }
+        fprintf(fp, "%u\n", table.entries[i].count);
+    }
+
+    bool ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    free(table.entries);
+    pthread_mutex_unlock(&gSamplerLock);
+    return ok;
+}
+
+/*
+ * Just enough protobuf encoding for profile.proto.
+ */
+struct ProtoBuf {
+    u1*     data;
+    size_t  len;
+    size_t  cap;
+    bool    failed;
+};
+
+static void pbInit(ProtoBuf* pb)
+{
+    memset(pb, 0, sizeof(*pb));
+}
+
+static void pbAppend(ProtoBuf* pb, const void* data, size_t len)
+{
+    if (pb->failed) {
+        return;
+    }
+    if (pb->len + len > pb->cap) {
+        size_t cap = pb->cap != 0 ? pb->cap * 2 : 256;
+        while (cap < pb->len + len) {
+            cap *= 2;
+        }
+        u1* grown = (u1*) realloc(pb->data, cap);
+        if (grown == NULL) {
+            pb->failed = true;
+            return;
+        }
+        pb->data = grown;
+        pb->cap = cap;
+    }
+    memcpy(pb->data + pb->len, data, len);
+    pb->len += len;
+}
+
+static void pbVarint(ProtoBuf* pb, u8 val)
+{
+    u1 buf[10];
+    size_t len = 0;
+    while (val >= 0x80) {
+        buf[len++] = (u1) (val | 0x80);
+        val >>= 7;
+    }
+    buf[len++] = (u1) val;
+    pbAppend(pb, buf, len);
+}
+
+static void pbUint(ProtoBuf* pb, u4 field, u8 val)
+{
+    pbVarint(pb, (u8) field << 3);
+    pbVarint(pb, val);
+}
+
+static void pbBytes(ProtoBuf* pb, u4 field, const void* data, size_t len)
+{
+    pbVarint(pb, ((u8) field << 3) | 2);
+    pbVarint(pb, len);
+    pbAppend(pb, data, len);
+}
+
+/* append "sub" as field "field", then empty it for reuse */
+static void pbMessage(ProtoBuf* pb, u4 field, ProtoBuf* sub)
+{
+    if (sub->failed) {
+        pb->failed = true;
+    }
+    pbBytes(pb, field, sub->data, sub->len);
+    sub->len = 0;
+}
+
+static void pbFree(ProtoBuf* pb)
+{
+    free(pb->data);
+}
+
+/* profile.proto field numbers */
+enum {
+    kProfileSampleType      = 1,
+    kProfileSample          = 2,
+    kProfileLocation        = 4,
+    kProfileFunction        = 5,
+    kProfileStringTable     = 6,
+    kProfileTimeNanos       = 9,
+    kProfileDurationNanos   = 10,
+    kProfilePeriodType      = 11,
+    kProfilePeriod          = 12,
+};
+
+/* strings the profile refers to by index; 0 is always "" */
+enum {
+    kStrEmpty = 0, kStrSamples, kStrCount, kStrCpu, kStrNanoseconds,
+    kStrFirstDynamic
+};
+
+static void writeValueType(ProtoBuf* pb, ProtoBuf* sub, u4 field,
+    u4 type, u4 unit)
+{
+    pbUint(sub, 1, type);
+    pbUint(sub, 2, unit);
+    pbMessage(pb, field, sub);
+}
+
+/*
+ * One location per distinct (method, pc), one function per method.  Ids
+ * are 1-based table order, assigned as frames are first seen.
+ */
+struct PprofKey {
+    const Method*   method;
+    s4              pcOffset;
+    u4              id;
+};
+
+struct PprofTable {
+    PprofKey*       entries;
+    u4              mask;
+    u4              used;
+};
+
+static u4 pprofLookup(PprofTable* table, const Method* method, s4 pcOffset,
+    bool* added)
+{
+    u4 hash = (u4) ((uintptr_t) method >> 2) * 2654435761u
+        ^ (u4) pcOffset * 40503u;
+    u4 idx = (hash ^ (hash >> 16)) & table->mask;
+    while (table->entries[idx].method != NULL) {
+        if (table->entries[idx].method == method
+            && table->entries[idx].pcOffset == pcOffset)
+        {
+            *added = false;
+            return table->entries[idx].id;
+        }
+        idx = (idx + 1) & table->mask;
+    }
+    table->entries[idx].method = method;
+    table->entries[idx].pcOffset = pcOffset;
+    table->entries[idx].id = ++table->used;
+    *added = true;
+    return table->entries[idx].id;
+}
+
+bool dvmSamplerWritePprof(const char* path)
+{
+    pthread_mutex_lock(&gSamplerLock);
+    StackTable stacks;
+    if (gSampler.samples == NULL || !mergeStacks(&stacks, true)) {
+        pthread_mutex_unlock(&gSamplerLock);
+        return false;
+    }
+
+    u4 maxFrames = dvmSamplerSampleCount() * kSamplerMaxDepth;
+    u4 tableSize = roundUpPow2(maxFrames < 65536 ? maxFrames * 2 : 131072);
+    PprofTable locations, functions;
+    locations.mask = functions.mask = tableSize - 1;
+    locations.used = functions.used = 0;
+    locations.entries = (PprofKey*) calloc(tableSize, sizeof(PprofKey));
+    functions.entries = (PprofKey*) calloc(tableSize, sizeof(PprofKey));
+
+    ProtoBuf out, sub, packed, line, strings;
+    pbInit(&out);
+    pbInit(&sub);
+    pbInit(&packed);
+    pbInit(&line);
+    pbInit(&strings);
+    u4 stringCount = kStrFirstDynamic;
+    bool ok = locations.entries != NULL && functions.entries != NULL;
+
+    writeValueType(&out, &sub, kProfileSampleType, kStrSamples, kStrCount);
+    writeValueType(&out, &sub, kProfileSampleType, kStrCpu, kStrNanoseconds);
+
+    char name[512];
+    for (u4 i = 0; ok && i <= stacks.mask; i++) {
+        const Sample* sample = stacks.entries[i].sample;
+        if (sample == NULL) {
+            continue;
+        }
+        /* a table fuller than 3/4 means the frame bound was exceeded */
+        if ((locations.used + sample->depth) * 4 > tableSize * 3) {
+            MY_LOG_WARNING("too many distinct frames, pprof output truncated");
+            break;
+        }
+
+        for (u4 j = 0; j < sample->depth; j++) {
+            const SampleFrame* frame = &sample->frames[j];
+            bool added;
+            u4 locationId = pprofLookup(&locations, frame->method,
+                frame->pcOffset, &added);
+            pbVarint(&packed, locationId);
+            if (!added) {
+                continue;
+            }
+
+            u4 functionId = pprofLookup(&functions, frame->method, 0, &added);
+            if (added) {
+                formatMethod(name, sizeof(name), frame->method);
+                pbBytes(&strings, kProfileStringTable, name, strlen(name));
+                const char* file = frame->method->clazz->sourceFile;
+                if (file == NULL) {
+                    file = "";
+                }
+                pbBytes(&strings, kProfileStringTable, file, strlen(file));
+                pbUint(&sub, 1, functionId);
+                pbUint(&sub, 2, stringCount);
+                pbUint(&sub, 3, stringCount);
+                pbUint(&sub, 4, stringCount + 1);
+                pbMessage(&out, kProfileFunction, &sub);
+                stringCount += 2;
+            }
+
+            pbUint(&line, 1, functionId);
+            pbUint(&line, 2, lineNumber(frame));
+            pbUint(&sub, 1, locationId);
+            pbMessage(&sub, 4, &line);
+            pbMessage(&out, kProfileLocation, &sub);
+        }
+
+        /* Sample: location_id (leaf first) and value, both packed */
+        pbMessage(&sub, 1, &packed);
+        pbVarint(&packed, stacks.entries[i].count);
+        pbVarint(&packed, (u8) stacks.entries[i].count * gSampler.periodNs);
+        pbMessage(&sub, 2, &packed);
+        pbMessage(&out, kProfileSample, &sub);
+    }
+
+    static const char* const kFixedStrings[kStrFirstDynamic] = {
+        "", "samples", "count", "cpu", "nanoseconds"
+    };
+    for (int i = 0; i < kStrFirstDynamic; i++) {
+        pbBytes(&out, kProfileStringTable, kFixedStrings[i],
+            strlen(kFixedStrings[i]));
+    }
+    pbAppend(&out, strings.data, strings.len);
+
+    u8 stopNs = gSampler.running ? nowNs(CLOCK_MONOTONIC) : gSampler.stopNs;
+    pbUint(&out, kProfileTimeNanos, gSampler.startRealNs);
+    pbUint(&out, kProfileDurationNanos, stopNs - gSampler.startNs);
+    writeValueType(&out, &sub, kProfilePeriodType, kStrCpu, kStrNanoseconds);
+    pbUint(&out, kProfilePeriod, gSampler.periodNs);
+
+    ok = ok && !out.failed && !strings.failed;
+    if (ok) {
+        FILE* fp = fopen(path, "wb");
+        if (fp == NULL) {
+            MY_LOG_ERROR("can't open %s: %s", path, strerror(errno));
+            ok = false;
+        } else {
+            ok = fwrite(out.data, 1, out.len, fp) == out.len;
+            if (fclose(fp) != 0) {
+                ok = false;
+            }
+        }
+    }
+
+    pbFree(&out);
+    pbFree(&sub);
+    pbFree(&packed);
+    pbFree(&line);
+    pbFree(&strings);
+    free(locations.entries);
+    free(functions.entries);
+    free(stacks.entries);
+    pthread_mutex_unlock(&gSamplerLock);
+    return ok;
+}
@@ -0,0 +1,78 @@
+#ifndef CUSTOMAPPVMP_SAMPLER_H
+#define CUSTOMAPPVMP_SAMPLER_H
+
+#include "Common.h"
+#include "AdvmpThread.h"
+
+/*
+ * Sampling profiler for code run by our interpreter.
+ *
+ * Every thread that has entered the interpreter gets a SIGPROF timer on
+ * its own CPU clock.  The signal handler walks the thread's interpreted
+ * frames (StackSaveArea chain from interpSave.curFrame) and stores the
+ * (method, pc) stack in a preallocated buffer; it takes no locks and
+ * allocates nothing.  Stacks are symbolized only when written out.
+ *
+ * Caller frames always have an exact pc (the invoke they are in).  The
+ * innermost frame's pc is only known in precise mode, which keeps the
+ * sampled threads on the instrumented handler table so it can record
+ * the pc of every instruction; otherwise it is reported per method.
+ */
+#define kSamplerMaxDepth        64
+#define kSamplerDefaultHz       100
+#define kSamplerDefaultCapacity 4096
+#define kSamplerMaxCapacity     (1 << 17)   /* 68MB at 524 bytes a sample */
+
+struct SampleFrame {
+    const Method*   method;
+    s4              pcOffset;       /* code units, or -1 if unknown */
+};
+
+struct Sample {
+    volatile int32_t ready;         /* set once the frames are written */
+    pid_t           tid;
+    u4              depth;
+    SampleFrame     frames[kSamplerMaxDepth];   /* innermost first */
+};
+
+/*
+ * Start sampling every interpreter thread, present and future, "hz"
+ * times per second of CPU time.  Samples past "capacity" are dropped;
+ * a capacity above kSamplerMaxCapacity is refused.  Discards the
+ * samples of an earlier run.
+ */
+bool dvmSamplerStart(int hz, int capacity, bool precise);
+
+/*
+ * Disarm the timers.  The samples stay until the next start.
+ */
+void dvmSamplerStop();
+
+bool dvmSamplerRunning();
+
+/*
+ * Samples taken so far, and samples lost because the buffer was full.
+ */
+u4 dvmSamplerSampleCount();
+u4 dvmSamplerDroppedCount();
+
+/*
+ * Write the samples as folded stacks ("outer;inner count" per line), the
+ * input format of flamegraph.pl and most flame graph viewers.  With
+ * "withLines", frames are "Class.method:line".
+ */
+bool dvmSamplerWriteFolded(const char* path, bool withLines);
+
+/*
+ * Write the samples as an uncompressed pprof profile.proto.
+ */
+bool dvmSamplerWritePprof(const char* path);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.  Started is
+ * also called when a thread comes back attached to a new Thread.
+ */
+void dvmSamplerThreadStarted(AdvmpThread* thread);
+void dvmSamplerThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_SAMPLER_H
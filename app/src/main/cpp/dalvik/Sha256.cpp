@@ -0,0 +1,111 @@
+#include <string.h>
+#include "Sha256.h"
+
+static const u4 kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline u4 rotr32(u4 x, int r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256Transform(u4* state, const u1* block)
+{
+    u4 w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((u4) block[4 * i] << 24) | ((u4) block[4 * i + 1] << 16)
+            | ((u4) block[4 * i + 2] << 8) | (u4) block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        u4 s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        u4 s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    u4 a = state[0], b = state[1], c = state[2], d = state[3];
+    u4 e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        u4 s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+        u4 ch = (e & f) ^ (~e & g);
+        u4 t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+        u4 s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+        u4 maj = (a & b) ^ (a & c) ^ (b & c);
+        u4 t2 = s0 + maj;
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256Init(Sha256Ctx* ctx)
+{
+    static const u4 kInitialState[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, kInitialState, sizeof(kInitialState));
+    ctx->length = 0;
+    ctx->bufLen = 0;
+}
+
+void sha256Update(Sha256Ctx* ctx, const void* data, size_t len)
+{
+    const u1* ptr = (const u1*) data;
+    ctx->length += len;
+
+    if (ctx->bufLen != 0) {
+        size_t take = 64 - ctx->bufLen;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(ctx->buf + ctx->bufLen, ptr, take);
+        ctx->bufLen += take;
+        ptr += take;
+        len -= take;
+        if (ctx->bufLen < 64) {
+            return;
+        }
+        sha256Transform(ctx->state, ctx->buf);
+        ctx->bufLen = 0;
+    }
+    while (len >= 64) {
+        sha256Transform(ctx->state, ptr);
+        ptr += 64;
+        len -= 64;
+    }
+    memcpy(ctx->buf, ptr, len);
+    ctx->bufLen = len;
+}
+
+void sha256Final(Sha256Ctx* ctx, u1 digest[SHA256_DIGEST_SIZE])
+{
+    u8 bitLength = ctx->length * 8;
+
+    ctx->buf[ctx->bufLen++] = 0x80;
+    if (ctx->bufLen > 56) {
+        memset(ctx->buf + ctx->bufLen, 0, 64 - ctx->bufLen);
+        sha256Transform(ctx->state, ctx->buf);
+        ctx->bufLen = 0;
+    }
+    memset(ctx->buf + ctx->bufLen, 0, 56 - ctx->bufLen);
+    for (int i = 0; i < 8; i++) {
+        ctx->buf[56 + i] = (u1) (bitLength >> (56 - 8 * i));
+    }
+    sha256Transform(ctx->state, ctx->buf);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (u1) (ctx->state[i] >> 24);
+        digest[4 * i + 1] = (u1) (ctx->state[i] >> 16);
+        digest[4 * i + 2] = (u1) (ctx->state[i] >> 8);
+        digest[4 * i + 3] = (u1) ctx->state[i];
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef CUSTOMAPPVMP_SHA256_H
+#define CUSTOMAPPVMP_SHA256_H
+
+#include <stddef.h>
+#include "Common.h"
+
+#define SHA256_DIGEST_SIZE  32
+
+/*
+ * Plain FIPS 180-4 SHA-256.  Only used over small inputs (the root of the
+ * yc digest tree), so there is no hardware-accelerated path.
+ */
+struct Sha256Ctx {
+    u4  state[8];
+    u8  length;                 /* bytes hashed so far */
+    u1  buf[64];
+    u4  bufLen;
+};
+
+void sha256Init(Sha256Ctx* ctx);
+void sha256Update(Sha256Ctx* ctx, const void* data, size_t len);
+void sha256Final(Sha256Ctx* ctx, u1 digest[SHA256_DIGEST_SIZE]);
+
+#endif //CUSTOMAPPVMP_SHA256_H
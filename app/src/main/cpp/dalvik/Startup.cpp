@@ -0,0 +1,106 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Startup.h"
+
+#ifndef CLOCK_BOOTTIME
+#define CLOCK_BOOTTIME 7
+#endif
+
+volatile u8 gStartupTimeline[kStartupPhaseCount];
+
+/* marks are rare; this also keeps the u8 stores whole on 32-bit CPUs */
+static pthread_mutex_t gStartupLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* const kPhaseNames[kStartupPhaseCount] = {
+    "process",
+    "onLoad",
+    "nativesRegistered",
+    "ycLocated",
+    "ycMapped",
+    "ycParsed",
+    "hooksBound",
+    "firstMaterialized",
+    "firstInstruction",
+    "firstResult",
+};
+
+static u8 readClockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void dvmStartupRecord(StartupPhase phase)
+{
+    u8 now = readClockNs(CLOCK_MONOTONIC);
+    pthread_mutex_lock(&gStartupLock);
+    if (gStartupTimeline[phase] == 0) {
+        gStartupTimeline[phase] = now;
+    }
+    pthread_mutex_unlock(&gStartupLock);
+}
+
+/*
+ * Process start on the monotonic clock.  /proc/self/stat has it in clock
+ * ticks since boot, which counts time asleep; take that back out using
+ * the current difference between the two clocks.
+ */
+static u8 processStartNs()
+{
+    char buf[512];
+    int fd = open("/proc/self/stat", O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return 0;
+    }
+    buf[len] = '\0';
+
+    /* starttime is field 22; the command name (field 2) may hold spaces */
+    const char* p = strrchr(buf, ')');
+    for (int field = 2; p != NULL && field < 22; field++) {
+        p = strchr(p + 1, ' ');
+    }
+    if (p == NULL) {
+        return 0;
+    }
+    u8 ticks = strtoull(p + 1, NULL, 10);
+    long hz = sysconf(_SC_CLK_TCK);
+    if (hz <= 0) {
+        return 0;
+    }
+
+    u8 startBoot = ticks * (1000000000ULL / hz);
+    u8 nowBoot = readClockNs(CLOCK_BOOTTIME);
+    u8 nowMono = readClockNs(CLOCK_MONOTONIC);
+    u8 asleep = nowBoot > nowMono ? nowBoot - nowMono : 0;
+    return startBoot > asleep ? startBoot - asleep : 0;
+}
+
+void dvmStartupTimeline(u8* times)
+{
+    pthread_mutex_lock(&gStartupLock);
+    if (gStartupTimeline[kStartupProcess] == 0) {
+        gStartupTimeline[kStartupProcess] = processStartNs();
+    }
+    for (int i = 0; i < kStartupPhaseCount; i++) {
+        times[i] = gStartupTimeline[i];
+    }
+    pthread_mutex_unlock(&gStartupLock);
+}
+
+const char* dvmStartupPhaseName(int phase)
+{
+    if (phase < 0 || phase >= kStartupPhaseCount) {
+        return NULL;
+    }
+    return kPhaseNames[phase];
+}
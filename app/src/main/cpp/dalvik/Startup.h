@@ -0,0 +1,49 @@
+#ifndef CUSTOMAPPVMP_STARTUP_H
+#define CUSTOMAPPVMP_STARTUP_H
+
+#include "Common.h"
+#include "Inlines.h"
+
+/*
+ * Startup timeline: CLOCK_MONOTONIC nanoseconds at which each phase of
+ * bringing up protected code was first reached.  Only the first mark of
+ * a phase counts, so marks can sit on paths that run on every call.
+ */
+enum StartupPhase {
+    kStartupProcess = 0,            /* process start, from /proc/self/stat */
+    kStartupOnLoad,                 /* JNI_OnLoad entered */
+    kStartupNativesRegistered,
+    kStartupYcLocated,              /* APK path known */
+    kStartupYcMapped,
+    kStartupYcParsed,               /* index parsed or cached image attached */
+    kStartupHooksBound,             /* libdvm entry points resolved */
+    kStartupFirstMaterialized,      /* first method's code inflated and verified */
+    kStartupFirstInstruction,
+    kStartupFirstResult,            /* first protected call returned */
+
+    kStartupPhaseCount
+};
+
+extern volatile u8 gStartupTimeline[kStartupPhaseCount];
+
+void dvmStartupRecord(StartupPhase phase);
+
+INLINE void dvmStartupMark(StartupPhase phase)
+{
+    if (gStartupTimeline[phase] == 0) {
+        dvmStartupRecord(phase);
+    }
+}
+
+/*
+ * Fill "times" (kStartupPhaseCount entries) with the timeline; 0 for a
+ * phase not reached yet.
+ */
+void dvmStartupTimeline(u8* times);
+
+/*
+ * Short name of "phase", or NULL if out of range.
+ */
+const char* dvmStartupPhaseName(int phase);
+
+#endif //CUSTOMAPPVMP_STARTUP_H
@@ -7,6 +7,7 @@
 
 #include "Thread.h"
 #include <dlfcn.h>
+#include "atomic-arm.h"
 typedef void* (*dvmLockObject_func)(Thread* self, Object *obj);
 extern dvmLockObject_func dvmLockObjectHook;
 
@@ -15,4 +16,85 @@ typedef void* (*dvmUnlockObject_func)(Thread* self, Object *obj);
 extern dvmUnlockObject_func dvmUnlockObjectHook;
 
   bool initSynFuction(void *dvm_hand,int apilevel);
+
+/*
+ * Lock word layout, as in vm/Sync.h.  A thin lock is
+ *
+ *    [31 ---- 19] [18 ---- 3] [2 ---- 1] [0]
+ *     lock count   thread id  hash state  0
+ *
+ * and a fat lock holds a Monitor* with the shape bit set.
+ */
+#define LW_SHAPE_THIN 0
+#define LW_SHAPE_FAT 1
+#define LW_SHAPE_MASK 0x1
+#define LW_SHAPE(x) ((x) & LW_SHAPE_MASK)
+
+#define LW_HASH_STATE_MASK 0x3
+#define LW_HASH_STATE_SHIFT 1
+
+#define LW_LOCK_OWNER_MASK 0xffff
+#define LW_LOCK_OWNER_SHIFT 3
+#define LW_LOCK_OWNER(x) (((x) >> LW_LOCK_OWNER_SHIFT) & LW_LOCK_OWNER_MASK)
+
+#define LW_LOCK_COUNT_MASK 0x1fff
+#define LW_LOCK_COUNT_SHIFT 19
+#define LW_LOCK_COUNT(x) (((x) >> LW_LOCK_COUNT_SHIFT) & LW_LOCK_COUNT_MASK)
+
+#define LW_MONITOR(x) \
+  ((Monitor*)((x) & ~((LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT) | \
+                      LW_SHAPE_MASK)))
+
+/*
+ * Thin-lock fast paths for monitor-enter and monitor-exit.  These follow
+ * dvmLockObject/dvmUnlockObject exactly for an unowned or self-owned thin
+ * lock; contention, count overflow and fat locks (inflation, wait/notify)
+ * go to libdvm.
+ *
+ * Only the owner writes a thin lock word it holds, so recursion counts
+ * can use plain stores; taking and dropping the lock are the only atomic
+ * operations.
+ */
+INLINE void dvmLockObjectInline(Thread* self, Object* obj)
+{
+    volatile u4* thinp = &obj->lock;
+    u4 thin = *thinp;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
+        if (LW_LOCK_OWNER(thin) == 0) {
+            u4 newThin = thin | (self->threadId << LW_LOCK_OWNER_SHIFT);
+            if (android_atomic_acquire_cas(thin, newThin,
+                    (volatile int32_t*) thinp) == 0) {
+                return;
+            }
+        } else if (LW_LOCK_OWNER(thin) == self->threadId
+                   && LW_LOCK_COUNT(thin) < LW_LOCK_COUNT_MASK - 1) {
+            /* near the limit, libdvm inflates instead of overflowing */
+            *thinp = thin + (1 << LW_LOCK_COUNT_SHIFT);
+            return;
+        }
+    }
+    dvmLockObjectHook(self, obj);
+}
+
+/*
+ * Returns false, with an exception raised, if "self" doesn't own the
+ * monitor.
+ */
+INLINE bool dvmUnlockObjectInline(Thread* self, Object* obj)
+{
+    volatile u4* thinp = &obj->lock;
+    u4 thin = *thinp;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN
+        && LW_LOCK_OWNER(thin) == self->threadId) {
+        if (LW_LOCK_COUNT(thin) == 0) {
+            /* keep only the hash state */
+            thin &= (LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT);
+            android_atomic_release_store(thin, (volatile int32_t*) thinp);
+        } else {
+            *thinp = thin - (1 << LW_LOCK_COUNT_SHIFT);
+        }
+        return true;
+    }
+    return dvmUnlockObjectHook(self, obj) != NULL;
+}
 #endif //CUSTOMAPPVMP_SYNC_H
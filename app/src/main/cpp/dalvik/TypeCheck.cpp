@@ -2,7 +2,10 @@
 // Created by liu meng on 2018/8/31.
 //
 
+#include <stdlib.h>
+#include <string.h>
 #include "TypeCheck.h"
+#include "log.h"
 
  dvmInstanceofNonTrivial_func dvmInstanceofNonTrivialHook;
 
@@ -24,3 +27,235 @@
     }
 }
 
+
+const ArrayStoreSite* volatile gArrayStoreSites[kArrayStoreSiteCount];
+
+static pthread_mutex_t gArrayStoreSiteLock = PTHREAD_MUTEX_INITIALIZER;
+static u4 gArrayStoreSiteCount;
+
+/* keep the table at most 3/4 full so probe chains stay short */
+#define kArrayStoreSiteLimit    (kArrayStoreSiteCount / 4 * 3)
+
+/*
+ * Slot for "pc": its record's, or the empty one that ends its chain.
+ */
+static u4 findArrayStoreSlot(const u2* pc)
+{
+    u4 idx = ((uintptr_t) pc >> 1) & (kArrayStoreSiteCount - 1);
+    while (gArrayStoreSites[idx] != NULL && gArrayStoreSites[idx]->pc != pc) {
+        idx = (idx + 1) & (kArrayStoreSiteCount - 1);
+    }
+    return idx;
+}
+
+bool dvmCanPutArrayElementSlow(const u2* pc,
+    const ClassObject* objectClass, const ClassObject* arrayClass) {
+    if (!dvmCanPutArrayElementHook(objectClass, arrayClass)) {
+        return false;
+    }
+
+    /* a site that has stopped learning, or a full table, costs no lock */
+    const ArrayStoreSite* old = gArrayStoreSites[findArrayStoreSlot(pc)];
+    if (old != NULL ? old->fills >= kArrayStoreSiteFills
+                    : gArrayStoreSiteCount >= kArrayStoreSiteLimit) {
+        return true;
+    }
+
+    pthread_mutex_lock(&gArrayStoreSiteLock);
+    u4 idx = findArrayStoreSlot(pc);
+    old = gArrayStoreSites[idx];
+    if (old != NULL ? old->fills < kArrayStoreSiteFills
+                    : gArrayStoreSiteCount < kArrayStoreSiteLimit) {
+        ArrayStoreSite* site = (ArrayStoreSite*) calloc(1, sizeof(ArrayStoreSite));
+        if (site != NULL) {
+            site->pc = pc;
+            site->valueClass[0] = objectClass;
+            site->arrayClass[0] = arrayClass;
+            if (old != NULL) {
+                site->fills = old->fills + 1;
+                site->valueClass[1] = old->valueClass[0];
+                site->arrayClass[1] = old->arrayClass[0];
+            } else {
+                site->fills = 1;
+                gArrayStoreSiteCount++;
+            }
+            ANDROID_MEMBAR_STORE();
+            gArrayStoreSites[idx] = site;
+        }
+    }
+    pthread_mutex_unlock(&gArrayStoreSiteLock);
+    return true;
+}
+
+const ClassDisplay* volatile gClassDisplays[kClassDisplayTableSize];
+
+static pthread_mutex_t gClassDisplayLock = PTHREAD_MUTEX_INITIALIZER;
+static volatile u4 gClassDisplayCount;
+
+/* keep the table at most 3/4 full so probe chains stay short */
+#define kClassDisplayLimit  (kClassDisplayTableSize / 4 * 3)
+static volatile u4 gNextIfaceId;
+
+/*
+ * Store "display" in its class's slot, replacing any older record for the
+ * same class.  Caller holds gClassDisplayLock.
+ */
+static void publishClassDisplayLocked(const ClassDisplay* display)
+{
+    u4 idx = ((uintptr_t) display->clazz >> 3) & (kClassDisplayTableSize - 1);
+    while (gClassDisplays[idx] != NULL
+        && gClassDisplays[idx]->clazz != display->clazz)
+    {
+        idx = (idx + 1) & (kClassDisplayTableSize - 1);
+    }
+    if (gClassDisplays[idx] == NULL) {
+        gClassDisplayCount++;
+    }
+    ANDROID_MEMBAR_STORE();
+    gClassDisplays[idx] = display;
+}
+
+static const ClassDisplay* buildClassDisplayLocked(const ClassObject* clazz);
+
+/*
+ * Set a bit for every interface "clazz" implements that has an id.  The
+ * iftable is already flattened: it lists every interface the class
+ * implements, directly or through its superclasses.  Ids are only handed
+ * out under the lock, so every id below gNextIfaceId is accounted for.
+ */
+static void fillIfaceBitsLocked(ClassDisplay* display, const ClassObject* clazz)
+{
+    memset(display->ifaceBits, 0, sizeof(display->ifaceBits));
+    for (int i = 0; i < clazz->iftableCount; i++) {
+        const ClassDisplay* iface =
+            buildClassDisplayLocked(clazz->iftable[i].clazz);
+        if (iface != NULL && iface->ifaceId != kClassDisplayNoId) {
+            display->ifaceBits[iface->ifaceId >> 5] |= 1U << (iface->ifaceId & 31);
+        }
+    }
+    if (display->ifaceId != kClassDisplayNoId) {
+        display->ifaceBits[display->ifaceId >> 5] |= 1U << (display->ifaceId & 31);
+    }
+    display->ifaceLimit = gNextIfaceId;
+}
+
+/*
+ * Publish a copy of "old" with its bit vector brought up to date, and an
+ * interface id if "assignId" is set and one is left.
+ */
+static const ClassDisplay* rebuildClassDisplayLocked(const ClassDisplay* old,
+    bool assignId)
+{
+    ClassDisplay* display = (ClassDisplay*) malloc(sizeof(ClassDisplay));
+    if (display == NULL) {
+        return old;
+    }
+    memcpy(display, old, sizeof(ClassDisplay));
+    if (assignId && display->ifaceId == kClassDisplayNoId
+        && gNextIfaceId < kClassDisplayIfaceWords * 32)
+    {
+        display->ifaceId = gNextIfaceId++;
+    }
+    fillIfaceBitsLocked(display, old->clazz);
+    publishClassDisplayLocked(display);
+    return display;
+}
+
+/*
+ * Build (or find) the display for "clazz".  Caller holds gClassDisplayLock.
+ * Returns NULL if the class can't be encoded.
+ */
+static const ClassDisplay* buildClassDisplayLocked(const ClassObject* clazz)
+{
+    const ClassDisplay* found = dvmFindClassDisplay(clazz);
+    if (found != NULL) {
+        return found;
+    }
+    if (clazz->arrayDim != 0 || clazz->status < CLASS_RESOLVED) {
+        return NULL;
+    }
+    if (gClassDisplayCount >= kClassDisplayLimit) {
+        return NULL;
+    }
+
+    /* build parents and interfaces first */
+    const ClassDisplay* superDisplay = NULL;
+    if (clazz->super != NULL) {
+        superDisplay = buildClassDisplayLocked(clazz->super);
+        if (superDisplay == NULL) {
+            return NULL;
+        }
+    }
+
+    ClassDisplay* display = (ClassDisplay*) calloc(1, sizeof(ClassDisplay));
+    if (display == NULL) {
+        return NULL;
+    }
+    display->clazz = clazz;
+    if (superDisplay != NULL) {
+        memcpy(display->ancestors, superDisplay->ancestors,
+            sizeof(display->ancestors));
+        display->depth = superDisplay->depth + 1;
+    }
+    if (display->depth < kClassDisplayDepth) {
+        display->ancestors[display->depth] = clazz;
+    }
+    display->isInterface = (clazz->accessFlags & ACC_INTERFACE) != 0;
+    display->ifaceId = kClassDisplayNoId;
+    fillIfaceBitsLocked(display, clazz);
+
+    publishClassDisplayLocked(display);
+    return display;
+}
+
+/*
+ * Does answering "instance instanceof clazz" from the displays need work
+ * under the lock?  Keeps a query that can never be encoded -- ids gone,
+ * table full -- from taking the lock every time.
+ */
+static bool displaysNeedWork(const ClassDisplay* sub, const ClassDisplay* super)
+{
+    if (sub == NULL || super == NULL) {
+        return gClassDisplayCount < kClassDisplayLimit;
+    }
+    if (!super->isInterface) {
+        return false;
+    }
+    if (super->ifaceId == kClassDisplayNoId) {
+        return gNextIfaceId < kClassDisplayIfaceWords * 32;
+    }
+    return super->ifaceId >= sub->ifaceLimit;
+}
+
+/*
+ * Out-of-line half of dvmInstanceof.  Encodes whichever of the two classes
+ * is missing or out of date, then answers this one query the old way.
+ */
+int dvmInstanceofSlow(const ClassObject* instance, const ClassObject* clazz)
+{
+    if (instance->arrayDim == 0 && clazz->arrayDim == 0
+        && displaysNeedWork(dvmFindClassDisplay(instance),
+               dvmFindClassDisplay(clazz)))
+    {
+        pthread_mutex_lock(&gClassDisplayLock);
+        const ClassDisplay* super = buildClassDisplayLocked(clazz);
+        if (super != NULL && super->isInterface
+            && super->ifaceId == kClassDisplayNoId)
+        {
+            super = rebuildClassDisplayLocked(super, true);
+        }
+        const ClassDisplay* sub = buildClassDisplayLocked(instance);
+        if (sub != NULL && super != NULL && super->isInterface
+            && super->ifaceId != kClassDisplayNoId
+            && super->ifaceId >= sub->ifaceLimit)
+        {
+            sub = rebuildClassDisplayLocked(sub, false);
+        }
+        if (sub == NULL || super == NULL) {
+            MY_LOG_VERBOSE("no subtype display for %s / %s",
+                instance->descriptor, clazz->descriptor);
+        }
+        pthread_mutex_unlock(&gClassDisplayLock);
+    }
+    return dvmInstanceofNonTrivialHook(instance, clazz);
+}
@@ -7,15 +7,89 @@
 
 #include "object.h"
 #include <dlfcn.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "atomic-arm.h"
 typedef int (*dvmInstanceofNonTrivial_func)(const ClassObject* instance,const ClassObject* clazz);
 
 extern dvmInstanceofNonTrivial_func dvmInstanceofNonTrivialHook;
+
+/*
+ * Subtype display.  We can't add fields to libdvm's ClassObject, so each
+ * class seen by check-cast / instance-of gets a side record, built the
+ * first time it misses, holding its superclass chain indexed by depth and
+ * a bit per implemented interface.  Then "is A a subclass of B" is
+ * A->ancestors[B->depth] == B, and "does A implement I" is a bit test.
+ *
+ * An interface gets an id the first time it is the target of a query, not
+ * when some class that implements it is built, so the ids go to the
+ * interfaces code actually tests against.  A class's bit vector is exact
+ * for the ids that existed when its record was built (ifaceLimit); a query
+ * past that builds a fresh record.  Once the ids run out, the interfaces
+ * left without one go to dvmInstanceofNonTrivial and everything else stays
+ * fast.  So do deep hierarchies, arrays, and a full table.  Dalvik doesn't
+ * unload classes, so records -- including superseded ones, which a reader
+ * may still hold -- are never freed.
+ */
+#define kClassDisplayDepth      16
+#define kClassDisplayIfaceWords 8               /* 256 interface ids */
+#define kClassDisplayTableSize  8192            /* must be a power of 2 */
+#define kClassDisplayNoId       0xffff
+
+struct ClassDisplay {
+    const ClassObject*  clazz;
+    u2                  depth;          /* 0 for java.lang.Object */
+    u2                  ifaceId;        /* for interfaces; may be kClassDisplayNoId */
+    u2                  ifaceLimit;     /* ifaceBits is exact below this id */
+    bool                isInterface;
+    const ClassObject*  ancestors[kClassDisplayDepth];  /* ancestors[depth] == self */
+    u4                  ifaceBits[kClassDisplayIfaceWords];
+};
+
+extern const ClassDisplay* volatile gClassDisplays[kClassDisplayTableSize];
+
+int dvmInstanceofSlow(const ClassObject* instance, const ClassObject* clazz);
+
+/*
+ * Find the display for "clazz", or NULL if it hasn't been built.  A record
+ * is complete before its pointer is stored and is only reached through
+ * that pointer, so the address dependency orders the loads; no barrier.
+ */
+INLINE const ClassDisplay* dvmFindClassDisplay(const ClassObject* clazz)
+{
+    u4 idx = ((uintptr_t) clazz >> 3) & (kClassDisplayTableSize - 1);
+    for (;;) {
+        const ClassDisplay* display = gClassDisplays[idx];
+        if (display == NULL) {
+            return NULL;
+        }
+        if (display->clazz == clazz) {
+            return display;
+        }
+        idx = (idx + 1) & (kClassDisplayTableSize - 1);
+    }
+}
+
 INLINE int dvmInstanceof(const ClassObject* instance, const ClassObject* clazz)
 {
     if (instance == clazz) {
         return 1;
-    } else
-        return dvmInstanceofNonTrivialHook(instance, clazz);
+    }
+
+    const ClassDisplay* sub = dvmFindClassDisplay(instance);
+    const ClassDisplay* super = dvmFindClassDisplay(clazz);
+    if (sub != NULL && super != NULL) {
+        if (super->isInterface) {
+            u4 id = super->ifaceId;
+            if (id < sub->ifaceLimit) {
+                return (sub->ifaceBits[id >> 5] >> (id & 31)) & 1;
+            }
+        } else if (super->depth < kClassDisplayDepth) {
+            return super->depth <= sub->depth
+                && sub->ancestors[super->depth] == clazz;
+        }
+    }
+    return dvmInstanceofSlow(instance, clazz);
 }
 
 typedef bool (*dvmCanPutArrayElement_func)(const ClassObject* objectClass,
@@ -24,4 +98,66 @@ typedef bool (*dvmCanPutArrayElement_func)(const ClassObject* objectClass,
 extern dvmCanPutArrayElement_func dvmCanPutArrayElementHook;
   bool initTypeCheckFuction(void *dvm_hand,int apilevel);
 
+/*
+ * Per-site cache for the aput-object store check.  Each aput-object
+ * instruction that has passed a check gets its own record, found by its
+ * address, remembering the last two (value class, array class) pairs that
+ * were allowed.  Only successes are cached -- a failed check throws, which
+ * is never the hot path -- and since classes are never unloaded a cached
+ * pair stays valid forever.
+ *
+ * Records are immutable: a new pair publishes a new record in the site's
+ * slot, so readers need no lock or seqlock, just the address dependency
+ * on the slot pointer.  Superseded records can still be in a reader's
+ * hands and are never freed; a site stops learning after
+ * kArrayStoreSiteFills records, which bounds that.
+ */
+#define kArrayStoreSiteCount    4096    /* must be a power of 2 */
+#define kArrayStoreSiteFills    8
+
+struct ArrayStoreSite {
+    const u2*           pc;
+    u4                  fills;
+    const ClassObject*  valueClass[2];  /* [0] is the most recent */
+    const ClassObject*  arrayClass[2];
+};
+
+extern const ArrayStoreSite* volatile gArrayStoreSites[kArrayStoreSiteCount];
+
+bool dvmCanPutArrayElementSlow(const u2* pc,
+    const ClassObject* objectClass, const ClassObject* arrayClass);
+
+/*
+ * Can an object of class "objectClass" be stored into an array of class
+ * "arrayClass"?  "pc" identifies the aput-object instruction.
+ */
+INLINE bool dvmCanPutArrayElementCached(const u2* pc,
+    const ClassObject* objectClass, const ClassObject* arrayClass)
+{
+    /* exact component type of a one-dimensional array */
+    if (arrayClass->arrayDim == 1 && arrayClass->elementClass == objectClass) {
+        return true;
+    }
+
+    u4 idx = ((uintptr_t) pc >> 1) & (kArrayStoreSiteCount - 1);
+    for (;;) {
+        const ArrayStoreSite* site = gArrayStoreSites[idx];
+        if (site == NULL) {
+            break;
+        }
+        if (site->pc == pc) {
+            if ((site->valueClass[0] == objectClass
+                    && site->arrayClass[0] == arrayClass)
+                || (site->valueClass[1] == objectClass
+                    && site->arrayClass[1] == arrayClass))
+            {
+                return true;
+            }
+            break;
+        }
+        idx = (idx + 1) & (kArrayStoreSiteCount - 1);
+    }
+    return dvmCanPutArrayElementSlow(pc, objectClass, arrayClass);
+}
+
 #endif //CUSTOMAPPVMP_TYPECHECK_H
@@ -1,4 +1,15 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "Utils.h"
+#include "SysUtil.h"
+#include "ZipArchive.h"
+#include "log.h"
+
+#define kYcEntryName "assets/classes.yc"
 
 // ���APP�ļ�·����
 char* GetAppPath(JNIEnv* env) {
@@ -46,3 +57,145 @@ _ret:
 
     return cRet;
 }
+
+bool GetPackageName(char* buf, size_t len) {
+    FILE* fp = fopen("/proc/self/cmdline", "r");
+    if (NULL == fp) {
+        return false;
+    }
+    bool bRet = fgets(buf, len, fp) != NULL;
+    fclose(fp);
+    if (bRet) {
+        buf[strcspn(buf, ":")] = '\0';
+        bRet = buf[0] != '\0';
+    }
+    return bRet;
+}
+
+/*
+ * Libraries loaded straight from the APK (extractNativeLibs=false) show up
+ * in dladdr as "/path/base.apk!/lib/<abi>/libnative-lib.so".
+ */
+static char* apkPathFromDladdr() {
+    Dl_info info;
+    if (dladdr((void*) apkPathFromDladdr, &info) == 0 || info.dli_fname == NULL) {
+        return NULL;
+    }
+    const char* sep = strstr(info.dli_fname, ".apk!/");
+    if (sep == NULL) {
+        return NULL;
+    }
+    return strndup(info.dli_fname, sep + 4 - info.dli_fname);
+}
+
+/*
+ * True if a component of "path" is "pkg" followed by '-' or '/', as in
+ * /data/app/<pkg>-1/base.apk.  A plain substring test would also take
+ * com.foo.bar or com.foo2 for com.foo.
+ */
+static bool pathHasPackage(const char* path, const char* pkg) {
+    size_t pkgLen = strlen(pkg);
+    for (const char* p = strchr(path, '/'); p != NULL; p = strchr(p + 1, '/')) {
+        if (strncmp(p + 1, pkg, pkgLen) == 0
+            && (p[1 + pkgLen] == '-' || p[1 + pkgLen] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * The asset manager keeps the APK mapped, so it is normally listed in
+ * /proc/self/maps.  Only app install locations with our package as a
+ * path component are considered: WebView and other apps' APKs are mapped
+ * there too.
+ */
+static char* apkPathFromMaps() {
+    char pkg[256];
+    if (!GetPackageName(pkg, sizeof(pkg)) || pkg[0] == '\0') {
+        return NULL;
+    }
+
+    FILE* fp = fopen("/proc/self/maps", "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    char line[1024];
+    char* found = NULL;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char* path = strchr(line, '/');
+        if (path == NULL) {
+            continue;
+        }
+        path[strcspn(path, "\n")] = '\0';
+
+        size_t len = strlen(path);
+        if (len < 4 || strcmp(path + len - 4, ".apk") != 0) {
+            continue;
+        }
+        if (strncmp(path, "/data/app/", 10) != 0
+            && strncmp(path, "/mnt/asec/", 10) != 0
+            && strncmp(path, "/mnt/expand/", 12) != 0) {
+            continue;
+        }
+        if (pathHasPackage(path, pkg)) {
+            found = strdup(path);
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+char* FindApkPath(JNIEnv* env) {
+    char* path = apkPathFromDladdr();
+    if (NULL == path) {
+        path = apkPathFromMaps();
+    }
+    if (NULL == path) {
+        MY_LOG_INFO("apk not found natively, asking ActivityThread");
+        path = GetAppPath(env);
+    }
+    return path;
+}
+
+bool MapYcFile(const char* apkPath, MemMapping* pMap, u4* pCrc) {
+    memset(pMap, 0, sizeof(*pMap));
+
+    int fd = open(apkPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        MY_LOG_ERROR("open %s failed: %s", apkPath, strerror(errno));
+        return false;
+    }
+
+    bool bRet = false;
+    ZipEntryInfo entry;
+    if (!ycZipFindEntry(fd, kYcEntryName, &entry)) {
+        MY_LOG_ERROR("%s not found in %s", kYcEntryName, apkPath);
+        close(fd);
+        return false;
+    }
+
+    *pCrc = entry.crc32;
+    if (ycZipMapEntry(fd, &entry, pMap)) {
+        MY_LOG_INFO("yc mapped in place from apk (%zu bytes)", pMap->length);
+        bRet = true;
+    } else {
+        /*
+         * Compressed entry: costs a private copy.  Mark the asset as
+         * noCompress in build.gradle to avoid this.
+         */
+        MY_LOG_WARNING("yc entry is compressed (method %u), extracting",
+            entry.method);
+        bRet = ycZipExtractEntry(fd, &entry, pMap);
+    }
+
+    /* the mapping holds its own reference to the file */
+    close(fd);
+    return bRet;
+}
+
+void UnmapYcFile(MemMapping* pMap) {
+    ycZipReleaseMapping(pMap);
+}
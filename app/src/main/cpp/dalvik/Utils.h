@@ -2,6 +2,7 @@
 
 #include <jni.h>
 #include <string.h>
+#include "Common.h"
 /**
  * ���APP�ļ�·����
  * @param[in] env JNI������
@@ -9,3 +10,35 @@
  * @note TODO ���������ʹ���˷�����APP�ļ���·����Ӧ�����м���������ġ�
  */
 char* GetAppPath(JNIEnv* env);
+
+/**
+ * Read our package name from /proc/self/cmdline, without any ":process"
+ * suffix.
+ * @param[out] buf receives the NUL-terminated name.
+ * @return false if it couldn't be read.
+ */
+bool GetPackageName(char* buf, size_t len);
+
+/**
+ * Find the APK this library was loaded from without going through Java.
+ * Checks dladdr() first (libraries loaded straight from the APK), then the
+ * APK mappings in /proc/self/maps, and only then falls back to GetAppPath.
+ * @param[in] env JNI environment, used for the fallback only.
+ * @return APK path, release with free(); NULL if it can't be found.
+ */
+char* FindApkPath(JNIEnv* env);
+
+struct MemMapping;
+
+/**
+ * Map assets/classes.yc from the APK.  A stored entry is mmap'ed in place,
+ * read-only and shared with the page cache; a compressed entry is
+ * extracted into an anonymous mapping.
+ * @param[in] apkPath APK file path.
+ * @param[out] pMap the yc image; release with UnmapYcFile.
+ * @param[out] pCrc crc32 of the entry, from the zip central directory.
+ * @return true on success.
+ */
+bool MapYcFile(const char* apkPath, MemMapping* pMap, u4* pCrc);
+
+void UnmapYcFile(MemMapping* pMap);
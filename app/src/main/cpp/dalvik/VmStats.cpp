@@ -0,0 +1,65 @@
+#include <string.h>
+#include "VmStats.h"
+#include "AdvmpThread.h"
+#include "Globals.h"
+#include "YcFile.h"
+
+static const char* gVmStatNames[kVmStatCount] = {
+    "instructions",
+    "bridgeEntries",
+    "invokes",
+    "nativeCalls",
+    "intrinsicCalls",
+    "exceptionsThrown",
+    "exceptionsCaught",
+    "resolveString",
+    "resolveClass",
+    "resolveMethod",
+    "resolveField",
+    "interfaceCacheHits",
+    "interfaceCacheMisses",
+    "interfaceCacheFills",
+    "interfaceCacheFails",
+    "allocations",
+    "decodedCodeBytes",
+    "threads",
+};
+
+/* counters of exited threads; guarded by the thread list lock */
+static u8 gRetiredStats[kVmStatCount];
+
+static void addThreadStats(AdvmpThread* thread, void* arg)
+{
+    u8* stats = (u8*) arg;
+    for (int i = 0; i < kVmStatCount; i++) {
+        stats[i] += dvmReadCounter64(&thread->stats[i]);
+    }
+    stats[kVmStatThreads]++;
+}
+
+void dvmVmStatsSnapshot(u8* stats)
+{
+    dvmAdvmpLockThreadList();
+    memcpy(stats, gRetiredStats, sizeof(gRetiredStats));
+    dvmAdvmpForEachThreadLocked(addThreadStats, stats);
+    dvmAdvmpUnlockThreadList();
+
+    stats[kVmStatDecodedCodeBytes] = (gAdvmp.ycFile != NULL)
+        ? ycResidentCodeBytes(gAdvmp.ycFile->getCodeSection()) : 0;
+}
+
+const char* dvmVmStatName(int stat)
+{
+    if (stat < 0 || stat >= kVmStatCount) {
+        return NULL;
+    }
+    return gVmStatNames[stat];
+}
+
+void dvmVmStatsThreadExiting(AdvmpThread* thread)
+{
+    for (int i = 0; i < kVmStatCount; i++) {
+        gRetiredStats[i] += thread->stats[i];
+    }
+    gRetiredStats[kVmStatThreads] = 0;
+}
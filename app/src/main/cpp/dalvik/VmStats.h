@@ -0,0 +1,74 @@
+#ifndef CUSTOMAPPVMP_VMSTATS_H
+#define CUSTOMAPPVMP_VMSTATS_H
+
+#include "Common.h"
+#include "Inlines.h"
+
+/*
+ * Runtime counters.  Each thread bumps its own AdvmpThread::stats with
+ * plain increments; a snapshot sums the live threads and the threads
+ * that have exited, so counting never contends.
+ *
+ * Instructions are counted in a register by the interpreter and added
+ * at its periodic checks and on exit, so a running loop's count lags by
+ * up to safepointInterval backward branches.  The last two entries are
+ * gauges, computed when read.
+ */
+enum VmStat {
+    kVmStatInstructions = 0,
+    kVmStatBridgeEntries,           /* interpreter entries from JNI */
+    kVmStatInvokes,
+    kVmStatNativeCalls,
+    kVmStatIntrinsicCalls,
+    kVmStatExceptionsThrown,
+    kVmStatExceptionsCaught,        /* caught in interpreted code */
+    kVmStatResolveString,
+    kVmStatResolveClass,
+    kVmStatResolveMethod,
+    kVmStatResolveField,
+    kVmStatInterfaceCacheHits,
+    kVmStatInterfaceCacheMisses,    /* slot held another interface method */
+    kVmStatInterfaceCacheFills,
+    kVmStatInterfaceCacheFails,     /* lost a race with a cache update */
+    kVmStatAllocations,
+    kVmStatDecodedCodeBytes,        /* gauge: yc code resident */
+    kVmStatThreads,                 /* gauge: live interpreter threads */
+
+    kVmStatCount
+};
+
+struct AdvmpThread;
+
+/*
+ * Read a u8 counter that another thread may be incrementing.  On a
+ * 32-bit CPU the two halves are separate stores, so reread until the
+ * high half is stable.
+ */
+INLINE u8 dvmReadCounter64(const volatile u8* counter)
+{
+    const volatile u4* halves = (const volatile u4*) counter;
+    while (true) {
+        u4 hi = halves[1];
+        u4 lo = halves[0];
+        if (halves[1] == hi) {
+            return ((u8) hi << 32) | lo;
+        }
+    }
+}
+
+/*
+ * Fill "stats" (kVmStatCount entries) with the current totals.
+ */
+void dvmVmStatsSnapshot(u8* stats);
+
+/*
+ * Short name of counter "stat", or NULL if out of range.
+ */
+const char* dvmVmStatName(int stat);
+
+/*
+ * Called by AdvmpThread, with the thread registry locked.
+ */
+void dvmVmStatsThreadExiting(AdvmpThread* thread);
+
+#endif //CUSTOMAPPVMP_VMSTATS_H
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "WorkerPool.h"
+#include "log.h"
+
+#define kMaxWorkerThreads   8
+
+struct WorkItem {
+    WorkFunc    func;
+    void*       arg;
+    WorkGroup*  group;
+    WorkItem*   next;
+};
+
+struct WorkerPool {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    WorkItem*       head;
+    WorkItem*       tail;
+    bool            shutdown;
+    int             threadCount;
+    pthread_t       threads[kMaxWorkerThreads];
+    char            name[16];
+};
+
+void dvmWorkGroupInit(WorkGroup* group)
+{
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->cond, NULL);
+    group->pending = 0;
+}
+
+void dvmWorkGroupDestroy(WorkGroup* group)
+{
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->lock);
+}
+
+void dvmWorkGroupWait(WorkGroup* group)
+{
+    pthread_mutex_lock(&group->lock);
+    while (group->pending != 0) {
+        pthread_cond_wait(&group->cond, &group->lock);
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+static void runItem(WorkFunc func, void* arg, WorkGroup* group)
+{
+    (*func)(arg);
+    if (group != NULL) {
+        pthread_mutex_lock(&group->lock);
+        if (--group->pending == 0) {
+            pthread_cond_broadcast(&group->cond);
+        }
+        pthread_mutex_unlock(&group->lock);
+    }
+}
+
+static void* workerThreadStart(void* arg)
+{
+    WorkerPool* pool = (WorkerPool*) arg;
+
+    prctl(PR_SET_NAME, (unsigned long) pool->name, 0, 0, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->head == NULL && !pool->shutdown) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        WorkItem* item = pool->head;
+        if (item == NULL) {
+            break;      /* shutting down and the queue is drained */
+        }
+        pool->head = item->next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        runItem(item->func, item->arg, item->group);
+        free(item);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+WorkerPool* dvmWorkerPoolCreate(int threadCount, const char* name)
+{
+    if (threadCount < 1) {
+        threadCount = 1;
+    } else if (threadCount > kMaxWorkerThreads) {
+        threadCount = kMaxWorkerThreads;
+    }
+
+    WorkerPool* pool = (WorkerPool*) calloc(1, sizeof(WorkerPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    strncpy(pool->name, name, sizeof(pool->name) - 1);
+
+    for (int i = 0; i < threadCount; i++) {
+        if (pthread_create(&pool->threads[i], NULL, workerThreadStart,
+                pool) != 0)
+        {
+            MY_LOG_WARNING("worker pool '%s': only %d of %d threads started",
+                name, i, threadCount);
+            break;
+        }
+        pool->threadCount++;
+    }
+    if (pool->threadCount == 0) {
+        dvmWorkerPoolDestroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void dvmWorkerPoolDestroy(WorkerPool* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->threadCount; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+void dvmWorkerPoolSubmit(WorkerPool* pool, WorkGroup* group,
+    WorkFunc func, void* arg)
+{
+    if (group != NULL) {
+        pthread_mutex_lock(&group->lock);
+        group->pending++;
+        pthread_mutex_unlock(&group->lock);
+    }
+
+    WorkItem* item = NULL;
+    if (pool != NULL) {
+        item = (WorkItem*) malloc(sizeof(WorkItem));
+    }
+    if (item == NULL) {
+        runItem(func, arg, group);
+        return;
+    }
+    item->func = func;
+    item->arg = arg;
+    item->group = group;
+    item->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail != NULL) {
+        pool->tail->next = item;
+    } else {
+        pool->head = item;
+    }
+    pool->tail = item;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int dvmGetCpuCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count < 1 ? 1 : (int) count;
+}
+
+static pthread_once_t gSharedPoolOnce = PTHREAD_ONCE_INIT;
+static WorkerPool* gSharedPool;
+
+static void createSharedPool()
+{
+    gSharedPool = dvmWorkerPoolCreate(dvmGetCpuCount(), "avmp-worker");
+}
+
+WorkerPool* dvmGetSharedWorkerPool()
+{
+    pthread_once(&gSharedPoolOnce, createSharedPool);
+    return gSharedPool;
+}
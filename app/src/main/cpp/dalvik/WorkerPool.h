@@ -0,0 +1,54 @@
+#ifndef CUSTOMAPPVMP_WORKERPOOL_H
+#define CUSTOMAPPVMP_WORKERPOOL_H
+
+#include <pthread.h>
+
+/*
+ * Small fixed-size pthread pool for load-time work (chunk inflation, cache
+ * rebuilds, hashing).  Work items run in FIFO order on whichever worker is
+ * free.  Items that need to be waited on are tagged with a WorkGroup.
+ */
+typedef void (*WorkFunc)(void* arg);
+
+struct WorkGroup {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             pending;
+};
+
+struct WorkerPool;
+
+void dvmWorkGroupInit(WorkGroup* group);
+void dvmWorkGroupDestroy(WorkGroup* group);
+
+/*
+ * Block until every item submitted with "group" has finished.
+ */
+void dvmWorkGroupWait(WorkGroup* group);
+
+WorkerPool* dvmWorkerPoolCreate(int threadCount, const char* name);
+
+/*
+ * Finish queued work, then join and free the workers.
+ */
+void dvmWorkerPoolDestroy(WorkerPool* pool);
+
+/*
+ * Queue "func(arg)".  "group" may be NULL for fire-and-forget work.  If
+ * the item can't be queued it is run on the calling thread, so callers
+ * never have to handle failure.
+ */
+void dvmWorkerPoolSubmit(WorkerPool* pool, WorkGroup* group,
+    WorkFunc func, void* arg);
+
+/*
+ * Number of online CPUs (at least 1).
+ */
+int dvmGetCpuCount();
+
+/*
+ * Process-wide pool, created on first use with one worker per CPU.
+ */
+WorkerPool* dvmGetSharedWorkerPool();
+
+#endif //CUSTOMAPPVMP_WORKERPOOL_H
@@ -7,9 +7,16 @@
 
 #include "object.h"
 #include "CardTable.h"
+
+/*
+ * The barriers dirty the card of the object's header, as libdvm's do:
+ * the concurrent GC finds gray objects by the cards their headers are on,
+ * so that is the card that has to be dirty even when the store landed
+ * further into the object.
+ */
 INLINE void dvmWriteBarrierField(const Object *obj, void *addr)
 {
-    dvmMarkCardHook(obj);
+    dvmMarkCardInline(obj);
 }
 
 /*
@@ -17,7 +24,7 @@ INLINE void dvmWriteBarrierField(const Object *obj, void *addr)
  */
 INLINE void dvmWriteBarrierObject(const Object *obj)
 {
-    dvmMarkCardHook(obj);
+    dvmMarkCardInline(obj);
 }
 
 /*
@@ -28,6 +35,6 @@ INLINE void dvmWriteBarrierObject(const Object *obj)
 INLINE void dvmWriteBarrierArray(const ArrayObject *obj,
                                  size_t start, size_t end)
 {
-    dvmMarkCardHook((Object *)obj);
+    dvmMarkCardInline(obj);
 }
 #endif //CUSTOMAPPVMP_WRITEBARRIER_H
@@ -0,0 +1,388 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "YcCache.h"
+#include "YcFile.h"
+#include "Utils.h"
+#include "log.h"
+
+#define kCacheFileName      "avmp-classes.yc.cache"
+#define kCodeAlignment      4096
+#define kCacheChunkSize     (4 * kCodeAlignment)
+
+/* Android multi-user: uid = userId * AID_USER + appId */
+#define AID_USER            100000
+
+/*
+ * Changes whenever the library is rebuilt, so a cache written by an older
+ * runtime is never picked up by a newer one.
+ */
+static const char kBuildStamp[] = __DATE__ " " __TIME__;
+
+static bool getCachePath(char* buf, size_t len)
+{
+    char pkg[256];
+    if (!GetPackageName(pkg, sizeof(pkg))) {
+        return false;
+    }
+
+    char dir[512];
+    int userId = getuid() / AID_USER;
+    if (userId == 0) {
+        snprintf(dir, sizeof(dir), "/data/data/%s/code_cache", pkg);
+    } else {
+        snprintf(dir, sizeof(dir), "/data/user/%d/%s/code_cache", userId, pkg);
+    }
+
+    /* code_cache only exists from API 21 on */
+    if (mkdir(dir, 0711) != 0 && errno != EEXIST) {
+        MY_LOG_WARNING("can't create %s: %s", dir, strerror(errno));
+        return false;
+    }
+    snprintf(buf, len, "%s/%s", dir, kCacheFileName);
+    return true;
+}
+
+static u4 cacheChecksum(const u1* data, size_t len)
+{
+    return (u4) adler32(adler32(0L, Z_NULL, 0), data, len);
+}
+
+void ycCacheMakeKey(YcCacheKey* pKey, u4 ycCrc, u4 ycSize)
+{
+    memset(pKey, 0, sizeof(*pKey));
+    pKey->ycCrc = ycCrc;
+    pKey->ycSize = ycSize;
+    pKey->runtimeVersion = YC_CACHE_VERSION
+        ^ cacheChecksum((const u1*) kBuildStamp, sizeof(kBuildStamp));
+    pKey->cpuFeatures = (u4) getauxval(AT_HWCAP) ^ (sizeof(void*) << 28);
+}
+
+bool ycCacheOpen(const YcCacheKey* pKey, MemMapping* pMap)
+{
+    memset(pMap, 0, sizeof(*pMap));
+
+    char path[PATH_MAX];
+    if (!getCachePath(path, sizeof(path))) {
+        return false;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            MY_LOG_WARNING("open %s failed: %s", path, strerror(errno));
+        }
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(YcCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t fileSize = (size_t) st.st_size;
+    void* addr = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    const u1* base = (const u1*) addr;
+    const YcCacheHeader* hdr = (const YcCacheHeader*) base;
+    const char* why = NULL;
+    if (memcmp(hdr->magic, YC_CACHE_MAGIC, sizeof(YC_CACHE_MAGIC)) != 0
+        || hdr->headerSize != sizeof(YcCacheHeader))
+    {
+        why = "bad header";
+    } else if (memcmp(&hdr->key, pKey, sizeof(*pKey)) != 0) {
+        why = "stale";
+    } else if (hdr->fileSize != fileSize
+        || hdr->methodsOff > fileSize
+        || (fileSize - hdr->methodsOff) / sizeof(YcCacheMethod)
+            < hdr->methodCount
+        || hdr->chunksOff > fileSize
+        || (fileSize - hdr->chunksOff) / sizeof(u4) < hdr->chunkCount
+        || (hdr->chunksOff & 3) != 0 || hdr->chunkSize == 0
+        || hdr->chunkCount
+            != (u4) (((u8) hdr->codeSize + hdr->chunkSize - 1) / hdr->chunkSize)
+        || hdr->shortiesOff > fileSize
+        || fileSize - hdr->shortiesOff < hdr->shortiesSize
+        || hdr->codeOff > fileSize
+        || fileSize - hdr->codeOff < hdr->codeSize
+        || (hdr->methodsOff & 3) != 0 || (hdr->codeOff & 1) != 0)
+    {
+        why = "bad layout";
+    } else if (hdr->codeOff < hdr->headerSize
+        || cacheChecksum(base + hdr->headerSize,
+            hdr->codeOff - hdr->headerSize) != hdr->checksum)
+    {
+        why = "checksum mismatch";
+    }
+    if (why != NULL) {
+        MY_LOG_INFO("ignoring yc cache %s: %s", path, why);
+        munmap(addr, fileSize);
+        return false;
+    }
+
+    pMap->baseAddr = pMap->addr = addr;
+    pMap->baseLength = pMap->length = fileSize;
+    return true;
+}
+
+bool ycCacheAttach(YcFile* file, const MemMapping* pMap)
+{
+    const u1* base = (const u1*) pMap->addr;
+    const YcCacheHeader* hdr = (const YcCacheHeader*) base;
+    const YcCacheMethod* methods =
+        (const YcCacheMethod*) (base + hdr->methodsOff);
+
+    SeparatorData* sds = (SeparatorData*) calloc(
+        hdr->methodCount ? hdr->methodCount : 1, sizeof(SeparatorData));
+    if (sds == NULL) {
+        return false;
+    }
+
+    for (u4 i = 0; i < hdr->methodCount; i++) {
+        const YcCacheMethod* m = &methods[i];
+        if (m->shortyOff > hdr->shortiesSize
+            || hdr->shortiesSize - m->shortyOff < m->shortyLen
+            || (m->codeOff & 1) != 0 || m->codeOff > hdr->codeSize
+            || (hdr->codeSize - m->codeOff) / sizeof(u2) < m->insnsSize)
+        {
+            MY_LOG_WARNING("yc cache method %u out of range", i);
+            free(sds);
+            return false;
+        }
+
+        SeparatorData* sd = &sds[i];
+        sd->methodIndex = m->methodIndex;
+        sd->accessFlag = m->accessFlag;
+        sd->paramSize = m->paramSize;
+        sd->registerSize = m->registerSize;
+        sd->shortyLen = m->shortyLen;
+        sd->shorty = (const char*) (base + hdr->shortiesOff + m->shortyOff);
+        sd->insnsSize = m->insnsSize;
+        sd->codeOff = m->codeOff;
+    }
+
+    if (!file->attach(sds, hdr->methodCount, base + hdr->codeOff,
+            hdr->codeSize, (const u4*) (base + hdr->chunksOff),
+            hdr->chunkSize, hdr->chunkCount))
+    {
+        return false;
+    }
+    MY_LOG_INFO("yc loaded from cache: %u methods, %u code bytes",
+        hdr->methodCount, hdr->codeSize);
+    return true;
+}
+
+void ycCacheRelease(MemMapping* pMap)
+{
+    if (pMap->baseAddr != NULL) {
+        munmap(pMap->baseAddr, pMap->baseLength);
+    }
+    memset(pMap, 0, sizeof(*pMap));
+}
+
+/*
+ * Writer that keeps a running checksum of everything it writes.
+ */
+struct CacheWriter {
+    int     fd;
+    uLong   adler;
+    bool    failed;
+};
+
+static void writeBytes(CacheWriter* writer, const void* data, size_t len)
+{
+    const u1* ptr = (const u1*) data;
+    writer->adler = adler32(writer->adler, ptr, len);
+    while (len != 0 && !writer->failed) {
+        ssize_t actual = write(writer->fd, ptr, len);
+        if (actual < 0 && errno == EINTR) {
+            continue;
+        }
+        if (actual <= 0) {
+            writer->failed = true;
+            break;
+        }
+        ptr += actual;
+        len -= actual;
+    }
+}
+
+static void writePadding(CacheWriter* writer, size_t len)
+{
+    static const u1 kZeroes[256] = { 0 };
+    while (len != 0) {
+        size_t count = len < sizeof(kZeroes) ? len : sizeof(kZeroes);
+        writeBytes(writer, kZeroes, count);
+        len -= count;
+    }
+}
+
+static bool writeCacheFile(YcFile* file, const YcCacheKey* pKey)
+{
+    char path[PATH_MAX];
+    char tmpPath[PATH_MAX + 16];
+    if (!getCachePath(path, sizeof(path))) {
+        return false;
+    }
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d", path, getpid());
+
+    /* the cached copy must be fully inflated */
+    YcCodeSection* code = file->getCodeSection();
+    for (u4 i = 0; i < code->chunkCount; i++) {
+        if (!ycEnsureChunk(code, i)) {
+            return false;
+        }
+    }
+
+    u4 count = file->getSeparatorCount();
+    u4 shortiesSize = 0;
+    for (u4 i = 0; i < count; i++) {
+        shortiesSize += file->getSeparatorData(i)->shortyLen + 1;
+    }
+
+    YcCacheHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, YC_CACHE_MAGIC, sizeof(YC_CACHE_MAGIC));
+    hdr.headerSize = sizeof(YcCacheHeader);
+    hdr.key = *pKey;
+    hdr.methodCount = count;
+    hdr.methodsOff = sizeof(YcCacheHeader);
+    hdr.chunksOff = hdr.methodsOff + count * sizeof(YcCacheMethod);
+    hdr.chunkSize = kCacheChunkSize;
+    hdr.chunkCount = (u4) ((code->rawSize + kCacheChunkSize - 1)
+        / kCacheChunkSize);
+    hdr.shortiesOff = hdr.chunksOff + hdr.chunkCount * sizeof(u4);
+    hdr.shortiesSize = shortiesSize;
+    hdr.codeOff = (hdr.shortiesOff + shortiesSize + kCodeAlignment - 1)
+        & ~(kCodeAlignment - 1);
+    hdr.codeSize = code->rawSize;
+    hdr.fileSize = hdr.codeOff + hdr.codeSize;
+
+    CacheWriter writer;
+    writer.fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    writer.adler = adler32(0L, Z_NULL, 0);
+    writer.failed = false;
+    if (writer.fd < 0) {
+        MY_LOG_WARNING("create %s failed: %s", tmpPath, strerror(errno));
+        return false;
+    }
+
+    /* header is rewritten once the checksum is known */
+    if (write(writer.fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr)) {
+        writer.failed = true;
+    }
+
+    u4 shortyOff = 0;
+    for (u4 i = 0; i < count; i++) {
+        const SeparatorData* sd = file->getSeparatorData(i);
+        YcCacheMethod m;
+        m.methodIndex = sd->methodIndex;
+        m.accessFlag = sd->accessFlag;
+        m.paramSize = sd->paramSize;
+        m.registerSize = sd->registerSize;
+        m.shortyOff = shortyOff;
+        m.shortyLen = sd->shortyLen;
+        m.insnsSize = sd->insnsSize;
+        m.codeOff = sd->codeOff;
+        writeBytes(&writer, &m, sizeof(m));
+        shortyOff += sd->shortyLen + 1;
+    }
+    for (u4 i = 0; i < hdr.chunkCount; i++) {
+        size_t start = (size_t) i * kCacheChunkSize;
+        size_t len = code->rawSize - start;
+        if (len > kCacheChunkSize) {
+            len = kCacheChunkSize;
+        }
+        u4 checksum = ycChecksum(code->raw + start, len);
+        writeBytes(&writer, &checksum, sizeof(checksum));
+    }
+    for (u4 i = 0; i < count; i++) {
+        const SeparatorData* sd = file->getSeparatorData(i);
+        writeBytes(&writer, sd->shorty, sd->shortyLen);
+        writePadding(&writer, 1);
+    }
+    writePadding(&writer, hdr.codeOff - hdr.shortiesOff - shortiesSize);
+    hdr.checksum = (u4) writer.adler;       /* the code isn't summed */
+    writeBytes(&writer, code->raw, code->rawSize);
+
+    if (!writer.failed
+        && (pwrite(writer.fd, &hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)
+            || fsync(writer.fd) != 0))
+    {
+        writer.failed = true;
+    }
+    close(writer.fd);
+
+    if (writer.failed || rename(tmpPath, path) != 0) {
+        MY_LOG_WARNING("writing yc cache failed: %s", strerror(errno));
+        unlink(tmpPath);
+        return false;
+    }
+    MY_LOG_INFO("yc cache written: %s (%u bytes)", path, hdr.fileSize);
+    return true;
+}
+
+struct RebuildArgs {
+    YcFile*     file;
+    YcCacheKey  key;
+};
+
+static void rebuildCache(void* arg)
+{
+    RebuildArgs* args = (RebuildArgs*) arg;
+    writeCacheFile(args->file, &args->key);
+    free(args);
+}
+
+void ycCacheRebuildAsync(YcFile* file, const YcCacheKey* pKey,
+    WorkerPool* pool)
+{
+    RebuildArgs* args = (RebuildArgs*) malloc(sizeof(RebuildArgs));
+    if (args == NULL) {
+        return;
+    }
+    args->file = file;
+    args->key = *pKey;
+    dvmWorkerPoolSubmit(pool, NULL, rebuildCache, args);
+}
+
+struct ImageRebuildArgs {
+    const u1*   data;
+    size_t      size;
+    YcCacheKey  key;
+};
+
+static void rebuildCacheFromImage(void* arg)
+{
+    ImageRebuildArgs* args = (ImageRebuildArgs*) arg;
+    YcFile* file = new YcFile;
+    if (file->parse(args->data, args->size)) {
+        writeCacheFile(file, &args->key);
+    }
+    delete file;
+    free(args);
+}
+
+void ycCacheRebuildFromImageAsync(const u1* data, size_t size,
+    const YcCacheKey* pKey, WorkerPool* pool)
+{
+    ImageRebuildArgs* args = (ImageRebuildArgs*) malloc(sizeof(ImageRebuildArgs));
+    if (args == NULL) {
+        return;
+    }
+    args->data = data;
+    args->size = size;
+    args->key = *pKey;
+    dvmWorkerPoolSubmit(pool, NULL, rebuildCacheFromImage, args);
+}
@@ -0,0 +1,105 @@
+#ifndef CUSTOMAPPVMP_YCCACHE_H
+#define CUSTOMAPPVMP_YCCACHE_H
+
+#include "Common.h"
+#include "SysUtil.h"
+#include "WorkerPool.h"
+
+class YcFile;
+
+/*
+ * Persistent cache of prepared yc code, kept in the app's code_cache
+ * directory.  It holds the method table and the fully inflated code
+ * section, laid out so that the file can be mapped read-only and used in
+ * place; a warm start then skips chunk inflation, checksumming and record
+ * parsing entirely.
+ *
+ * Layout:
+ *
+ *   YcCacheHeader
+ *   YcCacheMethod[methodCount]
+ *   u4 chunk checksums[chunkCount]
+ *   shorty pool (NUL-terminated strings)
+ *   padding to a page boundary
+ *   code section
+ *
+ * The file is only trusted if every field of YcCacheKey matches and the
+ * adler32 over the method table, chunk checksums and shorty pool is
+ * intact.  Anything else is treated as stale and the file is rewritten in
+ * the background.  The code section isn't summed up front, which would
+ * fault in every page at startup: each chunkSize piece is checked against
+ * its checksum the first time a method in it is used, whether or not the
+ * yc has digests.  A failure there also gets the file rewritten.
+ */
+
+#define YC_CACHE_MAGIC      "yccache"
+#define YC_CACHE_VERSION    3
+
+struct YcCacheKey {
+    u4  ycCrc;                  /* crc32 of classes.yc, from the zip */
+    u4  ycSize;
+    u4  runtimeVersion;         /* YC_CACHE_VERSION + library build stamp */
+    u4  cpuFeatures;            /* AT_HWCAP, plus pointer size */
+};
+
+struct YcCacheHeader {
+    char        magic[8];
+    u4          headerSize;
+    YcCacheKey  key;
+    u4          methodCount;
+    u4          methodsOff;
+    u4          shortiesOff;
+    u4          shortiesSize;
+    u4          chunksOff;
+    u4          chunkSize;
+    u4          chunkCount;
+    u4          codeOff;        /* page aligned */
+    u4          codeSize;
+    u4          fileSize;
+    u4          checksum;       /* adler32 of [headerSize, codeOff) */
+};
+
+struct YcCacheMethod {
+    u4  methodIndex;
+    u4  accessFlag;
+    u4  paramSize;
+    u4  registerSize;
+    u4  shortyOff;              /* relative to shortiesOff */
+    u4  shortyLen;
+    u4  insnsSize;
+    u4  codeOff;                /* relative to codeOff */
+};
+
+void ycCacheMakeKey(YcCacheKey* pKey, u4 ycCrc, u4 ycSize);
+
+/*
+ * Map and validate the cache file for "key".  On success the mapping is
+ * returned in pMap and the caller hands it to ycCacheAttach.
+ */
+bool ycCacheOpen(const YcCacheKey* pKey, MemMapping* pMap);
+
+/*
+ * Point "file" at the methods and code held in a validated cache mapping.
+ * The mapping must outlive the YcFile.
+ */
+bool ycCacheAttach(YcFile* file, const MemMapping* pMap);
+
+/*
+ * Write a fresh cache for "file" on "pool".  The file is written under a
+ * temporary name and renamed into place, so readers never see a partial
+ * cache.  "file" must stay alive until the task runs.
+ */
+void ycCacheRebuildAsync(YcFile* file, const YcCacheKey* pKey,
+    WorkerPool* pool);
+
+/*
+ * Same, for when the cache turned out to be corrupt after it was
+ * attached: the task parses the yc image ("data" must stay mapped) into a
+ * YcFile of its own and writes the cache from that.
+ */
+void ycCacheRebuildFromImageAsync(const u1* data, size_t size,
+    const YcCacheKey* pKey, WorkerPool* pool);
+
+void ycCacheRelease(MemMapping* pMap);
+
+#endif //CUSTOMAPPVMP_YCCACHE_H
@@ -0,0 +1,51 @@
+#include <string.h>
+#include <zlib.h>
+#include "YcCodec.h"
+#include "log.h"
+
+static bool storedDecompress(const u1* src, size_t srcSize,
+    u1* dst, size_t dstSize)
+{
+    if (srcSize != dstSize) {
+        return false;
+    }
+    memcpy(dst, src, dstSize);
+    return true;
+}
+
+static bool zlibDecompress(const u1* src, size_t srcSize,
+    u1* dst, size_t dstSize)
+{
+    uLongf destLen = dstSize;
+    int ret = uncompress(dst, &destLen, src, srcSize);
+    if (ret != Z_OK) {
+        MY_LOG_WARNING("zlib chunk inflate failed: %d", ret);
+        return false;
+    }
+    return destLen == dstSize;
+}
+
+/*
+ * Codec table.  LZ4 and zstd get an entry here once the libraries are
+ * linked into native-lib; until then chunk directories that name them are
+ * rejected at parse time.
+ */
+static const YcCodec gYcCodecTable[] = {
+    { kYcCodecStored,   "stored",   storedDecompress },
+    { kYcCodecZlib,     "zlib",     zlibDecompress },
+};
+
+const YcCodec* ycFindCodec(u2 id)
+{
+    for (size_t i = 0; i < array_size(gYcCodecTable); i++) {
+        if (gYcCodecTable[i].id == id) {
+            return &gYcCodecTable[i];
+        }
+    }
+    return NULL;
+}
+
+u4 ycChecksum(const u1* data, size_t len)
+{
+    return (u4) adler32(adler32(0L, Z_NULL, 0), data, len);
+}
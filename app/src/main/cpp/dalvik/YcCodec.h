@@ -0,0 +1,42 @@
+#ifndef CUSTOMAPPVMP_YCCODEC_H
+#define CUSTOMAPPVMP_YCCODEC_H
+
+#include <stddef.h>
+#include "Common.h"
+
+/*
+ * Codecs usable for yc code chunks.  The id is stored in the chunk
+ * directory, so values must never be reused.
+ */
+enum YcCodecId {
+    kYcCodecStored  = 0,        /* chunk is stored uncompressed */
+    kYcCodecZlib    = 1,        /* zlib stream (deflate + adler32) */
+    kYcCodecLz4     = 2,        /* reserved, not built in yet */
+    kYcCodecZstd    = 3,        /* reserved, not built in yet */
+};
+
+/*
+ * Decompress exactly "dstSize" bytes from "src" into "dst".  Returns false
+ * if the input is corrupt or does not expand to exactly dstSize bytes.
+ * Must be safe to call from several threads at once.
+ */
+typedef bool (*YcDecompress_func)(const u1* src, size_t srcSize,
+    u1* dst, size_t dstSize);
+
+struct YcCodec {
+    u2                  id;
+    const char*         name;
+    YcDecompress_func   decompress;
+};
+
+/*
+ * Look up a codec by id.  Returns NULL if the codec isn't compiled in.
+ */
+const YcCodec* ycFindCodec(u2 id);
+
+/*
+ * adler32 of "len" bytes, as stored in YcChunkEntry.checksum.
+ */
+u4 ycChecksum(const u1* data, size_t len);
+
+#endif //CUSTOMAPPVMP_YCCODEC_H
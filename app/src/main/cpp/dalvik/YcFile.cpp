@@ -0,0 +1,475 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "YcFile.h"
+#include "PerfMap.h"
+#include "Startup.h"
+#include "atomic-arm.h"
+#include "log.h"
+
+/* fixed part of a SeparatorData record: methodIndex..registerSize */
+#define kSeparatorFixedSize     (5 * sizeof(u4))
+
+#define HEADER_U4(_data, _field) \
+    ycReadU4((_data) + offsetof(YcHeader, _field))
+#define CHUNK_DIR_U4(_ptr, _field) \
+    ycReadU4((_ptr) + offsetof(YcChunkDirectoryHeader, _field))
+#define CHUNK_ENTRY_U4(_ptr, _field) \
+    ycReadU4((_ptr) + offsetof(YcChunkEntry, _field))
+
+static u1* allocCodeSection(size_t rawSize, size_t* pMapSize)
+{
+    size_t pageSize = (size_t) getpagesize();
+    size_t mapSize = (rawSize + pageSize - 1) & ~(pageSize - 1);
+    if (mapSize == 0) {
+        mapSize = pageSize;
+    }
+    void* addr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        MY_LOG_ERROR("unable to reserve %zu bytes for yc code", mapSize);
+        return NULL;
+    }
+    dvmNameAnonRegion(addr, mapSize, "advmp-yc-code");
+    *pMapSize = mapSize;
+    return (u1*) addr;
+}
+
+YcFile::YcFile()
+    : mData(NULL), mSize(0), mSeparatorCount(0), mSeparatorDatas(NULL),
+      mOnCorrupt(NULL), mCorruptReported(0)
+{
+    memset(&mCode, 0, sizeof(mCode));
+    pthread_mutex_init(&mCode.lock, NULL);
+    pthread_cond_init(&mCode.cond, NULL);
+    dvmWorkGroupInit(&mCode.prefetchGroup);
+    ycInitDigests(&mDigests);
+}
+
+YcFile::~YcFile()
+{
+    /* prefetch and hashing tasks hold pointers into this object */
+    ycWaitForPrefetch(&mCode);
+    ycFreeDigests(&mDigests);
+
+    if (mCode.raw != NULL && mCode.mapSize != 0) {
+        munmap(mCode.raw, mCode.mapSize);
+    }
+    free(mCode.chunks);
+    free((void*) mCode.chunkState);
+    dvmWorkGroupDestroy(&mCode.prefetchGroup);
+    pthread_cond_destroy(&mCode.cond);
+    pthread_mutex_destroy(&mCode.lock);
+    free(mSeparatorDatas);
+}
+
+bool YcFile::parse(const u1* data, size_t size)
+{
+    if (data == NULL || size < sizeof(YcHeader)) {
+        MY_LOG_ERROR("yc file too small (%zu bytes)", size);
+        return false;
+    }
+
+    bool chunked;
+    if (memcmp(data, YC_MAGIC_V0, YC_MAGIC_SIZE) == 0) {
+        chunked = false;
+    } else if (memcmp(data, YC_MAGIC_V1, YC_MAGIC_SIZE) == 0) {
+        chunked = true;
+    } else {
+        MY_LOG_ERROR("bad yc magic");
+        return false;
+    }
+
+    mData = data;
+    mSize = size;
+
+    if (chunked) {
+        u4 chunkDirOff = HEADER_U4(data, chunkDirOff);
+        if (chunkDirOff == 0 || !parseChunkDirectory(chunkDirOff)) {
+            return false;
+        }
+    }
+    return parseSeparatorDatas(!chunked) && loadDigests(data, size);
+}
+
+bool YcFile::loadDigests(const u1* data, size_t size)
+{
+    if (size < sizeof(YcHeader)) {
+        return false;
+    }
+    return ycLoadDigests(&mDigests, data, size, HEADER_U4(data, digestOff),
+        mSeparatorCount);
+}
+
+bool YcFile::parseChunkDirectory(u4 offset)
+{
+    if (offset > mSize || mSize - offset < sizeof(YcChunkDirectoryHeader)) {
+        MY_LOG_ERROR("yc chunk directory out of range");
+        return false;
+    }
+    const u1* ptr = mData + offset;
+    if (CHUNK_DIR_U4(ptr, magic) != YC_CHUNK_DIR_MAGIC) {
+        MY_LOG_ERROR("bad yc chunk directory magic");
+        return false;
+    }
+
+    u2 codecId = ycReadU2(ptr + offsetof(YcChunkDirectoryHeader, codec));
+    u4 chunkSize = CHUNK_DIR_U4(ptr, chunkSize);
+    u4 chunkCount = CHUNK_DIR_U4(ptr, chunkCount);
+    u4 rawSize = CHUNK_DIR_U4(ptr, rawSize);
+
+    const YcCodec* codec = ycFindCodec(codecId);
+    if (codec == NULL) {
+        MY_LOG_ERROR("yc code compressed with unsupported codec %u", codecId);
+        return false;
+    }
+    if (chunkSize < YC_MIN_CHUNK_SIZE || chunkSize > YC_MAX_CHUNK_SIZE) {
+        MY_LOG_ERROR("bad yc chunk size %u", chunkSize);
+        return false;
+    }
+    if (chunkCount != (u4) (((u8) rawSize + chunkSize - 1) / chunkSize)) {
+        MY_LOG_ERROR("yc chunk count %u doesn't cover %u bytes",
+            chunkCount, rawSize);
+        return false;
+    }
+
+    size_t dirSize = sizeof(YcChunkDirectoryHeader)
+        + (size_t) chunkCount * sizeof(YcChunkEntry);
+    if (mSize - offset < dirSize) {
+        MY_LOG_ERROR("yc chunk directory truncated");
+        return false;
+    }
+
+    mCode.chunks = (YcChunk*) calloc(chunkCount ? chunkCount : 1,
+        sizeof(YcChunk));
+    mCode.chunkState = (volatile int32_t*) calloc(chunkCount ? chunkCount : 1,
+        sizeof(int32_t));
+    if (mCode.chunks == NULL || mCode.chunkState == NULL) {
+        return false;
+    }
+
+    const u1* entry = ptr + sizeof(YcChunkDirectoryHeader);
+    for (u4 i = 0; i < chunkCount; i++, entry += sizeof(YcChunkEntry)) {
+        YcChunk* chunk = &mCode.chunks[i];
+        chunk->offset = CHUNK_ENTRY_U4(entry, offset);
+        chunk->compressedSize = CHUNK_ENTRY_U4(entry, compressedSize);
+        chunk->checksum = CHUNK_ENTRY_U4(entry, checksum);
+        chunk->rawSize = (i == chunkCount - 1)
+            ? rawSize - i * chunkSize : chunkSize;
+
+        if (chunk->offset > mSize
+            || mSize - chunk->offset < chunk->compressedSize)
+        {
+            MY_LOG_ERROR("yc chunk %u out of range", i);
+            return false;
+        }
+    }
+
+    mCode.raw = allocCodeSection(rawSize, &mCode.mapSize);
+    if (mCode.raw == NULL) {
+        return false;
+    }
+    mCode.rawSize = rawSize;
+    mCode.fileBase = mData;
+    mCode.codec = codec;
+    mCode.chunkSize = chunkSize;
+    mCode.chunkCount = chunkCount;
+
+    MY_LOG_INFO("yc code: %u bytes in %u %s chunks of %u",
+        rawSize, chunkCount, codec->name, chunkSize);
+    return true;
+}
+
+/*
+ * Walk the SeparatorData records.  For version 0000 files the
+ * instructions are inline and are copied into an aligned, fully resident
+ * code section (no chunks); for chunked files each record just names its
+ * range in the code section.
+ */
+bool YcFile::parseSeparatorDatas(bool inlineCode)
+{
+    u4 count = HEADER_U4(mData, separatorDatasSize);
+    u4 offset = HEADER_U4(mData, separatorDatasOff);
+
+    mSeparatorDatas = (SeparatorData*) calloc(count ? count : 1,
+        sizeof(SeparatorData));
+    u4* inlineOffs = NULL;
+    if (inlineCode) {
+        inlineOffs = (u4*) calloc(count ? count : 1, sizeof(u4));
+    }
+    if (mSeparatorDatas == NULL || (inlineCode && inlineOffs == NULL)) {
+        free(inlineOffs);
+        return false;
+    }
+
+    size_t codeSize = 0;
+    size_t pos = offset;
+    for (u4 i = 0; i < count; i++) {
+        SeparatorData* sd = &mSeparatorDatas[i];
+        size_t start = pos;
+
+        if (pos > mSize || mSize - pos < kSeparatorFixedSize + sizeof(u4)) {
+            goto truncated;
+        }
+        sd->methodIndex = ycReadU4(mData + pos);
+        sd->size = ycReadU4(mData + pos + 4);
+        sd->accessFlag = ycReadU4(mData + pos + 8);
+        sd->paramSize = ycReadU4(mData + pos + 12);
+        sd->registerSize = ycReadU4(mData + pos + 16);
+        pos += kSeparatorFixedSize;
+
+        sd->shortyLen = ycReadU4(mData + pos);
+        pos += sizeof(u4);
+        if (mSize - pos < (size_t) sd->shortyLen + sizeof(u4)) {
+            goto truncated;
+        }
+        sd->shorty = (const char*) (mData + pos);
+        pos += sd->shortyLen;
+
+        sd->insnsSize = ycReadU4(mData + pos);
+        pos += sizeof(u4);
+
+        if (inlineCode) {
+            if (mSize - pos < (size_t) sd->insnsSize * sizeof(u2)) {
+                goto truncated;
+            }
+            inlineOffs[i] = pos;
+            sd->codeOff = codeSize;
+            codeSize += (size_t) sd->insnsSize * sizeof(u2);
+            pos += (size_t) sd->insnsSize * sizeof(u2);
+        } else {
+            if (mSize - pos < sizeof(u4)) {
+                goto truncated;
+            }
+            sd->codeOff = ycReadU4(mData + pos);
+            pos += sizeof(u4);
+            if ((sd->codeOff & 1) != 0 || sd->codeOff > mCode.rawSize
+                || mCode.rawSize - sd->codeOff
+                    < (size_t) sd->insnsSize * sizeof(u2))
+            {
+                MY_LOG_ERROR("method %u code out of range", sd->methodIndex);
+                free(inlineOffs);
+                return false;
+            }
+        }
+
+        if (sd->size != 0 && sd->size != pos - start) {
+            MY_LOG_ERROR("method %u: record size %u, parsed %zu",
+                sd->methodIndex, sd->size, pos - start);
+            free(inlineOffs);
+            return false;
+        }
+    }
+    mSeparatorCount = count;
+
+    if (inlineCode) {
+        mCode.raw = allocCodeSection(codeSize, &mCode.mapSize);
+        if (mCode.raw == NULL) {
+            free(inlineOffs);
+            return false;
+        }
+        mCode.rawSize = codeSize;
+        for (u4 i = 0; i < count; i++) {
+            SeparatorData* sd = &mSeparatorDatas[i];
+            memcpy(mCode.raw + sd->codeOff, mData + inlineOffs[i],
+                sd->insnsSize * sizeof(u2));
+        }
+        free(inlineOffs);
+    }
+    return true;
+
+truncated:
+    MY_LOG_ERROR("yc separator data truncated");
+    free(inlineOffs);
+    return false;
+}
+
+bool YcFile::attach(SeparatorData* separatorDatas, u4 count,
+    const u1* code, size_t codeSize,
+    const u4* chunkChecksums, u4 chunkSize, u4 chunkCount)
+{
+    free(mSeparatorDatas);
+    mSeparatorDatas = separatorDatas;
+    mSeparatorCount = count;
+
+    mCode.chunks = (YcChunk*) calloc(chunkCount ? chunkCount : 1,
+        sizeof(YcChunk));
+    mCode.chunkState = (volatile int32_t*) calloc(chunkCount ? chunkCount : 1,
+        sizeof(int32_t));
+    if (mCode.chunks == NULL || mCode.chunkState == NULL) {
+        return false;
+    }
+    for (u4 i = 0; i < chunkCount; i++) {
+        YcChunk* chunk = &mCode.chunks[i];
+        chunk->offset = i * chunkSize;
+        chunk->rawSize = (i == chunkCount - 1)
+            ? codeSize - (size_t) i * chunkSize : chunkSize;
+        chunk->checksum = chunkChecksums[i];
+    }
+
+    mCode.raw = (u1*) code;
+    mCode.rawSize = codeSize;
+    mCode.mapSize = 0;
+    mCode.codec = NULL;
+    mCode.chunkSize = chunkSize;
+    mCode.chunkCount = chunkCount;
+    return true;
+}
+
+const u2* YcFile::getInsns(const SeparatorData* sd)
+{
+    const u2* insns = ycGetInsns(&mCode, sd);
+    if (insns == NULL
+        || !ycVerifyMethod(&mDigests, sd - mSeparatorDatas, insns,
+            sd->insnsSize))
+    {
+        if (mOnCorrupt != NULL
+            && android_atomic_acquire_cas(0, 1, &mCorruptReported) == 0)
+        {
+            (*mOnCorrupt)();
+        }
+        return NULL;
+    }
+    dvmStartupMark(kStartupFirstMaterialized);
+    return insns;
+}
+
+const SeparatorData* YcFile::getSeparatorData(u4 idx) const
+{
+    if (idx >= mSeparatorCount) {
+        return NULL;
+    }
+    return &mSeparatorDatas[idx];
+}
+
+const SeparatorData* YcFile::findSeparatorData(u4 methodIndex) const
+{
+    for (u4 i = 0; i < mSeparatorCount; i++) {
+        if (mSeparatorDatas[i].methodIndex == methodIndex) {
+            return &mSeparatorDatas[i];
+        }
+    }
+    return NULL;
+}
+
+static bool inflateChunk(YcCodeSection* code, u4 idx)
+{
+    const YcChunk* chunk = &code->chunks[idx];
+    u1* dst = code->raw + (size_t) idx * code->chunkSize;
+
+    /* cached code is already in place; it only needs checking */
+    if (code->codec != NULL
+        && !code->codec->decompress(code->fileBase + chunk->offset,
+            chunk->compressedSize, dst, chunk->rawSize))
+    {
+        MY_LOG_ERROR("yc chunk %u: decompression failed", idx);
+        return false;
+    }
+    if (ycChecksum(dst, chunk->rawSize) != chunk->checksum) {
+        MY_LOG_ERROR("yc chunk %u: checksum mismatch", idx);
+        return false;
+    }
+    return true;
+}
+
+bool ycEnsureChunk(YcCodeSection* code, u4 idx)
+{
+    volatile int32_t* state = &code->chunkState[idx];
+    int32_t cur = android_atomic_acquire_load(state);
+
+    if (cur == kYcChunkReady) {
+        return true;
+    }
+    if (cur == kYcChunkPending
+        && android_atomic_acquire_cas(kYcChunkPending, kYcChunkInflating,
+            state) == 0)
+    {
+        bool ok = inflateChunk(code, idx);
+
+        /* publish under the lock so waiters can't miss the broadcast */
+        pthread_mutex_lock(&code->lock);
+        android_atomic_release_store(ok ? kYcChunkReady : kYcChunkFailed,
+            state);
+        pthread_cond_broadcast(&code->cond);
+        pthread_mutex_unlock(&code->lock);
+        return ok;
+    }
+
+    pthread_mutex_lock(&code->lock);
+    while ((cur = android_atomic_acquire_load(state)) == kYcChunkInflating) {
+        pthread_cond_wait(&code->cond, &code->lock);
+    }
+    pthread_mutex_unlock(&code->lock);
+    return cur == kYcChunkReady;
+}
+
+const u2* ycGetInsns(YcCodeSection* code, const SeparatorData* sd)
+{
+    if (code->chunkCount != 0 && sd->insnsSize != 0) {
+        u4 first = sd->codeOff / code->chunkSize;
+        u4 last = (sd->codeOff + sd->insnsSize * sizeof(u2) - 1)
+            / code->chunkSize;
+        for (u4 i = first; i <= last; i++) {
+            if (!ycEnsureChunk(code, i)) {
+                return NULL;
+            }
+        }
+    }
+    return (const u2*) (code->raw + sd->codeOff);
+}
+
+size_t ycResidentCodeBytes(const YcCodeSection* code)
+{
+    if (code->chunkCount == 0) {
+        return code->rawSize;
+    }
+    size_t bytes = 0;
+    for (u4 i = 0; i < code->chunkCount; i++) {
+        if (android_atomic_acquire_load(&code->chunkState[i]) == kYcChunkReady) {
+            bytes += code->chunks[i].rawSize;
+        }
+    }
+    return bytes;
+}
+
+/*
+ * Prefetch task.  Each worker claims chunks in file order until none are
+ * left; chunks already taken by an on-demand lookup are skipped by the
+ * CAS in ycEnsureChunk.
+ */
+static void prefetchWorker(void* arg)
+{
+    YcCodeSection* code = (YcCodeSection*) arg;
+    while (true) {
+        u4 idx = (u4) __sync_fetch_and_add(&code->nextPrefetch, 1);
+        if (idx >= code->chunkCount) {
+            break;
+        }
+        ycEnsureChunk(code, idx);
+    }
+}
+
+void ycPrefetchChunks(YcCodeSection* code, WorkerPool* pool)
+{
+    if (code->chunkCount == 0 || code->prefetchStarted) {
+        return;
+    }
+    code->prefetchStarted = true;
+
+    int workers = dvmGetCpuCount();
+    if ((u4) workers > code->chunkCount) {
+        workers = code->chunkCount;
+    }
+    for (int i = 0; i < workers; i++) {
+        dvmWorkerPoolSubmit(pool, &code->prefetchGroup, prefetchWorker, code);
+    }
+}
+
+void ycWaitForPrefetch(YcCodeSection* code)
+{
+    if (code->prefetchStarted) {
+        dvmWorkGroupWait(&code->prefetchGroup);
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef CUSTOMAPPVMP_YCFILE_H
+#define CUSTOMAPPVMP_YCFILE_H
+
+#include <pthread.h>
+#include "Common.h"
+#include "YcFormat.h"
+#include "YcCodec.h"
+#include "WorkerPool.h"
+#include "YcVerify.h"
+
+/*
+ * One protected method, as described by a SeparatorData record.
+ */
+struct SeparatorData {
+    u4          methodIndex;
+    u4          size;
+    u4          accessFlag;
+    u4          paramSize;
+    u4          registerSize;
+    u4          shortyLen;
+    const char* shorty;         /* points into the file, not NUL-terminated */
+    u4          insnsSize;      /* in 16-bit code units */
+    u4          codeOff;        /* byte offset into the code section */
+};
+
+/* chunk states; transitions are Pending -> Inflating -> Ready|Failed */
+enum YcChunkState {
+    kYcChunkPending     = 0,
+    kYcChunkInflating   = 1,
+    kYcChunkReady       = 2,
+    kYcChunkFailed      = 3,
+};
+
+struct YcChunk {
+    u4  offset;
+    u4  compressedSize;
+    u4  rawSize;
+    u4  checksum;
+};
+
+/*
+ * Uncompressed code section.  "raw" is reserved up front as an anonymous
+ * mapping of rawSize bytes; pages are only committed as chunks are
+ * inflated into it, so methods that are never touched cost no memory.
+ * When the code comes from the persistent cache "raw" points into that
+ * mapping instead, mapSize is 0 because we don't own it, and codec is
+ * NULL: the chunks are the cache's, and making one "resident" just checks
+ * it against its checksum in place.
+ *
+ * Chunks are made resident either by the background prefetch started with
+ * ycPrefetchChunks() or on demand by ycGetInsns().  Whichever thread wins
+ * the Pending -> Inflating CAS does the work; everyone else waits on
+ * "cond" until the chunk leaves the Inflating state.
+ */
+struct YcCodeSection {
+    u1*                 raw;
+    size_t              rawSize;
+    size_t              mapSize;
+
+    const u1*           fileBase;
+    const YcCodec*      codec;
+    u4                  chunkSize;
+    u4                  chunkCount;
+    YcChunk*            chunks;
+    volatile int32_t*   chunkState;
+
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+
+    WorkGroup           prefetchGroup;
+    bool                prefetchStarted;
+    volatile int32_t    nextPrefetch;       /* next chunk for the prefetchers */
+};
+
+class YcFile {
+public:
+    YcFile();
+    ~YcFile();
+
+    /*
+     * Parse a yc image.  "data" must stay valid for the life of the
+     * YcFile; compressed chunks are read from it lazily.
+     */
+    bool parse(const u1* data, size_t size);
+
+    /*
+     * Use an already prepared method table and fully resident code (from
+     * the persistent cache) instead of parsing.  Takes ownership of
+     * "separatorDatas", which must come from malloc; "code" and
+     * "chunkChecksums" are borrowed.  Each chunkSize piece of the code is
+     * checked against its checksum the first time a method in it is used.
+     */
+    bool attach(SeparatorData* separatorDatas, u4 count,
+        const u1* code, size_t codeSize,
+        const u4* chunkChecksums, u4 chunkSize, u4 chunkCount);
+
+    u4 getSeparatorCount() const { return mSeparatorCount; }
+    const SeparatorData* getSeparatorData(u4 idx) const;
+    const SeparatorData* findSeparatorData(u4 methodIndex) const;
+
+    YcCodeSection* getCodeSection() { return &mCode; }
+
+    /*
+     * Load the digest section of the yc image.  parse() does this itself;
+     * call it after attach() when the code came from the cache.
+     */
+    bool loadDigests(const u1* data, size_t size);
+
+    YcDigests* getDigests() { return &mDigests; }
+
+    /*
+     * Instructions of "sd", made resident and checked against the
+     * method's digest on first use.  Returns NULL if the code is corrupt
+     * or has been tampered with.
+     */
+    const u2* getInsns(const SeparatorData* sd);
+
+    /*
+     * Called, once, the first time attached code fails a check.
+     */
+    void setCorruptionHandler(void (*handler)()) { mOnCorrupt = handler; }
+
+private:
+    bool parseSeparatorDatas(bool inlineCode);
+    bool parseChunkDirectory(u4 offset);
+
+    const u1*       mData;
+    size_t          mSize;
+    u4              mSeparatorCount;
+    SeparatorData*  mSeparatorDatas;
+    YcCodeSection   mCode;
+    YcDigests       mDigests;
+    void            (*mOnCorrupt)();
+    volatile int32_t mCorruptReported;
+};
+
+/*
+ * Return the instructions for "sd", inflating the chunks that hold them
+ * if necessary.  Returns NULL if a chunk is corrupt.
+ */
+const u2* ycGetInsns(YcCodeSection* code, const SeparatorData* sd);
+
+/*
+ * Make chunk "idx" resident.  Safe to call from any thread.
+ */
+bool ycEnsureChunk(YcCodeSection* code, u4 idx);
+
+/*
+ * Bytes of uncompressed code currently resident: every chunk that has
+ * been inflated, or the whole section for an image without chunks.
+ */
+size_t ycResidentCodeBytes(const YcCodeSection* code);
+
+/*
+ * Queue every pending chunk on "pool".  Returns immediately; on-demand
+ * lookups keep working while the prefetch runs and simply wait for (or
+ * take over) the chunk they need.
+ */
+void ycPrefetchChunks(YcCodeSection* code, WorkerPool* pool);
+
+/*
+ * Block until a prefetch started with ycPrefetchChunks() is done.
+ */
+void ycWaitForPrefetch(YcCodeSection* code);
+
+#endif //CUSTOMAPPVMP_YCFILE_H
@@ -0,0 +1,114 @@
+#ifndef CUSTOMAPPVMP_YCFORMAT_H
+#define CUSTOMAPPVMP_YCFORMAT_H
+
+#include <string.h>
+#include "Common.h"
+#include "Inlines.h"
+
+/*
+ * On-disk layout of the yc container (assets/classes.yc).
+ *
+ * All values are little-endian.  The header starts with a 6-byte magic, so
+ * every field after it is unaligned; never read the file through these
+ * structs directly, use ycReadU2/ycReadU4 instead.
+ *
+ *   YcHeader
+ *   SeparatorData[separatorDatasSize]     (variable length, see below)
+ *   YcChunkDirectory                      (version 0001 only)
+ *   compressed chunks
+ *   YcDigestHeader + digest tables        (optional, always last)
+ *
+ * Version 0000 stores each method's instructions inline:
+ *
+ *   u4 methodIndex, u4 size, u4 accessFlag, u4 paramSize, u4 registerSize,
+ *   u4 shortyLen, u1 shorty[shortyLen],
+ *   u4 insnsSize, u2 insns[insnsSize]
+ *
+ * Version 0001 moves the instructions into a separate code section that is
+ * split into fixed-size chunks which are compressed independently.  The
+ * inline insns array is replaced by the offset of the method's code in the
+ * uncompressed code section:
+ *
+ *   ... u4 insnsSize, u4 codeOff
+ *
+ * A method's code may straddle a chunk boundary; the loader makes every
+ * chunk it covers resident before handing out the pointer.
+ */
+
+#define YC_MAGIC_SIZE       6
+#define YC_MAGIC_V0         "YC0000"
+#define YC_MAGIC_V1         "YC0001"
+
+#define YC_CHUNK_DIR_MAGIC  0x44434359      /* "YCCD" */
+
+/* chunk sizes outside this range are rejected by the parser */
+#define YC_MIN_CHUNK_SIZE   (4 * 1024)
+#define YC_MAX_CHUNK_SIZE   (4 * 1024 * 1024)
+
+struct YcHeader {
+    u1  magic[YC_MAGIC_SIZE];
+    u4  size;                   /* size of this header */
+    u4  chunkDirOff;            /* file offset of YcChunkDirectory, or 0 */
+    u4  digestOff;              /* file offset of YcDigestHeader, or 0 */
+    u4  separatorDatasSize;     /* number of SeparatorData entries */
+    u4  separatorDatasOff;      /* file offset of the first entry */
+} __attribute__((packed));
+
+struct YcChunkDirectoryHeader {
+    u4  magic;                  /* YC_CHUNK_DIR_MAGIC */
+    u2  codec;                  /* YcCodecId */
+    u2  flags;
+    u4  chunkSize;              /* uncompressed size of every chunk but the last */
+    u4  chunkCount;
+    u4  rawSize;                /* uncompressed size of the whole code section */
+} __attribute__((packed));
+
+struct YcChunkEntry {
+    u4  offset;                 /* file offset of the compressed bytes */
+    u4  compressedSize;
+    u4  checksum;               /* adler32 of the uncompressed chunk */
+} __attribute__((packed));
+
+/*
+ * Integrity digests.  Everything before digestOff (the "payload") is
+ * split into blockSize blocks, each with a ycHash64 digest, so it can be
+ * verified in parallel.  Each method also has the ycHash64 of its
+ * uncompressed instructions, checked when the method is first used.  If
+ * kYcDigestHasRoot is set, "root" is the SHA-256 of the two hash tables
+ * as stored, which lets the whole table be pinned by one value.
+ *
+ *   YcDigestHeader
+ *   u8 blockHashes[blockCount]
+ *   u8 methodHashes[methodCount]          (SeparatorData order)
+ */
+#define YC_DIGEST_MAGIC     0x47444359      /* "YCDG" */
+#define kYcDigestXxh3       1               /* ycHash64 == XXH3_64bits */
+#define kYcDigestHasRoot    0x0001
+
+struct YcDigestHeader {
+    u4  magic;                  /* YC_DIGEST_MAGIC */
+    u2  algorithm;              /* kYcDigestXxh3 */
+    u2  flags;
+    u4  blockSize;
+    u4  blockCount;
+    u4  methodCount;
+    u1  root[32];
+} __attribute__((packed));
+
+/*
+ * Unaligned little-endian readers.  memcpy keeps armv5 from faulting on
+ * unaligned word loads.
+ */
+INLINE u2 ycReadU2(const u1* ptr) {
+    u2 val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+INLINE u4 ycReadU4(const u1* ptr) {
+    u4 val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+#endif //CUSTOMAPPVMP_YCFORMAT_H
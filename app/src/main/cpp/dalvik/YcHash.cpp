@@ -0,0 +1,472 @@
+#include <pthread.h>
+#include <string.h>
+#include "YcHash.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <emmintrin.h>
+# include <immintrin.h>
+# define YC_HASH_X86 1
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+# include <arm_neon.h>
+# define YC_HASH_NEON 1
+# if !defined(__aarch64__)
+#  include <sys/auxv.h>
+#  ifndef HWCAP_NEON
+#   define HWCAP_NEON (1 << 12)
+#  endif
+# endif
+#endif
+
+#define PRIME32_1   0x9E3779B1U
+#define PRIME32_2   0x85EBCA77U
+#define PRIME32_3   0xC2B2AE3DU
+#define PRIME64_1   0x9E3779B185EBCA87ULL
+#define PRIME64_2   0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3   0x165667B19E3779F9ULL
+#define PRIME64_4   0x85EBCA77C2B2AE63ULL
+#define PRIME64_5   0x27D4EB2F165667C5ULL
+#define PRIME_MX1   0x165667919E3779F9ULL
+#define PRIME_MX2   0x9FB21C651E98DF25ULL
+
+#define kStripeLen          64
+#define kSecretSize         192
+#define kSecretConsumeRate  8
+#define kAccNb              8
+#define kStripesPerBlock    ((kSecretSize - kStripeLen) / kSecretConsumeRate)
+#define kBlockLen           (kStripeLen * kStripesPerBlock)
+#define kMidSizeMax         240
+#define kSecretSizeMin      136
+#define kMidSizeStartOffset 3
+#define kMidSizeLastOffset  17
+#define kSecretLastAccStart 7
+#define kSecretMergeStart   11
+
+/* XXH3_kSecret */
+static const u1 kSecret[kSecretSize] __attribute__((aligned(64))) = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline u4 readLE32(const u1* ptr)
+{
+    u4 val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+static inline u8 readLE64(const u1* ptr)
+{
+    u8 val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+static inline u8 rotl64(u8 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline u8 mul128Fold64(u8 lhs, u8 rhs)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t) lhs * rhs;
+    return (u8) product ^ (u8) (product >> 64);
+#else
+    /* 32-bit targets: schoolbook 64x64->128 */
+    u8 loLo = (u8) (u4) lhs * (u4) rhs;
+    u8 hiLo = (lhs >> 32) * (u4) rhs;
+    u8 loHi = (u8) (u4) lhs * (rhs >> 32);
+    u8 hiHi = (lhs >> 32) * (rhs >> 32);
+    u8 cross = (loLo >> 32) + (u4) hiLo + loHi;
+    u8 upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+    u8 lower = (cross << 32) | (u4) loLo;
+    return lower ^ upper;
+#endif
+}
+
+static inline u8 xxh64Avalanche(u8 h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline u8 xxh3Avalanche(u8 h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline u8 rrmxmx(u8 h, u8 len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static inline u8 mix16B(const u1* input, const u1* secret)
+{
+    return mul128Fold64(readLE64(input) ^ readLE64(secret),
+        readLE64(input + 8) ^ readLE64(secret + 8));
+}
+
+static u8 hashLen0to16(const u1* input, size_t len)
+{
+    if (len > 8) {
+        u8 bitflip1 = readLE64(kSecret + 24) ^ readLE64(kSecret + 32);
+        u8 bitflip2 = readLE64(kSecret + 40) ^ readLE64(kSecret + 48);
+        u8 lo = readLE64(input) ^ bitflip1;
+        u8 hi = readLE64(input + len - 8) ^ bitflip2;
+        u8 acc = len + __builtin_bswap64(lo) + hi + mul128Fold64(lo, hi);
+        return xxh3Avalanche(acc);
+    }
+    if (len >= 4) {
+        u4 input1 = readLE32(input);
+        u4 input2 = readLE32(input + len - 4);
+        u8 bitflip = readLE64(kSecret + 8) ^ readLE64(kSecret + 16);
+        u8 input64 = input2 + ((u8) input1 << 32);
+        return rrmxmx(input64 ^ bitflip, len);
+    }
+    if (len > 0) {
+        u4 combined = ((u4) input[0] << 16) | ((u4) input[len >> 1] << 24)
+            | (u4) input[len - 1] | ((u4) len << 8);
+        u8 bitflip = readLE32(kSecret) ^ readLE32(kSecret + 4);
+        return xxh64Avalanche((u8) combined ^ bitflip);
+    }
+    return xxh64Avalanche(readLE64(kSecret + 56) ^ readLE64(kSecret + 64));
+}
+
+static u8 hashLen17to128(const u1* input, size_t len)
+{
+    u8 acc = len * PRIME64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += mix16B(input + 48, kSecret + 96);
+                acc += mix16B(input + len - 64, kSecret + 112);
+            }
+            acc += mix16B(input + 32, kSecret + 64);
+            acc += mix16B(input + len - 48, kSecret + 80);
+        }
+        acc += mix16B(input + 16, kSecret + 32);
+        acc += mix16B(input + len - 32, kSecret + 48);
+    }
+    acc += mix16B(input, kSecret);
+    acc += mix16B(input + len - 16, kSecret + 16);
+    return xxh3Avalanche(acc);
+}
+
+static u8 hashLen129to240(const u1* input, size_t len)
+{
+    u8 acc = len * PRIME64_1;
+    int nbRounds = (int) len / 16;
+    for (int i = 0; i < 8; i++) {
+        acc += mix16B(input + 16 * i, kSecret + 16 * i);
+    }
+    acc = xxh3Avalanche(acc);
+    for (int i = 8; i < nbRounds; i++) {
+        acc += mix16B(input + 16 * i,
+            kSecret + 16 * (i - 8) + kMidSizeStartOffset);
+    }
+    acc += mix16B(input + len - 16,
+        kSecret + kSecretSizeMin - kMidSizeLastOffset);
+    return xxh3Avalanche(acc);
+}
+
+/*
+ * Stripe kernels for the long-input loop.  "accumulate" folds nbStripes
+ * 64-byte stripes into the eight 64-bit accumulators, advancing the
+ * secret by 8 bytes per stripe; "scramble" runs at the end of each block.
+ */
+typedef void (*HashAccumulate_func)(u8* acc, const u1* input,
+    const u1* secret, size_t nbStripes);
+typedef void (*HashScramble_func)(u8* acc, const u1* secret);
+
+static void accumulateScalar(u8* acc, const u1* input, const u1* secret,
+    size_t nbStripes)
+{
+    for (size_t n = 0; n < nbStripes; n++) {
+        const u1* in = input + n * kStripeLen;
+        const u1* key = secret + n * kSecretConsumeRate;
+        for (int i = 0; i < kAccNb; i++) {
+            u8 dataVal = readLE64(in + 8 * i);
+            u8 dataKey = dataVal ^ readLE64(key + 8 * i);
+            acc[i ^ 1] += dataVal;
+            acc[i] += (u8) (u4) dataKey * (dataKey >> 32);
+        }
+    }
+}
+
+static void scrambleScalar(u8* acc, const u1* secret)
+{
+    for (int i = 0; i < kAccNb; i++) {
+        u8 a = acc[i];
+        a ^= a >> 47;
+        a ^= readLE64(secret + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#if YC_HASH_X86
+static void accumulateSse2(u8* acc, const u1* input, const u1* secret,
+    size_t nbStripes)
+{
+    __m128i xacc[4];
+    for (int i = 0; i < 4; i++) {
+        xacc[i] = _mm_loadu_si128((const __m128i*) acc + i);
+    }
+    for (size_t n = 0; n < nbStripes; n++) {
+        const u1* in = input + n * kStripeLen;
+        const u1* key = secret + n * kSecretConsumeRate;
+        for (int i = 0; i < 4; i++) {
+            __m128i dataVec = _mm_loadu_si128((const __m128i*) in + i);
+            __m128i keyVec = _mm_loadu_si128((const __m128i*) key + i);
+            __m128i dataKey = _mm_xor_si128(dataVec, keyVec);
+            __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+            __m128i dataSwap = _mm_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm_add_epi64(_mm_add_epi64(xacc[i], dataSwap), product);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i*) acc + i, xacc[i]);
+    }
+}
+
+static void scrambleSse2(u8* acc, const u1* secret)
+{
+    const __m128i prime32 = _mm_set1_epi32((int) PRIME32_1);
+    for (int i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128((const __m128i*) acc + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*) secret + i));
+        __m128i aHi = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i prodLo = _mm_mul_epu32(a, prime32);
+        __m128i prodHi = _mm_mul_epu32(aHi, prime32);
+        _mm_storeu_si128((__m128i*) acc + i,
+            _mm_add_epi64(prodLo, _mm_slli_epi64(prodHi, 32)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void accumulateAvx2(u8* acc, const u1* input, const u1* secret,
+    size_t nbStripes)
+{
+    __m256i xacc[2];
+    for (int i = 0; i < 2; i++) {
+        xacc[i] = _mm256_loadu_si256((const __m256i*) acc + i);
+    }
+    for (size_t n = 0; n < nbStripes; n++) {
+        const u1* in = input + n * kStripeLen;
+        const u1* key = secret + n * kSecretConsumeRate;
+        for (int i = 0; i < 2; i++) {
+            __m256i dataVec = _mm256_loadu_si256((const __m256i*) in + i);
+            __m256i keyVec = _mm256_loadu_si256((const __m256i*) key + i);
+            __m256i dataKey = _mm256_xor_si256(dataVec, keyVec);
+            __m256i dataKeyHi = _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            __m256i product = _mm256_mul_epu32(dataKey, dataKeyHi);
+            __m256i dataSwap = _mm256_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm256_add_epi64(_mm256_add_epi64(xacc[i], dataSwap), product);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        _mm256_storeu_si256((__m256i*) acc + i, xacc[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void scrambleAvx2(u8* acc, const u1* secret)
+{
+    const __m256i prime32 = _mm256_set1_epi32((int) PRIME32_1);
+    for (int i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) acc + i);
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*) secret + i));
+        __m256i aHi = _mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m256i prodLo = _mm256_mul_epu32(a, prime32);
+        __m256i prodHi = _mm256_mul_epu32(aHi, prime32);
+        _mm256_storeu_si256((__m256i*) acc + i,
+            _mm256_add_epi64(prodLo, _mm256_slli_epi64(prodHi, 32)));
+    }
+}
+#endif
+
+#if YC_HASH_NEON
+static void accumulateNeon(u8* acc, const u1* input, const u1* secret,
+    size_t nbStripes)
+{
+    uint64x2_t xacc[4];
+    for (int i = 0; i < 4; i++) {
+        xacc[i] = vld1q_u64(acc + 2 * i);
+    }
+    for (size_t n = 0; n < nbStripes; n++) {
+        const u1* in = input + n * kStripeLen;
+        const u1* key = secret + n * kSecretConsumeRate;
+        for (int i = 0; i < 4; i++) {
+            uint64x2_t dataVec = vreinterpretq_u64_u8(vld1q_u8(in + 16 * i));
+            uint64x2_t keyVec = vreinterpretq_u64_u8(vld1q_u8(key + 16 * i));
+            uint64x2_t dataKey = veorq_u64(dataVec, keyVec);
+            uint64x2_t dataSwap = vextq_u64(dataVec, dataVec, 1);
+            uint32x2_t dataKeyLo = vmovn_u64(dataKey);
+            uint32x2_t dataKeyHi = vshrn_n_u64(dataKey, 32);
+            xacc[i] = vaddq_u64(xacc[i], dataSwap);
+            xacc[i] = vmlal_u32(xacc[i], dataKeyLo, dataKeyHi);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        vst1q_u64(acc + 2 * i, xacc[i]);
+    }
+}
+
+static void scrambleNeon(u8* acc, const u1* secret)
+{
+    const uint32x2_t prime = vdup_n_u32(PRIME32_1);
+    for (int i = 0; i < 4; i++) {
+        uint64x2_t a = vld1q_u64(acc + 2 * i);
+        a = veorq_u64(a, vshrq_n_u64(a, 47));
+        a = veorq_u64(a, vreinterpretq_u64_u8(vld1q_u8(secret + 16 * i)));
+        uint32x2_t aLo = vmovn_u64(a);
+        uint32x2_t aHi = vshrn_n_u64(a, 32);
+        uint64x2_t prodHi = vshlq_n_u64(vmull_u32(aHi, prime), 32);
+        vst1q_u64(acc + 2 * i, vmlal_u32(prodHi, aLo, prime));
+    }
+}
+#endif
+
+struct HashKernel {
+    const char*         name;
+    HashAccumulate_func accumulate;
+    HashScramble_func   scramble;
+    bool                (*supported)();
+};
+
+static bool alwaysSupported() { return true; }
+
+#if YC_HASH_X86
+static bool avx2Supported() { return __builtin_cpu_supports("avx2"); }
+#endif
+
+#if YC_HASH_NEON
+static bool neonSupported()
+{
+# if defined(__aarch64__)
+    return true;
+# else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+# endif
+}
+#endif
+
+/* best first */
+static const HashKernel gHashKernels[] = {
+#if YC_HASH_X86
+    { "avx2",   accumulateAvx2,     scrambleAvx2,   avx2Supported },
+    { "sse2",   accumulateSse2,     scrambleSse2,   alwaysSupported },
+#endif
+#if YC_HASH_NEON
+    { "neon",   accumulateNeon,     scrambleNeon,   neonSupported },
+#endif
+    { "scalar", accumulateScalar,   scrambleScalar, alwaysSupported },
+};
+
+static const HashKernel* gHashKernel;
+static pthread_once_t gHashKernelOnce = PTHREAD_ONCE_INIT;
+
+static void selectBestKernel()
+{
+    for (size_t i = 0; i < array_size(gHashKernels); i++) {
+        if (gHashKernels[i].supported()) {
+            gHashKernel = &gHashKernels[i];
+            return;
+        }
+    }
+}
+
+static const HashKernel* getKernel()
+{
+    pthread_once(&gHashKernelOnce, selectBestKernel);
+    return gHashKernel;
+}
+
+static u8 hashLong(const u1* input, size_t len)
+{
+    const HashKernel* kernel = getKernel();
+    u8 acc[kAccNb] __attribute__((aligned(32))) = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+
+    size_t nbBlocks = (len - 1) / kBlockLen;
+    for (size_t n = 0; n < nbBlocks; n++) {
+        kernel->accumulate(acc, input + n * kBlockLen, kSecret,
+            kStripesPerBlock);
+        kernel->scramble(acc, kSecret + kSecretSize - kStripeLen);
+    }
+
+    /* last partial block, then the final (possibly overlapping) stripe */
+    size_t nbStripes = ((len - 1) - kBlockLen * nbBlocks) / kStripeLen;
+    kernel->accumulate(acc, input + nbBlocks * kBlockLen, kSecret, nbStripes);
+    kernel->accumulate(acc, input + len - kStripeLen,
+        kSecret + kSecretSize - kStripeLen - kSecretLastAccStart, 1);
+
+    u8 result = len * PRIME64_1;
+    for (int i = 0; i < 4; i++) {
+        const u1* key = kSecret + kSecretMergeStart + 16 * i;
+        result += mul128Fold64(acc[2 * i] ^ readLE64(key),
+            acc[2 * i + 1] ^ readLE64(key + 8));
+    }
+    return xxh3Avalanche(result);
+}
+
+u8 ycHash64(const void* data, size_t len)
+{
+    const u1* input = (const u1*) data;
+    if (len <= 16) {
+        return hashLen0to16(input, len);
+    }
+    if (len <= 128) {
+        return hashLen17to128(input, len);
+    }
+    if (len <= kMidSizeMax) {
+        return hashLen129to240(input, len);
+    }
+    return hashLong(input, len);
+}
+
+const char* ycHashKernelName()
+{
+    return getKernel()->name;
+}
+
+bool ycHashSelectKernel(const char* name)
+{
+    getKernel();
+    for (size_t i = 0; i < array_size(gHashKernels); i++) {
+        if (strcmp(gHashKernels[i].name, name) == 0
+            && gHashKernels[i].supported())
+        {
+            gHashKernel = &gHashKernels[i];
+            return true;
+        }
+    }
+    return false;
+}
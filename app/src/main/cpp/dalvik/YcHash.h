@@ -0,0 +1,29 @@
+#ifndef CUSTOMAPPVMP_YCHASH_H
+#define CUSTOMAPPVMP_YCHASH_H
+
+#include <stddef.h>
+#include "Common.h"
+
+/*
+ * 64-bit non-cryptographic hash used for yc integrity checks.
+ *
+ * The output is bit-identical to XXH3_64bits() (seed 0, default secret)
+ * from xxHash 0.8, so the packer can use any stock xxHash binding.  Inputs
+ * longer than 240 bytes go through a stripe loop that has SSE2, AVX2 and
+ * NEON versions; the fastest one the CPU supports is picked on first use.
+ * All versions produce the same result.
+ */
+u8 ycHash64(const void* data, size_t len);
+
+/*
+ * Name of the selected stripe kernel ("scalar", "sse2", "avx2", "neon").
+ */
+const char* ycHashKernelName();
+
+/*
+ * Force a kernel by name, for benchmarking.  Returns false if it isn't
+ * compiled in or the CPU doesn't support it.
+ */
+bool ycHashSelectKernel(const char* name);
+
+#endif //CUSTOMAPPVMP_YCHASH_H
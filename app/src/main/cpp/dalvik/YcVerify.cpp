@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+#include "YcVerify.h"
+#include "YcFormat.h"
+#include "YcHash.h"
+#include "Sha256.h"
+#include "atomic-arm.h"
+#include "log.h"
+
+#define DIGEST_U4(_ptr, _field) \
+    ycReadU4((_ptr) + offsetof(YcDigestHeader, _field))
+
+/*
+ * Root of the digest tables of the classes.yc this library ships with,
+ * as 64 hex digits; the packer prints it and the build passes it in
+ * (-DYC_DIGEST_ROOT=... to CMake).  The root stored in the yc only
+ * proves the tables are self-consistent, which anyone rewriting the file
+ * can keep true; this one can't be changed without the library.
+ */
+#ifdef YC_DIGEST_ROOT
+static const char kPinnedRoot[] = YC_DIGEST_ROOT;
+
+static bool matchesPinnedRoot(const u1* root)
+{
+    if (strlen(kPinnedRoot) != SHA256_DIGEST_SIZE * 2) {
+        MY_LOG_ERROR("YC_DIGEST_ROOT must be %d hex digits",
+            SHA256_DIGEST_SIZE * 2);
+        return false;
+    }
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        char hex[3] = { kPinnedRoot[i * 2], kPinnedRoot[i * 2 + 1], '\0' };
+        if ((u1) strtoul(hex, NULL, 16) != root[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+static inline u8 readHash(const u1* table, u4 idx)
+{
+    u8 val;
+    memcpy(&val, table + (size_t) idx * sizeof(u8), sizeof(val));
+    return val;
+}
+
+void ycInitDigests(YcDigests* digests)
+{
+    memset(digests, 0, sizeof(*digests));
+    dvmWorkGroupInit(&digests->group);
+}
+
+bool ycLoadDigests(YcDigests* digests, const u1* data, size_t size,
+    u4 digestOff, u4 methodCount)
+{
+    if (digestOff == 0) {
+#ifdef YC_DIGEST_ROOT
+        MY_LOG_ERROR("yc has no digests, but the library pins them");
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    if (digestOff > size || size - digestOff < sizeof(YcDigestHeader)) {
+        MY_LOG_ERROR("yc digests out of range");
+        return false;
+    }
+    const u1* ptr = data + digestOff;
+    u2 algorithm = ycReadU2(ptr + offsetof(YcDigestHeader, algorithm));
+    u2 flags = ycReadU2(ptr + offsetof(YcDigestHeader, flags));
+    u4 blockSize = DIGEST_U4(ptr, blockSize);
+    u4 blockCount = DIGEST_U4(ptr, blockCount);
+    u4 digestMethods = DIGEST_U4(ptr, methodCount);
+
+    if (DIGEST_U4(ptr, magic) != YC_DIGEST_MAGIC
+        || algorithm != kYcDigestXxh3)
+    {
+        MY_LOG_ERROR("unsupported yc digest section");
+        return false;
+    }
+    if (blockSize == 0
+        || blockCount != (u4) (((u8) digestOff + blockSize - 1) / blockSize)
+        || digestMethods != methodCount)
+    {
+        MY_LOG_ERROR("yc digest table doesn't match the file");
+        return false;
+    }
+    size_t tableSize = ((size_t) blockCount + methodCount) * sizeof(u8);
+    if (size - digestOff - sizeof(YcDigestHeader) < tableSize) {
+        MY_LOG_ERROR("yc digest table truncated");
+        return false;
+    }
+
+    const u1* tables = ptr + sizeof(YcDigestHeader);
+#ifdef YC_DIGEST_ROOT
+    bool checkRoot = true;
+#else
+    bool checkRoot = (flags & kYcDigestHasRoot) != 0;
+#endif
+    if (checkRoot) {
+        Sha256Ctx ctx;
+        u1 root[SHA256_DIGEST_SIZE];
+        sha256Init(&ctx);
+        sha256Update(&ctx, tables, tableSize);
+        sha256Final(&ctx, root);
+#ifdef YC_DIGEST_ROOT
+        bool rootOk = matchesPinnedRoot(root);
+#else
+        bool rootOk = memcmp(root, ptr + offsetof(YcDigestHeader, root),
+            SHA256_DIGEST_SIZE) == 0;
+#endif
+        if (!rootOk) {
+            MY_LOG_ERROR("yc digest root hash mismatch");
+            return false;
+        }
+    }
+
+    digests->methodVerified = (volatile int32_t*) calloc(
+        (methodCount + 31) / 32 + 1, sizeof(int32_t));
+    if (digests->methodVerified == NULL) {
+        return false;
+    }
+    digests->present = true;
+    digests->data = data;
+    digests->payloadSize = digestOff;
+    digests->blockSize = blockSize;
+    digests->blockCount = blockCount;
+    digests->methodCount = methodCount;
+    digests->blockHashes = tables;
+    digests->methodHashes = tables + (size_t) blockCount * sizeof(u8);
+    MY_LOG_INFO("yc digests: %u blocks of %u, %u methods, hash kernel %s",
+        blockCount, blockSize, methodCount, ycHashKernelName());
+    return true;
+}
+
+void ycFreeDigests(YcDigests* digests)
+{
+    ycWaitForPayloadCheck(digests);
+    free((void*) digests->methodVerified);
+    dvmWorkGroupDestroy(&digests->group);
+    memset(digests, 0, sizeof(*digests));
+}
+
+/*
+ * Hashing task.  Workers claim blocks until none are left or one of them
+ * has found a mismatch.
+ */
+static void hashBlocksWorker(void* arg)
+{
+    YcDigests* digests = (YcDigests*) arg;
+    while (android_atomic_acquire_load(&digests->payloadState)
+        == kYcVerifyRunning)
+    {
+        u4 idx = (u4) __sync_fetch_and_add(&digests->nextBlock, 1);
+        if (idx >= digests->blockCount) {
+            break;
+        }
+        size_t start = (size_t) idx * digests->blockSize;
+        size_t len = digests->payloadSize - start;
+        if (len > digests->blockSize) {
+            len = digests->blockSize;
+        }
+        if (ycHash64(digests->data + start, len)
+            != readHash(digests->blockHashes, idx))
+        {
+            MY_LOG_ERROR("yc payload block %u failed verification", idx);
+            android_atomic_release_store(kYcVerifyFailed,
+                &digests->payloadState);
+        }
+    }
+
+    /* last worker out records the verdict, unless a mismatch already did */
+    if (__sync_sub_and_fetch(&digests->activeWorkers, 1) == 0) {
+        android_atomic_acquire_cas(kYcVerifyRunning, kYcVerifyPassed,
+            &digests->payloadState);
+    }
+}
+
+void ycVerifyPayloadAsync(YcDigests* digests, WorkerPool* pool)
+{
+    if (!digests->present
+        || android_atomic_acquire_cas(kYcVerifyPending, kYcVerifyRunning,
+            &digests->payloadState) != 0)
+    {
+        return;
+    }
+
+    int workers = dvmGetCpuCount();
+    if ((u4) workers > digests->blockCount) {
+        workers = digests->blockCount;
+    }
+    digests->activeWorkers = workers;
+    for (int i = 0; i < workers; i++) {
+        dvmWorkerPoolSubmit(pool, &digests->group, hashBlocksWorker, digests);
+    }
+}
+
+bool ycWaitForPayloadCheck(YcDigests* digests)
+{
+    if (!digests->present) {
+        return true;
+    }
+    dvmWorkGroupWait(&digests->group);
+    return android_atomic_acquire_load(&digests->payloadState)
+        != kYcVerifyFailed;
+}
+
+bool ycVerifyMethod(YcDigests* digests, u4 idx, const u2* insns,
+    u4 insnsSize)
+{
+    if (!digests->present) {
+        return true;
+    }
+    if (android_atomic_acquire_load(&digests->payloadState)
+        == kYcVerifyFailed)
+    {
+        return false;
+    }
+
+    volatile int32_t* word = &digests->methodVerified[idx / 32];
+    int32_t bit = (int32_t) (1U << (idx % 32));
+    if ((android_atomic_acquire_load(word) & bit) != 0) {
+        return true;
+    }
+
+    /* two threads may hash the same method at once; both get the answer */
+    if (ycHash64(insns, (size_t) insnsSize * sizeof(u2))
+        != readHash(digests->methodHashes, idx))
+    {
+        MY_LOG_ERROR("yc method %u failed verification", idx);
+        return false;
+    }
+    __sync_fetch_and_or(word, bit);
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef CUSTOMAPPVMP_YCVERIFY_H
+#define CUSTOMAPPVMP_YCVERIFY_H
+
+#include <stddef.h>
+#include "Common.h"
+#include "WorkerPool.h"
+
+/* payload verification states */
+enum YcVerifyState {
+    kYcVerifyPending    = 0,
+    kYcVerifyRunning    = 1,
+    kYcVerifyPassed     = 2,
+    kYcVerifyFailed     = 3,
+};
+
+/*
+ * Parsed digest section of a yc file (see YcDigestHeader).  Hash tables
+ * are read in place from the yc image.
+ */
+struct YcDigests {
+    bool                present;
+    const u1*           data;           /* yc image */
+    u4                  payloadSize;    /* bytes covered by blockHashes */
+    u4                  blockSize;
+    u4                  blockCount;
+    u4                  methodCount;
+    const u1*           blockHashes;    /* unaligned u8[blockCount] */
+    const u1*           methodHashes;   /* unaligned u8[methodCount] */
+
+    volatile int32_t    payloadState;   /* YcVerifyState */
+    volatile int32_t    nextBlock;      /* next block for the hashing workers */
+    volatile int32_t    activeWorkers;
+    volatile int32_t*   methodVerified; /* one bit per method */
+    WorkGroup           group;
+};
+
+void ycInitDigests(YcDigests* digests);
+
+/*
+ * Parse the digest section at "digestOff".  With digestOff == 0 the yc has
+ * no digests and every check passes.  Also checks the root hash: against
+ * YC_DIGEST_ROOT when the library was built with one, in which case the
+ * digests are mandatory, otherwise against the root stored in the yc.
+ */
+bool ycLoadDigests(YcDigests* digests, const u1* data, size_t size,
+    u4 digestOff, u4 methodCount);
+
+void ycFreeDigests(YcDigests* digests);
+
+/*
+ * Hash the payload blocks on "pool" and compare them against the table.
+ * Returns immediately; see ycWaitForPayloadCheck.
+ */
+void ycVerifyPayloadAsync(YcDigests* digests, WorkerPool* pool);
+
+/*
+ * Wait for the payload check.  Returns true if it passed (or there are no
+ * digests).
+ */
+bool ycWaitForPayloadCheck(YcDigests* digests);
+
+/*
+ * Check method "idx" against its digest the first time it is called;
+ * later calls are a bit test.  Returns false on mismatch, or if the
+ * payload check has already failed.
+ */
+bool ycVerifyMethod(YcDigests* digests, u4 idx, const u2* insns,
+    u4 insnsSize);
+
+#endif //CUSTOMAPPVMP_YCVERIFY_H
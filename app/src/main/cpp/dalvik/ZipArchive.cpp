@@ -0,0 +1,321 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "ZipArchive.h"
+#include "YcFormat.h"
+#include "log.h"
+
+/*
+ * Zip file constants.
+ */
+#define kEOCDSignature      0x06054b50
+#define kEOCDLen            22
+#define kEOCDNumEntries     10              /* total #of entries */
+#define kEOCDSize           12              /* size of central directory */
+#define kEOCDFileOffset     16              /* offset to central directory */
+
+#define kMaxCommentLen      65535
+#define kMaxEOCDSearch      (kMaxCommentLen + kEOCDLen)
+
+#define kLFHSignature       0x04034b50
+#define kLFHLen             30
+#define kLFHNameLen         26
+#define kLFHExtraLen        28
+
+#define kCDESignature       0x02014b50
+#define kCDELen             46
+#define kCDEMethod          10
+#define kCDECRC             16
+#define kCDECompLen         20
+#define kCDEUncompLen       24
+#define kCDENameLen         28
+#define kCDEExtraLen        30
+#define kCDECommentLen      32
+#define kCDELocalOffset     42
+
+static bool readFully(int fd, void* buf, size_t count, off_t offset)
+{
+    u1* ptr = (u1*) buf;
+    while (count != 0) {
+        ssize_t actual = pread(fd, ptr, count, offset);
+        if (actual < 0 && errno == EINTR) {
+            continue;
+        }
+        if (actual <= 0) {
+            return false;
+        }
+        ptr += actual;
+        count -= actual;
+        offset += actual;
+    }
+    return true;
+}
+
+/*
+ * Locate the end-of-central-directory record and read the central
+ * directory into a malloc'd buffer.
+ */
+static u1* readCentralDirectory(int fd, size_t* pSize, u4* pNumEntries)
+{
+    off_t fileLength = lseek(fd, 0, SEEK_END);
+    if (fileLength < kEOCDLen) {
+        return NULL;
+    }
+
+    size_t readAmount = kMaxEOCDSearch;
+    if ((off_t) readAmount > fileLength) {
+        readAmount = (size_t) fileLength;
+    }
+    off_t searchStart = fileLength - readAmount;
+
+    u1* scanBuf = (u1*) malloc(readAmount);
+    if (scanBuf == NULL || !readFully(fd, scanBuf, readAmount, searchStart)) {
+        free(scanBuf);
+        return NULL;
+    }
+
+    /* the EOCD is usually right at the end, so scan backwards */
+    int i;
+    for (i = (int) readAmount - kEOCDLen; i >= 0; i--) {
+        if (scanBuf[i] == 0x50 && ycReadU4(&scanBuf[i]) == kEOCDSignature) {
+            break;
+        }
+    }
+    if (i < 0) {
+        MY_LOG_ERROR("zip: EOCD not found, not a zip file");
+        free(scanBuf);
+        return NULL;
+    }
+
+    const u1* eocd = scanBuf + i;
+    u4 numEntries = ycReadU2(eocd + kEOCDNumEntries);
+    u4 dirSize = ycReadU4(eocd + kEOCDSize);
+    u4 dirOffset = ycReadU4(eocd + kEOCDFileOffset);
+    free(scanBuf);
+
+    if ((off_t) dirOffset + dirSize > searchStart + i) {
+        MY_LOG_ERROR("zip: bad central directory (off=%u size=%u)",
+            dirOffset, dirSize);
+        return NULL;
+    }
+
+    u1* dir = (u1*) malloc(dirSize ? dirSize : 1);
+    if (dir == NULL || !readFully(fd, dir, dirSize, dirOffset)) {
+        free(dir);
+        return NULL;
+    }
+    *pSize = dirSize;
+    *pNumEntries = numEntries;
+    return dir;
+}
+
+bool ycZipFindEntry(int fd, const char* entryName, ZipEntryInfo* pEntry)
+{
+    size_t dirSize;
+    u4 numEntries;
+    u1* dir = readCentralDirectory(fd, &dirSize, &numEntries);
+    if (dir == NULL) {
+        return false;
+    }
+
+    size_t nameLen = strlen(entryName);
+    bool found = false;
+    u4 localOffset = 0;
+    const u1* ptr = dir;
+    const u1* end = dir + dirSize;
+
+    for (u4 i = 0; i < numEntries; i++) {
+        if (end - ptr < kCDELen || ycReadU4(ptr) != kCDESignature) {
+            MY_LOG_ERROR("zip: bad central directory entry %u", i);
+            break;
+        }
+        u2 fileNameLen = ycReadU2(ptr + kCDENameLen);
+        u2 extraLen = ycReadU2(ptr + kCDEExtraLen);
+        u2 commentLen = ycReadU2(ptr + kCDECommentLen);
+        size_t entryLen = kCDELen + fileNameLen + extraLen + commentLen;
+        if ((size_t) (end - ptr) < entryLen) {
+            MY_LOG_ERROR("zip: truncated central directory entry %u", i);
+            break;
+        }
+
+        if (fileNameLen == nameLen
+            && memcmp(ptr + kCDELen, entryName, nameLen) == 0)
+        {
+            pEntry->method = ycReadU2(ptr + kCDEMethod);
+            pEntry->crc32 = ycReadU4(ptr + kCDECRC);
+            pEntry->compressedSize = ycReadU4(ptr + kCDECompLen);
+            pEntry->uncompressedSize = ycReadU4(ptr + kCDEUncompLen);
+            localOffset = ycReadU4(ptr + kCDELocalOffset);
+            found = true;
+            break;
+        }
+        ptr += entryLen;
+    }
+    free(dir);
+
+    if (!found) {
+        return false;
+    }
+
+    /*
+     * The local header's extra field (zipalign padding lives here) can
+     * differ from the central directory's, so the data offset has to come
+     * from the local header.
+     */
+    u1 lfh[kLFHLen];
+    if (!readFully(fd, lfh, sizeof(lfh), localOffset)
+        || ycReadU4(lfh) != kLFHSignature)
+    {
+        MY_LOG_ERROR("zip: bad local header for %s", entryName);
+        return false;
+    }
+    pEntry->dataOffset = (off_t) localOffset + kLFHLen
+        + ycReadU2(lfh + kLFHNameLen) + ycReadU2(lfh + kLFHExtraLen);
+
+    if (pEntry->method != kZipCompressStored
+        && pEntry->method != kZipCompressDeflated)
+    {
+        MY_LOG_ERROR("zip: %s uses unsupported method %u",
+            entryName, pEntry->method);
+        return false;
+    }
+    return true;
+}
+
+bool ycZipMapEntry(int fd, const ZipEntryInfo* pEntry, MemMapping* pMap)
+{
+    if (pEntry->method != kZipCompressStored) {
+        return false;
+    }
+
+    /*
+     * A short or lying archive would map past the end of the file, and
+     * the first read there raises SIGBUS instead of failing here.
+     */
+    struct stat st;
+    if (pEntry->compressedSize != pEntry->uncompressedSize) {
+        MY_LOG_ERROR("zip: stored entry sizes differ (%u/%u)",
+            pEntry->compressedSize, pEntry->uncompressedSize);
+        return false;
+    }
+    if (fstat(fd, &st) != 0
+        || pEntry->dataOffset > st.st_size
+        || (off_t) pEntry->uncompressedSize > st.st_size - pEntry->dataOffset)
+    {
+        MY_LOG_ERROR("zip: stored entry runs past the end of the file");
+        return false;
+    }
+
+    off_t pageSize = getpagesize();
+    off_t adjust = pEntry->dataOffset % pageSize;
+    off_t start = pEntry->dataOffset - adjust;
+    size_t length = pEntry->uncompressedSize + adjust;
+
+    void* addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, start);
+    if (addr == MAP_FAILED) {
+        MY_LOG_WARNING("zip: mmap(%zu, %ld) failed: %s",
+            length, (long) start, strerror(errno));
+        return false;
+    }
+
+    pMap->baseAddr = addr;
+    pMap->baseLength = length;
+    pMap->addr = (u1*) addr + adjust;
+    pMap->length = pEntry->uncompressedSize;
+    return true;
+}
+
+static bool inflateToBuffer(int fd, const ZipEntryInfo* pEntry, u1* dst)
+{
+    const size_t kReadBufSize = 32768;
+    u1* readBuf = (u1*) malloc(kReadBufSize);
+    if (readBuf == NULL) {
+        return false;
+    }
+
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    zstream.next_out = dst;
+    zstream.avail_out = pEntry->uncompressedSize;
+
+    /* raw deflate, no zlib header */
+    if (inflateInit2(&zstream, -MAX_WBITS) != Z_OK) {
+        free(readBuf);
+        return false;
+    }
+
+    bool result = false;
+    off_t offset = pEntry->dataOffset;
+    size_t remaining = pEntry->compressedSize;
+    int zerr;
+    do {
+        if (zstream.avail_in == 0) {
+            size_t getSize = remaining < kReadBufSize ? remaining : kReadBufSize;
+            if (getSize == 0 || !readFully(fd, readBuf, getSize, offset)) {
+                goto bail;
+            }
+            offset += getSize;
+            remaining -= getSize;
+            zstream.next_in = readBuf;
+            zstream.avail_in = getSize;
+        }
+        zerr = inflate(&zstream, Z_NO_FLUSH);
+        if (zerr != Z_OK && zerr != Z_STREAM_END) {
+            MY_LOG_ERROR("zip: inflate failed: %d", zerr);
+            goto bail;
+        }
+    } while (zerr == Z_OK);
+
+    result = zstream.total_out == pEntry->uncompressedSize;
+
+bail:
+    inflateEnd(&zstream);
+    free(readBuf);
+    return result;
+}
+
+bool ycZipExtractEntry(int fd, const ZipEntryInfo* pEntry, MemMapping* pMap)
+{
+    size_t length = pEntry->uncompressedSize ? pEntry->uncompressedSize : 1;
+    void* addr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    u1* dst = (u1*) addr;
+
+    bool ok;
+    if (pEntry->method == kZipCompressStored) {
+        ok = readFully(fd, dst, pEntry->uncompressedSize, pEntry->dataOffset);
+    } else {
+        ok = inflateToBuffer(fd, pEntry, dst);
+    }
+    if (ok && crc32(crc32(0L, Z_NULL, 0), dst, pEntry->uncompressedSize)
+            != pEntry->crc32)
+    {
+        MY_LOG_ERROR("zip: crc mismatch on extracted entry");
+        ok = false;
+    }
+    if (!ok) {
+        munmap(addr, length);
+        return false;
+    }
+
+    mprotect(addr, length, PROT_READ);
+    pMap->baseAddr = pMap->addr = addr;
+    pMap->baseLength = length;
+    pMap->length = pEntry->uncompressedSize;
+    return true;
+}
+
+void ycZipReleaseMapping(MemMapping* pMap)
+{
+    if (pMap->baseAddr != NULL) {
+        munmap(pMap->baseAddr, pMap->baseLength);
+    }
+    memset(pMap, 0, sizeof(*pMap));
+}
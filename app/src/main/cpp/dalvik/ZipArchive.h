@@ -0,0 +1,45 @@
+#ifndef CUSTOMAPPVMP_ZIPARCHIVE_H
+#define CUSTOMAPPVMP_ZIPARCHIVE_H
+
+#include <sys/types.h>
+#include "Common.h"
+#include "SysUtil.h"
+
+/*
+ * Minimal read-only zip access, just enough to find one entry in our own
+ * APK without going through the framework.  Names are prefixed with "yc"
+ * so they can't collide with the dexZip* exports in libdvm.
+ */
+
+#define kZipCompressStored      0
+#define kZipCompressDeflated    8
+
+struct ZipEntryInfo {
+    u2      method;             /* kZipCompressStored or kZipCompressDeflated */
+    u4      compressedSize;
+    u4      uncompressedSize;
+    u4      crc32;
+    off_t   dataOffset;         /* file offset of the entry's data */
+};
+
+/*
+ * Find "entryName" through the central directory of the zip open on "fd".
+ * Returns false if the archive is malformed or the entry doesn't exist.
+ */
+bool ycZipFindEntry(int fd, const char* entryName, ZipEntryInfo* pEntry);
+
+/*
+ * Map a stored entry read-only, straight from the file.  The mapping
+ * starts at the page containing the data; pMap->addr points at the entry.
+ */
+bool ycZipMapEntry(int fd, const ZipEntryInfo* pEntry, MemMapping* pMap);
+
+/*
+ * Extract an entry (stored or deflated) into a new anonymous mapping and
+ * check its crc.  Used when the entry can't be mapped in place.
+ */
+bool ycZipExtractEntry(int fd, const ZipEntryInfo* pEntry, MemMapping* pMap);
+
+void ycZipReleaseMapping(MemMapping* pMap);
+
+#endif //CUSTOMAPPVMP_ZIPARCHIVE_H
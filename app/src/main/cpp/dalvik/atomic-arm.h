@@ -68,20 +68,23 @@ typedef int (*android_atomic_cas_func)(int32_t old_value, int32_t new_value,
 //}
 
 
- extern ANDROID_ATOMIC_INLINE
+/*
+ * Inline CAS.  Returns 0 if the swap happened, like android_atomic_cas.
+ * The __sync builtin is a full barrier, which covers both acquire and
+ * release ordering, so the two are the same.
+ */
+extern ANDROID_ATOMIC_INLINE
 int android_atomic_release_cas(int32_t old_value, int32_t new_value,
                                volatile int32_t *ptr)
 {
-    android_memory_barrier();
-    android_atomic_cas_func android_atomic_casHook;
-    void* dvm_hand = dlopen("libdvm.so", RTLD_NOW);
-    if (dvm_hand) {
-        android_atomic_casHook = (android_atomic_cas_func) dlsym(dvm_hand, "android_atomic_cas");
-        if (!android_atomic_casHook) {
-            return -1;
-        }
-    }
-    return android_atomic_casHook(old_value, new_value, ptr);
+    return !__sync_bool_compare_and_swap(ptr, old_value, new_value);
+}
+
+extern ANDROID_ATOMIC_INLINE
+int android_atomic_acquire_cas(int32_t old_value, int32_t new_value,
+                               volatile int32_t *ptr)
+{
+    return !__sync_bool_compare_and_swap(ptr, old_value, new_value);
 }
 
 
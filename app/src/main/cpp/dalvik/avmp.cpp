@@ -1,14 +1,42 @@
+#include <stdlib.h>
+#include <string.h>
 #include "avmp.h"
 #include "log.h"
 #include "Common.h"
 #include "atomic-arm.h"
+#include "Globals.h"
+#include "Utils.h"
+#include "AdvmpProfiler.h"
+#include "Latency.h"
+#include "PerfCounters.h"
+#include "Startup.h"
+#include "YcCache.h"
+#include "YcFile.h"
+
+AdvmpGlobals gAdvmp;
+
 void nativeLog(JNIEnv* env, jobject thiz) {
     MY_LOG_INFO("nativeLog, thiz=%p", thiz);
 }
 
+/*
+ * The protected method separatorTest runs.  BWdvmInterpretPortable doesn't
+ * take an index yet, so this has to match what it interprets; recordings
+ * keyed by method (AdvmpProfiler.latencySummary, the dumpPerfCounters
+ * rows) use the same index.
+ */
+#define kSeparatorTestMethod    0
+
 jint separatorTest(JNIEnv* env, jobject thiz, jint value) {
     MY_LOG_INFO("separatorTest - value=%d", value);
+    LatencyScope latency;
+    PerfScope perf;
+    dvmLatencyEnter(&latency);
+    dvmPerfEnter(&perf);
     jvalue result = BWdvmInterpretPortable(env);
+    dvmPerfExit(&perf, kSeparatorTestMethod);
+    dvmLatencyExit(&latency, kSeparatorTestMethod);
+    dvmStartupMark(kStartupFirstResult);
     return 2;
 }
 
@@ -43,38 +71,95 @@ void registerFunctions(JNIEnv* env) {
         MY_LOG_ERROR("registerFunctions fail��");
         return;
     }
+    registerProfilerNatives(env);
 }
 
 
 
+/*
+ * Code served from the cache failed its chunk checksum or its method
+ * digest.  This launch can't recover the method, but the next one gets a
+ * cache rebuilt from the yc image.
+ */
+static void cachedCodeCorrupt() {
+    MY_LOG_WARNING("yc cache is corrupt; rebuilding it");
+    ycCacheRebuildFromImageAsync(gAdvmp.ycData, gAdvmp.ycSize,
+        &gAdvmp.cacheKey, dvmGetSharedWorkerPool());
+}
+
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
     JNIEnv* env = NULL;
 
+    dvmStartupMark(kStartupOnLoad);
     if (vm->GetEnv((void **)&env, JNI_VERSION_1_4) != JNI_OK) {
         return JNI_ERR;
     }
 
     // ע�᱾�ط�����
     registerFunctions(env);
+    dvmStartupMark(kStartupNativesRegistered);
+
+
+    gAdvmp.apkPath = FindApkPath(env);
+    if (NULL == gAdvmp.apkPath) {
+        MY_LOG_WARNING("apk path not found!");
+        goto _ret;
+    }
+    MY_LOG_INFO("apk path: %s", gAdvmp.apkPath);
+    dvmStartupMark(kStartupYcLocated);
+
+    if (!MapYcFile(gAdvmp.apkPath, &gAdvmp.ycMap, &gAdvmp.ycCrc)) {
+        // The native lookups can only guess; the framework knows.
+        char* appPath = GetAppPath(env);
+        if (NULL == appPath || 0 == strcmp(appPath, gAdvmp.apkPath)
+            || !MapYcFile(appPath, &gAdvmp.ycMap, &gAdvmp.ycCrc)) {
+            free(appPath);
+            MY_LOG_WARNING("map Yc file fail!");
+            goto _ret;
+        }
+        free(gAdvmp.apkPath);
+        gAdvmp.apkPath = appPath;
+        MY_LOG_INFO("apk path from ActivityThread: %s", gAdvmp.apkPath);
+    }
+    gAdvmp.ycData = (const u1*) gAdvmp.ycMap.addr;
+    gAdvmp.ycSize = gAdvmp.ycMap.length;
+    dvmStartupMark(kStartupYcMapped);
+
+    gAdvmp.ycFile = new YcFile;
+
+    // A valid cache from an earlier launch already holds the parsed and
+    // inflated image; use it in place.
+    ycCacheMakeKey(&gAdvmp.cacheKey, gAdvmp.ycCrc, gAdvmp.ycSize);
+    if (ycCacheOpen(&gAdvmp.cacheKey, &gAdvmp.cacheMap)) {
+        if (ycCacheAttach(gAdvmp.ycFile, &gAdvmp.cacheMap)
+            && gAdvmp.ycFile->loadDigests(gAdvmp.ycData, gAdvmp.ycSize)) {
+            gAdvmp.ycFile->setCorruptionHandler(cachedCodeCorrupt);
+            goto _verify;
+        }
+        ycCacheRelease(&gAdvmp.cacheMap);
+        delete gAdvmp.ycFile;
+        gAdvmp.ycFile = new YcFile;
+    }
+
+    if (!gAdvmp.ycFile->parse(gAdvmp.ycData, gAdvmp.ycSize)) {
+        MY_LOG_WARNING("parse Yc file fail.");
+        delete gAdvmp.ycFile;
+        gAdvmp.ycFile = NULL;
+        goto _ret;
+    }
 
+    // Inflate compressed code chunks in the background; methods touched
+    // before that finishes inflate their own chunks on demand.  The cache
+    // for the next launch is written once everything is inflated.
+    ycPrefetchChunks(gAdvmp.ycFile->getCodeSection(), dvmGetSharedWorkerPool());
+    ycCacheRebuildAsync(gAdvmp.ycFile, &gAdvmp.cacheKey,
+        dvmGetSharedWorkerPool());
 
-//    // ���apk·����
-//    gAdvmp.apkPath = GetAppPath(env);
-//    MY_LOG_INFO("apk path��%s", gAdvmp.apkPath);
-//
-//    // �ͷ�yc�ļ���
-//    gAdvmp.ycSize = ReleaseYcFile(gAdvmp.apkPath, &gAdvmp.ycData);
-//    if (0 == gAdvmp.ycSize) {
-//        MY_LOG_WARNING("release Yc file fail!");
-//        goto _ret;
-//    }
-//
-//    // ����yc�ļ���
-//    gAdvmp.ycFile = new YcFile;
-//    if (!gAdvmp.ycFile->parse(gAdvmp.ycData, gAdvmp.ycSize)) {
-//        MY_LOG_WARNING("parse Yc file fail.");
-//        goto _ret;
-//    }
+_verify:
+    dvmStartupMark(kStartupYcParsed);
+    // Hash the whole payload off the main thread; individual methods are
+    // checked against their own digests when they are first used.
+    ycVerifyPayloadAsync(gAdvmp.ycFile->getDigests(), dvmGetSharedWorkerPool());
 
 _ret:
     return JNI_VERSION_1_4;
@@ -0,0 +1,272 @@
+/*
+ * Convert a MethodTrace file (dalvik/MethodTraceFormat.h) to Chrome
+ * trace-event JSON, for chrome://tracing or ui.perfetto.dev.  Host tool,
+ * not part of the app build:
+ *
+ *   c++ -O2 -I../dalvik TraceToJson.cpp -o trace2json
+ *   adb pull /data/data/<pkg>/files/app.avmptrace
+ *   ./trace2json app.avmptrace > app.json
+ *
+ * Exits that have no matching entry in the trace (the method was already
+ * running when tracing started) are dropped; entries still open at the
+ * end are closed at the thread's last timestamp.  Methods the runtime
+ * had no id for (kTraceMethodUnknown) are named "(untracked)".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "MethodTraceFormat.h"
+
+struct Event {
+    u8      ns;
+    u4      seq;            /* file order, to keep equal timestamps stable */
+    pid_t   tid;
+    u4      action;
+    u4      methodId;
+};
+
+static char** gMethodNames;
+static u4 gMethodNameCount;
+static Event* gEvents;
+static u4 gEventCount;
+static u4 gEventCap;
+
+static u8 getLe(const u1* ptr, int bytes)
+{
+    u8 val = 0;
+    for (int i = 0; i < bytes; i++) {
+        val |= (u8) ptr[i] << (8 * i);
+    }
+    return val;
+}
+
+static bool getVarint(const u1** pPtr, const u1* end, u8* pVal)
+{
+    u8 val = 0;
+    for (int shift = 0; *pPtr < end && shift < 64; shift += 7) {
+        u1 byte = *(*pPtr)++;
+        val |= (u8) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *pVal = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * "Lcom/foo/Bar;\tbaz\tVI" -> "com.foo.Bar.baz"
+ */
+static void addMethod(u4 id, const u1* text, u4 len)
+{
+    if (id >= gMethodNameCount) {
+        u4 count = id + 1024;
+        gMethodNames = (char**) realloc(gMethodNames, count * sizeof(char*));
+        memset(gMethodNames + gMethodNameCount, 0,
+            (count - gMethodNameCount) * sizeof(char*));
+        gMethodNameCount = count;
+    }
+    char* name = (char*) malloc(len + 1);
+    u4 pos = 0;
+    u4 i = (len > 0 && text[0] == 'L') ? 1 : 0;
+    for (; i < len && text[i] != ';' && text[i] != '\t'; i++) {
+        name[pos++] = (text[i] == '/') ? '.' : (char) text[i];
+    }
+    while (i < len && text[i] != '\t') {
+        i++;
+    }
+    name[pos++] = '.';
+    for (i++; i < len && text[i] != '\t'; i++) {
+        name[pos++] = (char) text[i];
+    }
+    name[pos] = '\0';
+    free(gMethodNames[id]);
+    gMethodNames[id] = name;
+}
+
+static void addEvent(pid_t tid, u8 ns, u4 action, u4 methodId)
+{
+    if (gEventCount == gEventCap) {
+        gEventCap = gEventCap != 0 ? gEventCap * 2 : 65536;
+        gEvents = (Event*) realloc(gEvents, gEventCap * sizeof(Event));
+        if (gEvents == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    Event* event = &gEvents[gEventCount];
+    event->ns = ns;
+    event->seq = gEventCount++;
+    event->tid = tid;
+    event->action = action;
+    event->methodId = methodId;
+}
+
+static bool parseChunk(pid_t tid, u8 baseNs, const u1* ptr, const u1* end)
+{
+    u8 ns = baseNs;
+    while (ptr < end) {
+        u8 head, methodId;
+        if (!getVarint(&ptr, end, &head) || !getVarint(&ptr, end, &methodId)) {
+            return false;
+        }
+        ns += head >> 2;
+        addEvent(tid, ns, (u4) (head & 3), (u4) methodId);
+    }
+    return true;
+}
+
+static bool parseTrace(const u1* data, size_t size)
+{
+    if (size < 12 || memcmp(data, kTraceMagic, 8) != 0) {
+        fprintf(stderr, "not a method trace\n");
+        return false;
+    }
+    if (getLe(data + 8, 4) != kTraceVersion) {
+        fprintf(stderr, "unsupported trace version %u\n",
+            (u4) getLe(data + 8, 4));
+        return false;
+    }
+
+    const u1* ptr = data + 12;
+    const u1* end = data + size;
+    while (ptr < end) {
+        u1 kind = *ptr++;
+        if (kind == kTraceRecordMethod && end - ptr >= 6) {
+            u4 id = (u4) getLe(ptr, 4);
+            u4 len = (u4) getLe(ptr + 4, 2);
+            ptr += 6;
+            if ((size_t) (end - ptr) < len) {
+                break;
+            }
+            addMethod(id, ptr, len);
+            ptr += len;
+        } else if (kind == kTraceRecordChunk && end - ptr >= 16) {
+            pid_t tid = (pid_t) getLe(ptr, 4);
+            u8 baseNs = getLe(ptr + 4, 8);
+            u4 len = (u4) getLe(ptr + 12, 4);
+            ptr += 16;
+            if ((size_t) (end - ptr) < len || !parseChunk(tid, baseNs, ptr, ptr + len)) {
+                break;
+            }
+            ptr += len;
+        } else {
+            break;
+        }
+    }
+    if (ptr != end) {
+        fprintf(stderr, "trace truncated at offset %zu\n",
+            (size_t) (ptr - data));
+    }
+    return true;
+}
+
+static int compareEvents(const void* a, const void* b)
+{
+    const Event* ea = (const Event*) a;
+    const Event* eb = (const Event*) b;
+    if (ea->tid != eb->tid) {
+        return ea->tid < eb->tid ? -1 : 1;
+    }
+    if (ea->ns != eb->ns) {
+        return ea->ns < eb->ns ? -1 : 1;
+    }
+    return ea->seq < eb->seq ? -1 : (ea->seq > eb->seq);
+}
+
+static void printName(u4 methodId)
+{
+    const char* name = (methodId < gMethodNameCount && gMethodNames[methodId] != NULL)
+        ? gMethodNames[methodId] : NULL;
+    if (methodId == kTraceMethodUnknown) {
+        printf("\"(untracked)\"");
+        return;
+    }
+    if (name == NULL) {
+        printf("\"method#%u\"", methodId);
+        return;
+    }
+    putchar('"');
+    for (; *name != '\0'; name++) {
+        if (*name == '"' || *name == '\\') {
+            putchar('\\');
+        }
+        putchar(*name);
+    }
+    putchar('"');
+}
+
+static bool gFirstRecord = true;
+
+static void printEvent(const char* phase, pid_t tid, u8 ns, u8 originNs,
+    u4 methodId)
+{
+    printf("%s\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"name\":",
+        gFirstRecord ? "" : ",", phase, tid, (double) (ns - originNs) / 1000.0);
+    printName(methodId);
+    putchar('}');
+    gFirstRecord = false;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace-file > trace.json\n", argv[0]);
+        return 2;
+    }
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    u1* data = (u1*) malloc(size > 0 ? size : 1);
+    if (size < 0 || fread(data, 1, size, fp) != (size_t) size) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(fp);
+
+    if (!parseTrace(data, size)) {
+        return 1;
+    }
+    qsort(gEvents, gEventCount, sizeof(Event), compareEvents);
+
+    u8 originNs = ~0ULL;
+    for (u4 i = 0; i < gEventCount; i++) {
+        if (gEvents[i].ns < originNs) {
+            originNs = gEvents[i].ns;
+        }
+    }
+
+    /* open entries of the current thread, to balance the output */
+    u4* stack = (u4*) malloc((gEventCount + 1) * sizeof(u4));
+    u4 depth = 0;
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (u4 i = 0; i < gEventCount; i++) {
+        const Event* event = &gEvents[i];
+        if (event->action == kMethodTraceEnter) {
+            stack[depth++] = event->methodId;
+            printEvent("B", event->tid, event->ns, originNs, event->methodId);
+        } else if (depth > 0) {
+            depth--;
+            printEvent("E", event->tid, event->ns, originNs, stack[depth]);
+        }
+
+        bool lastOfThread = (i + 1 == gEventCount)
+            || gEvents[i + 1].tid != event->tid;
+        while (lastOfThread && depth > 0) {
+            depth--;
+            printEvent("E", event->tid, event->ns, originNs, stack[depth]);
+        }
+    }
+    printf("\n]}\n");
+
+    free(stack);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,212 @@
+package com.appvmp;
+
+/**
+ * Instrumentation of the protected-code interpreter.  Everything here is
+ * off until started and costs nothing while off.
+ */
+public final class AdvmpProfiler {
+
+    private AdvmpProfiler() {
+    }
+
+    /**
+     * Count executed opcodes on every thread that runs protected code, and
+     * with "countPairs" also (previous, current) opcode pairs.  Pairs take
+     * 512 KB per thread and, once on, stay on until the process exits.
+     */
+    public static native void startOpcodeCounting(boolean countPairs);
+    public static native void stopOpcodeCounting();
+    public static native void resetOpcodeCounts();
+
+    /**
+     * Execution count per opcode, indexed by opcode value.
+     */
+    public static native long[] opcodeCounts();
+
+    /**
+     * Execution count per opcode pair, indexed previous * 256 + current.
+     */
+    public static native long[] opcodePairCounts();
+
+    public static native String opcodeName(int opcode);
+
+    /**
+     * Write both histograms to "path" as CSV, most frequent first.
+     */
+    public static native boolean dumpOpcodeCounts(String path);
+
+    /**
+     * Runtime counters summed over all threads, in the order of the
+     * VmStat enum in VmStats.h; {@link #vmStatName} names each index.
+     * The instruction count of a thread still running a loop can lag by
+     * up to one safepoint interval.
+     */
+    public static native long[] vmStats();
+
+    public static native String vmStatName(int index);
+
+    /** Clocks for {@link #latencySummary}. */
+    public static final int LATENCY_WALL = 0;
+    public static final int LATENCY_CPU = 1;
+
+    /** Flags for {@link #startLatencyRecording}. */
+    public static final int RECORD_WALL = 1 << LATENCY_WALL;
+    public static final int RECORD_CPU = 1 << LATENCY_CPU;
+
+    /**
+     * Record the latency of every protected call, on the clocks given by
+     * the RECORD_* flags, into per-method histograms.
+     */
+    public static native void startLatencyRecording(int clocks);
+    public static native void stopLatencyRecording();
+    public static native void resetLatency();
+
+    /**
+     * { count, p50, p90, p99, max } in nanoseconds for protected method
+     * "methodIndex" on "clock", or null if it was never recorded.
+     * Percentiles are within about 3% of the exact value.
+     */
+    public static native long[] latencySummary(int methodIndex, int clock);
+
+    /**
+     * Count cycles, instructions, branch misses and L1 misses for every
+     * protected call with perf_event_open.  With "sampleOpcodes", also
+     * sample which opcode family the events land in.  Returns false if
+     * the kernel doesn't allow it (perf_event_paranoid above 2).
+     */
+    public static native boolean startPerfCounters(boolean sampleOpcodes);
+    public static native void stopPerfCounters();
+    public static native void resetPerfCounters();
+
+    /**
+     * Write the counts per method and per opcode family as CSV, with IPC
+     * and misses per thousand instructions.
+     */
+    public static native boolean dumpPerfCounters(String path);
+
+    /**
+     * Write "dir"/perf-&lt;pid&gt;.map, naming the memory that holds each
+     * protected method's decoded instructions, for perf/simpleperf data
+     * address samples.  Copy it to /tmp on the device for perf.
+     */
+    public static native boolean writePerfMap(String dir);
+
+    /**
+     * Trace every protected method entry and exit, with timestamps, to
+     * "path" (format in MethodTraceFormat.h).  Returns false if a trace is
+     * already running or the file can't be created.
+     */
+    public static native boolean startMethodTrace(String path);
+
+    /**
+     * Flush and close the trace.  Returns false if part of it couldn't be
+     * written; the file is then incomplete.
+     */
+    public static native boolean stopMethodTrace();
+
+    public static native boolean isMethodTracing();
+
+    /** Defaults and limit for {@link #startSampling}, as in Sampler.h. */
+    public static final int SAMPLING_DEFAULT_HZ = 100;
+    public static final int SAMPLING_DEFAULT_CAPACITY = 4096;
+    public static final int SAMPLING_MAX_CAPACITY = 1 << 17;
+
+    /**
+     * Sample the interpreted stack of every thread running protected code
+     * "hz" times per second of its CPU time, keeping up to "capacity"
+     * samples.  With "precise", the innermost frame gets an exact pc at
+     * the cost of running the sampled threads instrumented.  Discards the
+     * previous run's samples.  Returns false if already running, if
+     * SIGPROF is taken, or if "capacity" is above
+     * {@link #SAMPLING_MAX_CAPACITY}.
+     */
+    public static native boolean startSampling(int hz, int capacity,
+            boolean precise);
+
+    public static native void stopSampling();
+
+    public static native boolean isSampling();
+
+    /**
+     * { samples taken, samples dropped because the buffer was full }
+     */
+    public static native long[] samplingCounts();
+
+    /**
+     * Write the samples as folded stacks for flame graph tools; with
+     * "withLines", frames carry source line numbers.
+     */
+    public static native boolean writeFoldedStacks(String path,
+            boolean withLines);
+
+    /**
+     * Write the samples as an uncompressed pprof profile.
+     */
+    public static native boolean writePprof(String path);
+
+    /**
+     * Count new-instance, new-array and filled-new-array in protected code
+     * per allocating instruction: objects, bytes and class.  Counts are
+     * kept across stop/start until reset.
+     */
+    public static native void startAllocSites();
+
+    public static native void stopAllocSites();
+
+    public static native void resetAllocSites();
+
+    /**
+     * Write the allocation sites as CSV, most bytes first.
+     */
+    public static native boolean dumpAllocSites(String path);
+
+    /**
+     * Time every monitor-enter in protected code that has to wait for
+     * another thread, and charge the wait to the waiting instruction and
+     * the one that took the lock, where that is known.
+     */
+    public static native void startLockContention();
+
+    public static native void stopLockContention();
+
+    public static native void resetLockContention();
+
+    /**
+     * Write the contended site pairs as CSV, longest total wait first.
+     */
+    public static native boolean dumpLockContention(String path);
+
+    /**
+     * When each startup phase was first reached, as System.nanoTime()
+     * values, in the order of the StartupPhase enum in Startup.h;
+     * {@link #startupPhaseName} names each index.  0 for a phase not
+     * reached yet.  Index 0 is process start.
+     */
+    public static native long[] startupTimeline();
+
+    public static native String startupPhaseName(int index);
+
+    /** Modes for {@link #enableThreadSubModes}, as in AdvmpThread.h. */
+    public static final int SUBMODE_CHECK_ALWAYS = 0x0001;
+    public static final int SUBMODE_OPCODE_COUNT = 0x0008;
+    public static final int SUBMODE_ALLOC_SITES = 0x0020;
+    public static final int SUBMODE_LOCK_CONTENTION = 0x0040;
+
+    /**
+     * Turn SUBMODE_* instrumentation on or off for the single thread with
+     * kernel id "tid" (android.os.Process.myTid()), leaving every other
+     * thread on the uninstrumented path.  Returns false if that thread
+     * hasn't run protected code yet, or for any other mode.
+     */
+    public static native boolean enableThreadSubModes(int tid, int modes);
+
+    public static native boolean disableThreadSubModes(int tid, int modes);
+
+    /**
+     * Backward branches between suspend checks in protected code, for
+     * every thread (default 64, clamped to 1..1024).  Lower values make
+     * GC and debugger suspension faster to reach; higher ones make tight
+     * loops cheaper.
+     */
+    public static native void setSafepointInterval(int interval);
+}